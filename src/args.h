@@ -7,6 +7,7 @@
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 enum RecordMode {
     Background = 0,
@@ -22,6 +23,20 @@ enum class CameraSource {
     LibCamera,
     LibArgus,
     V4L2,
+    File,
+    Pattern,
+};
+
+// Which peer's target rate a shared --broadcast-encoder runs at.
+enum class BroadcastBitrate {
+    Lowest,
+    Highest,
+};
+
+// One layer of --simulcast, from the lowest resolution up.
+struct SimulcastLayer {
+    double scale_down = 1.0;
+    int max_kbps = 0;
 };
 
 template <typename DEFAULT> struct TimeVal {
@@ -74,7 +89,25 @@ struct Args {
     uint32_t camera_id = 0;
     std::string camera = "libcamera:0";
     std::string v4l2_format = "i420";
+    bool v4l2_deferred_requeue = false;
+    // threads of the shared epoll loop that V4L2 devices are polled from; 0 gives each device its
+    // own select() thread as before
+    int event_threads = 2;
+    std::string event_cpus = "";
+    std::vector<int> event_cpu_ids;
+    // threads besides the capture thread that software decoding and scaling split a frame
+    // across; -1 gives one per remaining core
+    int pool_threads = -1;
+    // per-thread affinity and scheduling rules, see common/thread_policy.h
+    std::string thread_policy = "";
     std::string alias = ""; // per-camera alias for recording subdirectory prefix
+    // per-camera switches, only read from an entry of the `cameras:` config list
+    bool webrtc = true;
+    bool record = true;
+
+    // synthetic sources, derived from --camera=file:<path> or --camera=pattern:<name>
+    std::string source_path = "";
+    std::string replay_pacing = "realtime";
 
     // sub stream for multiple resolution capture
     int sub_width = 0;
@@ -86,6 +119,12 @@ struct Args {
     // derived from --record-source / --webrtc-source, 0: main stream, 1: sub stream
     int record_stream_idx = 0; // recording stream index
     int live_stream_idx = 0;   // webrtc live stream index
+    // frames per second the recorder keeps, 0 keeps every captured frame
+    int record_fps = 0;
+    // give the recorder and each live track their own queue and thread, see common/frame_mailbox.h
+    bool async_dispatch = false;
+    int async_queue_depth = 2;
+    std::string async_drop_policy = "drop-oldest";
 
     // audio input
     int sample_rate = 48000;
@@ -137,6 +176,10 @@ struct Args {
     std::string record_path = "";
     std::string record_ondemand_path = "";
     int file_duration = 60;
+    // one H.264 encode per camera for the recorder and WebRTC both, see
+    // recorder/shared_h264_encoder.h
+    bool shared_encoder = false;
+    int shared_keyframe_interval = 2; // seconds
 
     // ipc
     bool enable_ipc = false;
@@ -151,6 +194,18 @@ struct Args {
     int min_bitrate = 0;
     int start_bitrate = 0;
     int max_bitrate = 0;
+    // `<scale down>:<max kbps>` per layer, lowest first, e.g. "4:200,2:700,1:2500"; empty sends a
+    // single encoding
+    std::string simulcast = "";
+    std::vector<SimulcastLayer> simulcast_layers;
+    bool broadcast_encoder = false;
+    std::string broadcast_bitrate_str = "lowest";
+    BroadcastBitrate broadcast_bitrate = BroadcastBitrate::Lowest;
+    // replay the current GOP to a peer that joins, see common/gop_cache.h
+    bool fast_start = false;
+    // milliseconds; see common/key_frame_scheduler.h
+    int keyframe_merge_window = 50;
+    int min_keyframe_interval = 500;
     bool hw_accel = false;
     bool no_adaptive = false;
     bool latency_trace = false;
@@ -188,6 +243,10 @@ struct Args {
     // picamera device API
     std::string api_url = "";
     std::string api_key = ""; // bearer token for api_url
+
+    // one fully parsed entry per camera of the `cameras:` config list, each starting from the
+    // options above; empty when the process runs the single camera above
+    std::vector<Args> cameras;
 };
 
 #endif // ARGS_H_
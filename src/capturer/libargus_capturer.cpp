@@ -54,11 +54,12 @@ void LibargusCapturer::Initialize() {
     output_streams_.resize(num_streams_);
 
     stream_handlers_.emplace_back(
-        StreamHandler::Create(0, Argus::Size2D<uint32_t>(config_.width, config_.height)));
+        StreamHandler::Create(0, Argus::Size2D<uint32_t>(config_.width, config_.height),
+                              &latest_frame(0)));
 
     if (has_sub_stream()) {
         stream_handlers_.emplace_back(StreamHandler::Create(
-            1, Argus::Size2D<uint32_t>(config_.sub_width, config_.sub_height)));
+            1, Argus::Size2D<uint32_t>(config_.sub_width, config_.sub_height), &latest_frame(1)));
     }
 
     camera_provider_.reset(Argus::CameraProvider::create());
@@ -234,7 +235,6 @@ bool StreamHandler::PrepareBuffers() {
         }
     }
 
-    last_frame_buffer_ = WrapBuffer(buffers_[0]->dma_fd, {0, 0});
     return true;
 }
 
@@ -281,8 +281,8 @@ void StreamHandler::CaptureImage() {
         latency::RecordCapture(latency::SensorUs(timestamp), latency::NowUs());
     }
 
-    last_frame_buffer_ = frame_buffer;
     Next(frame_buffer);
+    latest_frame_->Post(frame_buffer);
 
     i_buffer_stream_->releaseBuffer(buffer);
 }
@@ -331,7 +331,6 @@ StreamHandler::~StreamHandler() {
         i_buffer_stream_->endOfStream();
     }
     worker_.reset();
-    last_frame_buffer_ = nullptr;
     ReleaseBuffers();
 }
 
@@ -351,19 +350,12 @@ int LibargusCapturer::height(int stream_idx) const {
     return stream_handlers_[stream_idx]->height();
 }
 
-bool LibargusCapturer::is_dma_capture() const { return true; }
+bool LibargusCapturer::is_dma_capture(int stream_idx) const { return true; }
 
 uint32_t LibargusCapturer::format() const { return format_; }
 
 Args LibargusCapturer::config() const { return config_; }
 
-webrtc::scoped_refptr<webrtc::I420BufferInterface> LibargusCapturer::GetI420Frame(int stream_idx) {
-    if (stream_idx <= 0 || stream_idx >= num_streams_) {
-        return stream_handlers_[0]->GetFrameBuffer()->ToI420();
-    }
-    return stream_handlers_[stream_idx]->GetFrameBuffer()->ToI420();
-}
-
 void LibargusCapturer::StartCapture() {
     for (auto &handler : stream_handlers_) {
         handler->StartCapture();
@@ -22,14 +22,16 @@ class StreamHandler : public Subject<V4L2FrameBufferRef> {
   public:
     static constexpr int kBufferCount = 4;
 
-    static std::unique_ptr<StreamHandler> Create(int stream_idx, Argus::Size2D<uint32_t> size) {
-        return std::make_unique<StreamHandler>(stream_idx, size);
+    static std::unique_ptr<StreamHandler> Create(int stream_idx, Argus::Size2D<uint32_t> size,
+                                                 LatestFrame *latest_frame) {
+        return std::make_unique<StreamHandler>(stream_idx, size, latest_frame);
     }
 
-    StreamHandler(int stream_idx, Argus::Size2D<uint32_t> size)
+    StreamHandler(int stream_idx, Argus::Size2D<uint32_t> size, LatestFrame *latest_frame)
         : stream_idx_(stream_idx),
           size_(size),
-          running_(true) {}
+          running_(true),
+          latest_frame_(latest_frame) {}
 
     ~StreamHandler();
 
@@ -37,7 +39,6 @@ class StreamHandler : public Subject<V4L2FrameBufferRef> {
     uint32_t height() const { return size_.height(); }
     Argus::Size2D<uint32_t> GetSize() const { return size_; }
 
-    V4L2FrameBufferRef GetFrameBuffer() { return last_frame_buffer_; }
     void SetOutputStream(Argus::OutputStream *stream) { output_stream_ = stream; }
     bool PrepareBuffers();
     void StartCapture();
@@ -53,6 +54,8 @@ class StreamHandler : public Subject<V4L2FrameBufferRef> {
     Argus::Size2D<uint32_t> size_;
     uint32_t frame_size_ = 0;
     std::atomic<bool> running_;
+    // The capturer's mailbox for this stream.
+    LatestFrame *latest_frame_;
 
     Argus::OutputStream *output_stream_ = nullptr;
     Argus::IBufferOutputStream *i_buffer_stream_ = nullptr;
@@ -60,7 +63,6 @@ class StreamHandler : public Subject<V4L2FrameBufferRef> {
     EGLDisplay egl_display_ = EGL_NO_DISPLAY;
 
     std::vector<std::unique_ptr<CaptureBuffer>> buffers_;
-    V4L2FrameBufferRef last_frame_buffer_;
 
     std::unique_ptr<Worker> worker_;
 
@@ -80,13 +82,13 @@ class LibargusCapturer : public VideoCapturer {
     int width(int stream_idx = 0) const override;
     int height(int stream_idx = 0) const override;
     bool has_sub_stream() const override { return num_streams_ > 1; }
-    bool is_dma_capture() const override;
+    bool is_dma_capture(int stream_idx = 0) const override;
     uint32_t format() const override;
     Args config() const override;
 
-    webrtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(int stream_idx = 0) override;
     void StartCapture() override;
 
+    using VideoCapturer::Subscribe;
     Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                            int stream_idx = 0) override;
 
@@ -4,9 +4,60 @@
 
 #include "common/latency_tracer.h"
 #include "common/logging.h"
+#include "common/thread_policy.h"
 #include "common/v4l2_utils.h"
 #include <libcamera/geometry.h>
 
+namespace {
+
+// Frames keep their request out of the camera until released, but only while this many others
+// stay queued; past that a frame is delivered the old way, for the length of the callback.
+constexpr int kMinQueuedRequests = 3;
+
+// Only a software encoder or an --async-dispatch mailbox keeps a frame past the callback, so
+// only then are the extra buffers worth their memory. With the default two, nothing is lent.
+constexpr int kDefaultBufferCount = 2;
+constexpr int kLendingBufferCount = 6;
+
+} // namespace
+
+// Counts the requests lent out with their frames. Frames hold the ledger rather than the
+// capturer, so one released after the capturer is gone does not queue into a stopped camera.
+class LibcameraCapturer::RequestLedger {
+  public:
+    explicit RequestLedger(LibcameraCapturer *capturer)
+        : capturer_(capturer),
+          lent_(0) {}
+
+    bool TryLend(int request_count) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        // The request just completed is not queued either.
+        if (request_count - lent_ - 1 < kMinQueuedRequests) {
+            return false;
+        }
+        lent_++;
+        return true;
+    }
+
+    void Return(libcamera::Request *request) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        lent_--;
+        if (capturer_) {
+            capturer_->QueueRequest(request);
+        }
+    }
+
+    void Detach() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        capturer_ = nullptr;
+    }
+
+  private:
+    std::mutex mtx_;
+    LibcameraCapturer *capturer_;
+    int lent_;
+};
+
 std::shared_ptr<LibcameraCapturer> LibcameraCapturer::Create(Args args) {
     auto ptr = std::make_shared<LibcameraCapturer>(args);
     ptr->InitCamera();
@@ -21,14 +72,23 @@ LibcameraCapturer::LibcameraCapturer(Args args)
       width_(args.width),
       height_(args.height),
       rotation_(args.rotation),
-      buffer_count_(2),
+      buffer_count_(args.hw_accel && !args.async_dispatch ? kDefaultBufferCount
+                                                          : kLendingBufferCount),
       format_(args.format),
       config_(args),
-      is_controls_updated_(false) {}
+      is_controls_updated_(false),
+      sub_stream_(nullptr),
+      sub_width_(args.sub_width),
+      sub_height_(args.sub_height),
+      ledger_(std::make_shared<RequestLedger>(this)) {}
 
 LibcameraCapturer::~LibcameraCapturer() {
+    ledger_->Detach();
     camera_->stop();
     allocator_->free(stream_);
+    if (sub_stream_) {
+        allocator_->free(sub_stream_);
+    }
     allocator_.reset();
     camera_config_.reset();
     camera_->release();
@@ -56,42 +116,26 @@ void LibcameraCapturer::InitCamera() {
     INFO_PRINT("camera id: %s", cam_id.c_str());
     camera_ = cm_->get(cam_id);
     camera_->acquire();
-    camera_config_ = camera_->generateConfiguration({libcamera::StreamRole::VideoRecording});
-
-    if (rotation_ == 90) {
-        camera_config_->orientation = libcamera::Orientation::Rotate90;
-    } else if (rotation_ == 180) {
-        camera_config_->orientation = libcamera::Orientation::Rotate180;
-    } else if (rotation_ == 270) {
-        camera_config_->orientation = libcamera::Orientation::Rotate270;
-    }
 
     controls_ = libcamera::ControlList(camera_->controls());
     int64_t frame_time = 1000000 / fps_;
     controls_.set(libcamera::controls::FrameDurationLimits,
                   libcamera::Span<const int64_t, 2>({frame_time, frame_time}));
 
-    DEBUG_PRINT("camera original format: %s", camera_config_->at(0).toString().c_str());
-    if (width_ && height_) {
-        libcamera::Size size(width_, height_);
-        camera_config_->at(0).size = size;
+    if (config_.num_streams > 1) {
+        camera_config_ = GenerateConfiguration(true);
+        if (!camera_config_) {
+            INFO_PRINT("No second ISP output for a %dx%d sub stream, scaling it in software.",
+                       sub_width_, sub_height_);
+            sub_scaler_ = std::make_unique<SubStreamScaler>(sub_width_, sub_height_);
+        }
     }
 
-    camera_config_->at(0).pixelFormat = libcamera::formats::YUV420;
-    camera_config_->at(0).bufferCount = buffer_count_;
-
-    if (width_ >= 1280 || width_ >= 720) {
-        camera_config_->at(0).colorSpace = libcamera::ColorSpace::Rec709;
-    } else {
-        camera_config_->at(0).colorSpace = libcamera::ColorSpace::Smpte170m;
+    if (!camera_config_) {
+        camera_config_ = GenerateConfiguration(false);
     }
 
-    auto validation = camera_config_->validate();
-    if (validation == libcamera::CameraConfiguration::Status::Valid) {
-        INFO_PRINT("camera validated format: %s.", camera_config_->at(0).toString().c_str());
-    } else if (validation == libcamera::CameraConfiguration::Status::Adjusted) {
-        INFO_PRINT("camera adjusted format: %s.", camera_config_->at(0).toString().c_str());
-    } else {
+    if (!camera_config_) {
         ERROR_PRINT("Failed to validate camera configuration.");
         exit(EXIT_FAILURE);
     }
@@ -106,6 +150,73 @@ void LibcameraCapturer::InitCamera() {
         ERROR_PRINT("Stride is not equal to width");
         exit(EXIT_FAILURE);
     }
+
+    if (camera_config_->size() > 1) {
+        sub_width_ = camera_config_->at(1).size.width;
+        sub_height_ = camera_config_->at(1).size.height;
+        INFO_PRINT("  sub stream width: %d, height: %d", sub_width_, sub_height_);
+    }
+}
+
+// Returns nullptr when the camera cannot produce the requested streams, so the caller can fall
+// back to fewer of them.
+std::unique_ptr<libcamera::CameraConfiguration>
+LibcameraCapturer::GenerateConfiguration(bool with_sub_stream) {
+    std::vector<libcamera::StreamRole> roles = {libcamera::StreamRole::VideoRecording};
+    if (with_sub_stream) {
+        roles.push_back(libcamera::StreamRole::Viewfinder);
+    }
+
+    auto config = camera_->generateConfiguration(roles);
+    if (!config || config->size() != roles.size()) {
+        return nullptr;
+    }
+
+    if (rotation_ == 90) {
+        config->orientation = libcamera::Orientation::Rotate90;
+    } else if (rotation_ == 180) {
+        config->orientation = libcamera::Orientation::Rotate180;
+    } else if (rotation_ == 270) {
+        config->orientation = libcamera::Orientation::Rotate270;
+    }
+
+    DEBUG_PRINT("camera original format: %s", config->at(0).toString().c_str());
+    if (width_ && height_) {
+        libcamera::Size size(width_, height_);
+        config->at(0).size = size;
+    }
+    if (with_sub_stream) {
+        config->at(1).size = libcamera::Size(sub_width_, sub_height_);
+    }
+
+    for (auto &stream_config : *config) {
+        stream_config.pixelFormat = libcamera::formats::YUV420;
+        stream_config.bufferCount = buffer_count_;
+
+        if (width_ >= 1280 || width_ >= 720) {
+            stream_config.colorSpace = libcamera::ColorSpace::Rec709;
+        } else {
+            stream_config.colorSpace = libcamera::ColorSpace::Smpte170m;
+        }
+    }
+
+    auto validation = config->validate();
+    if (validation == libcamera::CameraConfiguration::Status::Valid) {
+        INFO_PRINT("camera validated format: %s.", config->at(0).toString().c_str());
+    } else if (validation == libcamera::CameraConfiguration::Status::Adjusted) {
+        INFO_PRINT("camera adjusted format: %s.", config->at(0).toString().c_str());
+    } else {
+        return nullptr;
+    }
+
+    // Frames are handed out as packed I420, so a padded sub stream is no use.
+    if (with_sub_stream && config->at(1).stride != config->at(1).size.width) {
+        DEBUG_PRINT("sub stream stride %u is not equal to width %u", config->at(1).stride,
+                    config->at(1).size.width);
+        return nullptr;
+    }
+
+    return config;
 }
 
 void LibcameraCapturer::InitControls(Args args) {
@@ -221,11 +332,24 @@ void LibcameraCapturer::InitControls(Args args) {
 
 int LibcameraCapturer::fps() const { return fps_; }
 
-int LibcameraCapturer::width(int stream_idx) const { return width_; }
+int LibcameraCapturer::width(int stream_idx) const {
+    return stream_idx == 1 && has_sub_stream() ? sub_width_ : width_;
+}
 
-int LibcameraCapturer::height(int stream_idx) const { return height_; }
+int LibcameraCapturer::height(int stream_idx) const {
+    return stream_idx == 1 && has_sub_stream() ? sub_height_ : height_;
+}
+
+bool LibcameraCapturer::has_sub_stream() const {
+    return camera_config_->size() > 1 || sub_scaler_ != nullptr;
+}
 
-bool LibcameraCapturer::is_dma_capture() const { return true; }
+bool LibcameraCapturer::builds_pyramid() const { return true; }
+
+// A software-scaled sub stream lives in ordinary memory, not in a dma buffer.
+bool LibcameraCapturer::is_dma_capture(int stream_idx) const {
+    return stream_idx != 1 || !sub_scaler_;
+}
 
 uint32_t LibcameraCapturer::format() const { return format_; }
 
@@ -243,12 +367,37 @@ void LibcameraCapturer::AllocateBuffer() {
     allocator_ = std::make_unique<libcamera::FrameBufferAllocator>(camera_);
 
     stream_ = camera_config_->at(0).stream();
-    int ret = allocator_->allocate(stream_);
+    AllocateStreamBuffers(stream_);
+    if (camera_config_->size() > 1) {
+        sub_stream_ = camera_config_->at(1).stream();
+        AllocateStreamBuffers(sub_stream_);
+    }
+
+    for (unsigned int i = 0; i < buffer_count_; i++) {
+        auto request = camera_->createRequest();
+        if (!request) {
+            ERROR_PRINT("Can't create camera request");
+        }
+        for (auto *stream : {stream_, sub_stream_}) {
+            if (!stream) {
+                continue;
+            }
+            int ret = request->addBuffer(stream, allocator_->buffers(stream)[i].get());
+            if (ret < 0) {
+                ERROR_PRINT("Can't set buffer for request");
+            }
+        }
+        requests_.push_back(std::move(request));
+    }
+}
+
+void LibcameraCapturer::AllocateStreamBuffers(libcamera::Stream *stream) {
+    int ret = allocator_->allocate(stream);
     if (ret < 0) {
         ERROR_PRINT("Can't allocate buffers");
     }
 
-    auto &buffers = allocator_->buffers(stream_);
+    auto &buffers = allocator_->buffers(stream);
     if (buffer_count_ != buffers.size()) {
         ERROR_PRINT("Buffer counts not match allocated buffer number");
         exit(1);
@@ -266,20 +415,13 @@ void LibcameraCapturer::AllocateBuffer() {
         mapped_buffers_[fd] = std::make_pair(memory, buffer_length);
         DEBUG_PRINT("Allocated fd(%d) Buffer[%d] pointer: %p, length: %d", fd, i, memory,
                     buffer_length);
-
-        auto request = camera_->createRequest();
-        if (!request) {
-            ERROR_PRINT("Can't create camera request");
-        }
-        int ret = request->addBuffer(stream_, buffer.get());
-        if (ret < 0) {
-            ERROR_PRINT("Can't set buffer for request");
-        }
-        requests_.push_back(std::move(request));
     }
 }
 
 void LibcameraCapturer::RequestComplete(libcamera::Request *request) {
+    // Completions arrive on libcamera's own camera manager thread, which nothing here starts.
+    thread_policy::ApplyOnce("libcamera");
+
     if (request->status() == libcamera::Request::RequestCancelled) {
         DEBUG_PRINT("Request has been cancelled");
         exit(1);
@@ -288,25 +430,67 @@ void LibcameraCapturer::RequestComplete(libcamera::Request *request) {
     const bool traced = latency::Enabled();
     const int64_t callback_start_us = traced ? latency::NowUs() : 0;
 
-    auto &buffers = request->buffers();
-    auto *buffer = buffers.begin()->second;
+    // A lent request goes back to the camera when the last frame from it is released.
+    std::shared_ptr<void> lease;
+    if (ledger_->TryLend(buffer_count_)) {
+        lease = std::shared_ptr<void>(nullptr, [ledger = ledger_, request](void *) {
+            ledger->Return(request);
+        });
+    }
+
+    auto wrap = [this, &lease](libcamera::FrameBuffer *buffer, int width, int height) {
+        int fd = buffer->planes()[0].fd.get();
+        void *data = mapped_buffers_[fd].first;
+        int length = mapped_buffers_[fd].second;
+        timeval tv = {};
+        tv.tv_sec = buffer->metadata().timestamp / 1000000000;
+        tv.tv_usec = (buffer->metadata().timestamp % 1000000000) / 1000;
+
+        auto v4l2_buffer = V4L2Buffer::FromLibcamera((uint8_t *)data, length, fd, tv, format_);
+        if (lease) {
+            return V4L2FrameBuffer::Create(width, height, v4l2_buffer, [lease]() mutable {
+                lease.reset();
+            });
+        }
+        return V4L2FrameBuffer::Create(width, height, v4l2_buffer);
+    };
+
+    auto frame_buffer = wrap(request->findBuffer(stream_), width_, height_);
+    V4L2FrameBufferRef sub_frame_buffer;
+    if (sub_stream_) {
+        sub_frame_buffer = wrap(request->findBuffer(sub_stream_), sub_width_, sub_height_);
+    }
+
+    if (traced) {
+        latency::RecordCapture(latency::SensorUs(frame_buffer->timestamp()), callback_start_us);
+    }
 
-    int fd = buffer->planes()[0].fd.get();
-    void *data = mapped_buffers_[fd].first;
-    int length = mapped_buffers_[fd].second;
-    timeval tv = {};
-    tv.tv_sec = buffer->metadata().timestamp / 1000000000;
-    tv.tv_usec = (buffer->metadata().timestamp % 1000000000) / 1000;
+    stream_subject_.Next(frame_buffer);
+    latest_frame(0).Post(frame_buffer);
 
-    auto v4l2_buffer = V4L2Buffer::FromLibcamera((uint8_t *)data, length, fd, tv, format_);
-    frame_buffer_ = V4L2FrameBuffer::Create(width_, height_, v4l2_buffer);
+    // One pyramid per frame, shared by the level subscribers and a software sub stream.
+    FramePyramid pyramid(frame_buffer);
+    PublishLevels(pyramid);
+    if (sub_stream_) {
+        sub_stream_subject_.Next(sub_frame_buffer);
+        latest_frame(1).Post(sub_frame_buffer);
+    } else if (sub_scaler_) {
+        sub_scaler_->OnFrame(pyramid);
+        latest_frame(1).Post(frame_buffer->timestamp(), [&]() {
+            return sub_scaler_->GetI420Frame(pyramid);
+        });
+    }
 
     if (traced) {
-        latency::RecordCapture(latency::SensorUs(tv), callback_start_us);
+        latency::RecordSince(latency::Stage::kCaptureCallback, callback_start_us);
     }
 
-    stream_subject_.Next(frame_buffer_);
+    if (!lease) {
+        QueueRequest(request);
+    }
+}
 
+void LibcameraCapturer::QueueRequest(libcamera::Request *request) {
     request->reuse(libcamera::Request::ReuseBuffers);
 
     {
@@ -318,19 +502,16 @@ void LibcameraCapturer::RequestComplete(libcamera::Request *request) {
         }
     }
 
-    if (traced) {
-        latency::RecordSince(latency::Stage::kCaptureCallback, callback_start_us);
-    }
-
     camera_->queueRequest(request);
 }
 
-webrtc::scoped_refptr<webrtc::I420BufferInterface> LibcameraCapturer::GetI420Frame(int stream_idx) {
-    return frame_buffer_->ToI420();
-}
-
 Subscription LibcameraCapturer::Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                                           int stream_idx) {
+    if (stream_idx == 1 && sub_scaler_) {
+        return sub_scaler_->Subscribe(std::move(callback));
+    } else if (stream_idx == 1 && has_sub_stream()) {
+        return sub_stream_subject_.Subscribe(std::move(callback));
+    }
     return stream_subject_.Subscribe(std::move(callback));
 }
 
@@ -7,6 +7,7 @@
 #include <modules/video_capture/video_capture.h>
 
 #include "args.h"
+#include "capturer/sub_stream_scaler.h"
 #include "capturer/video_capturer.h"
 #include "common/interface/subject.h"
 #include "common/v4l2_frame_buffer.h"
@@ -22,18 +23,24 @@ class LibcameraCapturer : public VideoCapturer {
     int fps() const override;
     int width(int stream_idx = 0) const override;
     int height(int stream_idx = 0) const override;
-    bool is_dma_capture() const override;
+    bool has_sub_stream() const override;
+    bool is_dma_capture(int stream_idx = 0) const override;
     uint32_t format() const override;
     Args config() const override;
 
     bool SetControls(int key, int value) override;
     void StartCapture() override;
 
-    webrtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(int stream_idx = 0) override;
+    using VideoCapturer::Subscribe;
     Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                            int stream_idx = 0) override;
 
+  protected:
+    bool builds_pyramid() const override;
+
   private:
+    class RequestLedger;
+
     int camera_id_;
     int fps_;
     int width_;
@@ -52,16 +59,25 @@ class LibcameraCapturer : public VideoCapturer {
     std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
     std::vector<std::unique_ptr<libcamera::Request>> requests_;
     libcamera::Stream *stream_;
+    // The ISP's second output when it has one; sub_scaler_ stands in for it when it does not.
+    libcamera::Stream *sub_stream_;
+    int sub_width_;
+    int sub_height_;
     libcamera::ControlList controls_;
     std::map<int, std::pair<void *, unsigned int>> mapped_buffers_;
 
-    V4L2FrameBufferRef frame_buffer_;
     Subject<V4L2FrameBufferRef> stream_subject_;
+    Subject<V4L2FrameBufferRef> sub_stream_subject_;
+    std::unique_ptr<SubStreamScaler> sub_scaler_;
+    std::shared_ptr<RequestLedger> ledger_;
 
     void InitCamera();
+    std::unique_ptr<libcamera::CameraConfiguration> GenerateConfiguration(bool with_sub_stream);
+    void AllocateStreamBuffers(libcamera::Stream *stream);
     void InitControls(Args arg);
     void AllocateBuffer();
     void RequestComplete(libcamera::Request *request);
+    void QueueRequest(libcamera::Request *request);
 };
 
 #endif
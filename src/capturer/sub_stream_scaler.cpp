@@ -0,0 +1,56 @@
+#include "capturer/sub_stream_scaler.h"
+
+#include "common/frame_scaler.h"
+
+SubStreamScaler::SubStreamScaler(int width, int height)
+    : width_(width),
+      height_(height) {}
+
+int SubStreamScaler::width() const { return width_; }
+
+int SubStreamScaler::height() const { return height_; }
+
+bool SubStreamScaler::has_subscribers() const { return stream_subject_.ObserverCount() > 0; }
+
+void SubStreamScaler::OnFrame(FramePyramid &pyramid) {
+    if (!has_subscribers()) {
+        return;
+    }
+
+    auto scaled = Scale(pyramid);
+    if (!scaled) {
+        return;
+    }
+    frame_buffer_ = scaled;
+    stream_subject_.Next(scaled);
+}
+
+webrtc::scoped_refptr<webrtc::I420BufferInterface>
+SubStreamScaler::GetI420Frame(FramePyramid &pyramid) {
+    auto scaled = frame_buffer_;
+    if (scaled) {
+        const timeval scaled_at = scaled->timestamp();
+        const timeval latest_at = pyramid.Level(0)->timestamp();
+        if (timercmp(&scaled_at, &latest_at, !=)) {
+            scaled = nullptr;
+        }
+    }
+    if (!scaled) {
+        scaled = Scale(pyramid);
+    }
+    return scaled ? scaled->ToI420() : nullptr;
+}
+
+Subscription SubStreamScaler::Subscribe(Subject<V4L2FrameBufferRef>::Callback callback) {
+    return stream_subject_.Subscribe(std::move(callback));
+}
+
+V4L2FrameBufferRef SubStreamScaler::Scale(FramePyramid &pyramid) const {
+    auto scaled = pyramid.Scale(width_, height_);
+    // At the main stream's own size the pyramid hands back the frame itself, which may be a
+    // capture buffer.
+    if (scaled && scaled == pyramid.Level(0)) {
+        return frame_scaler::Scale(scaled, 0, 0, width_, height_, width_, height_);
+    }
+    return scaled;
+}
@@ -0,0 +1,38 @@
+#ifndef SUB_STREAM_SCALER_H_
+#define SUB_STREAM_SCALER_H_
+
+#include "common/frame_pyramid.h"
+#include "common/interface/subject.h"
+#include "common/v4l2_frame_buffer.h"
+
+// The sub stream of a capturer whose hardware has only one output. Each main frame is scaled
+// once, here, and the result is shared by every sub-stream subscriber instead of each consumer
+// scaling on its own. It is taken from the main frame's FramePyramid, the one the capturer's
+// level subscribers get, so the halvings above the sub-stream size are built once for both.
+// Nothing is scaled while nobody is subscribed.
+//
+// Output frames are I420 and own their memory, so subscribers may keep them without a copy.
+class SubStreamScaler {
+  public:
+    SubStreamScaler(int width, int height);
+
+    int width() const;
+    int height() const;
+    bool has_subscribers() const;
+
+    void OnFrame(FramePyramid &pyramid);
+    // Reuses the last scaled frame if it came from the same frame as `pyramid`, and scales from
+    // `pyramid` otherwise.
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(FramePyramid &pyramid);
+    Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback);
+
+  private:
+    const int width_;
+    const int height_;
+    V4L2FrameBufferRef frame_buffer_;
+    Subject<V4L2FrameBufferRef> stream_subject_;
+
+    V4L2FrameBufferRef Scale(FramePyramid &pyramid) const;
+};
+
+#endif // SUB_STREAM_SCALER_H_
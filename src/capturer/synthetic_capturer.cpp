@@ -0,0 +1,426 @@
+#include "capturer/synthetic_capturer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "common/latency_tracer.h"
+#include "common/logging.h"
+
+namespace {
+
+const int kSlotAlignment = 64;
+
+struct Yuv {
+    uint8_t y;
+    uint8_t u;
+    uint8_t v;
+};
+
+// 75% colour bars in BT.601 limited range, left to right.
+const Yuv kBars[] = {
+    {180, 128, 128}, {162, 44, 142}, {131, 156, 44}, {112, 72, 58},
+    {84, 184, 198},  {65, 100, 212}, {35, 212, 114}, {16, 128, 128},
+};
+const int kBarCount = sizeof(kBars) / sizeof(kBars[0]);
+const Yuv kBoxColor = {235, 128, 128};
+
+bool EndsWith(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+std::shared_ptr<SyntheticCapturer> SyntheticCapturer::Create(Args args) {
+    auto ptr = std::make_shared<SyntheticCapturer>(args);
+    ptr->Initialize();
+    ptr->StartCapture();
+    return ptr;
+}
+
+SyntheticCapturer::SyntheticCapturer(Args args)
+    : fps_(args.fps),
+      width_(args.width),
+      height_(args.height),
+      hw_accel_(args.hw_accel),
+      realtime_(args.replay_pacing == "realtime"),
+      format_(args.format),
+      config_(args),
+      source_type_(SourceType::Bars),
+      source_(args.source_path),
+      file_fd_(-1),
+      file_data_(nullptr),
+      file_size_(0),
+      first_keyframe_(0),
+      next_frame_(0),
+      frame_count_(0),
+      noise_state_(0x9E3779B97F4A7C15ull) {}
+
+SyntheticCapturer::~SyntheticCapturer() {
+    worker_.reset();
+    decoder_.reset();
+    if (file_data_) {
+        munmap(file_data_, file_size_);
+    }
+    if (file_fd_ >= 0) {
+        close(file_fd_);
+    }
+}
+
+void SyntheticCapturer::Initialize() {
+    if (config_.camera_source == CameraSource::Pattern) {
+        if (source_ == "bars") {
+            source_type_ = SourceType::Bars;
+        } else if (source_ == "noise") {
+            source_type_ = SourceType::Noise;
+        } else {
+            throw std::runtime_error("Unknown test pattern: " + source_ +
+                                     ". Expected 'bars' or 'noise'");
+        }
+    } else if (format_ == V4L2_PIX_FMT_H264) {
+        source_type_ = SourceType::H264;
+    } else if (EndsWith(source_, ".y4m")) {
+        source_type_ = SourceType::Y4M;
+    } else {
+        source_type_ = SourceType::RawI420;
+    }
+
+    if (source_type_ == SourceType::H264 && !hw_accel_) {
+        INFO_PRINT("Software decoding H264 camera source is not supported.");
+        exit(EXIT_FAILURE);
+    }
+
+    if (IsFileSource()) {
+        MapFile();
+        if (source_type_ == SourceType::Y4M) {
+            IndexY4M();
+        } else if (source_type_ == SourceType::RawI420) {
+            IndexRawI420();
+        } else {
+            IndexH264();
+        }
+
+        if (frames_.empty()) {
+            throw std::runtime_error("No frames found in " + source_);
+        }
+        INFO_PRINT("Replaying %zu frames from %s", frames_.size(), source_.c_str());
+    }
+
+    // Y4M carries its own size, which is why this is checked only after indexing.
+    if (width_ <= 0 || height_ <= 0 || width_ % 2 || height_ % 2) {
+        throw std::runtime_error("Synthetic source needs an even, non-zero resolution, got " +
+                                 std::to_string(width_) + "x" + std::to_string(height_));
+    }
+    config_.width = width_;
+    config_.height = height_;
+
+    if (!IsFileSource()) {
+        InitPattern();
+    }
+
+    frame_interval_ = std::chrono::microseconds(1000000 / std::max(fps_, 1));
+    INFO_PRINT("Synthetic source %s at %dx%d, %s", source_.c_str(), width_, height_,
+               realtime_ ? "paced to --fps" : "unpaced");
+}
+
+void SyntheticCapturer::MapFile() {
+    file_fd_ = open(source_.c_str(), O_RDONLY);
+    if (file_fd_ < 0) {
+        throw std::runtime_error("Unable to open replay file: " + source_);
+    }
+
+    struct stat st = {};
+    if (fstat(file_fd_, &st) < 0 || st.st_size <= 0) {
+        throw std::runtime_error("Replay file is empty or unreadable: " + source_);
+    }
+    file_size_ = st.st_size;
+
+    void *data = mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, file_fd_, 0);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Unable to map replay file: " + source_);
+    }
+    file_data_ = static_cast<uint8_t *>(data);
+}
+
+void SyntheticCapturer::IndexY4M() {
+    const char *data = reinterpret_cast<const char *>(file_data_);
+    const char *header_end = static_cast<const char *>(memchr(data, '\n', file_size_));
+    if (file_size_ < 10 || memcmp(data, "YUV4MPEG2 ", 10) != 0 || !header_end) {
+        throw std::runtime_error("Not a Y4M file: " + source_);
+    }
+
+    std::istringstream header(std::string(data + 10, header_end));
+    std::string token;
+    while (header >> token) {
+        if (token[0] == 'W') {
+            width_ = std::stoi(token.substr(1));
+        } else if (token[0] == 'H') {
+            height_ = std::stoi(token.substr(1));
+        } else if (token[0] == 'C' && token != "C420" && token != "C420jpeg" &&
+                   token != "C420paldv" && token != "C420mpeg2") {
+            throw std::runtime_error("Only 8-bit 4:2:0 Y4M files are supported, got " + token);
+        }
+    }
+
+    const size_t frame_size = static_cast<size_t>(width_) * height_ * 3 / 2;
+    size_t pos = header_end - data + 1;
+    while (pos + 5 <= file_size_ && memcmp(data + pos, "FRAME", 5) == 0) {
+        const char *frame_header_end =
+            static_cast<const char *>(memchr(data + pos, '\n', file_size_ - pos));
+        if (!frame_header_end) {
+            break;
+        }
+        const size_t offset = frame_header_end - data + 1;
+        if (offset + frame_size > file_size_) {
+            break;
+        }
+        frames_.push_back({offset, frame_size, 0});
+        pos = offset + frame_size;
+    }
+}
+
+void SyntheticCapturer::IndexRawI420() {
+    const size_t frame_size = static_cast<size_t>(width_) * height_ * 3 / 2;
+    if (frame_size == 0) {
+        return;
+    }
+    if (file_size_ % frame_size != 0) {
+        INFO_PRINT("%s is not a whole number of %dx%d I420 frames, the tail is ignored.",
+                   source_.c_str(), width_, height_);
+    }
+    for (size_t offset = 0; offset + frame_size <= file_size_; offset += frame_size) {
+        frames_.push_back({offset, frame_size, 0});
+    }
+}
+
+void SyntheticCapturer::IndexH264() {
+    // Group NAL units into access units. A new one starts at an SEI, SPS, PPS or AUD, or at a
+    // slice whose first_mb_in_slice is 0, once the current unit already holds a slice. Each frame
+    // keeps its start codes, which is what the decoder and the raw H264 recorder expect.
+    FrameSpan current = {0, 0, 0};
+    bool open = false;
+    bool has_slice = false;
+
+    for (size_t i = 0; i + 3 < file_size_; i++) {
+        if (file_data_[i] != 0 || file_data_[i + 1] != 0 || file_data_[i + 2] != 1) {
+            continue;
+        }
+
+        const size_t nal_start = (i > 0 && file_data_[i - 1] == 0) ? i - 1 : i;
+        const uint8_t nal_type = file_data_[i + 3] & 0x1f;
+        const bool is_slice = nal_type == 1 || nal_type == 5;
+        const bool first_slice = is_slice && i + 4 < file_size_ && (file_data_[i + 4] & 0x80);
+        const bool starts_unit = (nal_type >= 6 && nal_type <= 9) || first_slice;
+
+        if (open && has_slice && starts_unit) {
+            current.length = nal_start - current.offset;
+            frames_.push_back(current);
+            open = false;
+        }
+        if (!open) {
+            current = {nal_start, 0, 0};
+            open = true;
+            has_slice = false;
+        }
+        if (is_slice) {
+            has_slice = true;
+        }
+        if (nal_type == 5) {
+            current.flags |= V4L2_BUF_FLAG_KEYFRAME;
+        }
+        i += 3;
+    }
+
+    if (open && has_slice) {
+        current.length = file_size_ - current.offset;
+        frames_.push_back(current);
+    }
+
+    // Looping back to a delta frame would leave the decoder without a reference.
+    auto it = std::find_if(frames_.begin(), frames_.end(), [](const FrameSpan &span) {
+        return (span.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
+    });
+    if (!frames_.empty() && it == frames_.end()) {
+        throw std::runtime_error("No IDR frame found in " + source_);
+    }
+    first_keyframe_ = it - frames_.begin();
+    next_frame_ = first_keyframe_;
+}
+
+void SyntheticCapturer::InitPattern() {
+    const size_t frame_size = static_cast<size_t>(width_) * height_ * 3 / 2;
+
+    for (int i = 0; i < kPatternSlots; i++) {
+        std::unique_ptr<uint8_t, webrtc::AlignedFreeDeleter> slot(
+            static_cast<uint8_t *>(webrtc::AlignedMalloc(frame_size, kSlotAlignment)));
+        // Noise is filled in as each frame is handed out.
+        if (source_type_ == SourceType::Bars) {
+            DrawBars(slot.get(), 0, 0, width_, height_);
+        }
+        slots_.push_back(std::move(slot));
+    }
+    slot_box_x_.assign(kPatternSlots, -1);
+}
+
+void SyntheticCapturer::DrawBars(uint8_t *dst, int x, int y, int w, int h) const {
+    uint8_t *dst_y = dst;
+    uint8_t *dst_u = dst_y + width_ * height_;
+    uint8_t *dst_v = dst_u + (width_ / 2) * (height_ / 2);
+
+    for (int row = y; row < y + h; row++) {
+        for (int col = x; col < x + w; col++) {
+            dst_y[row * width_ + col] = kBars[col * kBarCount / width_].y;
+        }
+    }
+    for (int row = y / 2; row < (y + h) / 2; row++) {
+        for (int col = x / 2; col < (x + w) / 2; col++) {
+            const Yuv &bar = kBars[col * 2 * kBarCount / width_];
+            dst_u[row * (width_ / 2) + col] = bar.u;
+            dst_v[row * (width_ / 2) + col] = bar.v;
+        }
+    }
+}
+
+void SyntheticCapturer::DrawBox(uint8_t *dst, int x, int y, int size) const {
+    uint8_t *dst_y = dst;
+    uint8_t *dst_u = dst_y + width_ * height_;
+    uint8_t *dst_v = dst_u + (width_ / 2) * (height_ / 2);
+
+    for (int row = y; row < y + size; row++) {
+        memset(dst_y + row * width_ + x, kBoxColor.y, size);
+    }
+    for (int row = y / 2; row < (y + size) / 2; row++) {
+        memset(dst_u + row * (width_ / 2) + x / 2, kBoxColor.u, size / 2);
+        memset(dst_v + row * (width_ / 2) + x / 2, kBoxColor.v, size / 2);
+    }
+}
+
+bool SyntheticCapturer::IsFileSource() const {
+    return source_type_ == SourceType::Y4M || source_type_ == SourceType::RawI420 ||
+           source_type_ == SourceType::H264;
+}
+
+V4L2Buffer SyntheticCapturer::NextPatternFrame() {
+    const int slot_idx = frame_count_ % kPatternSlots;
+    uint8_t *slot = slots_[slot_idx].get();
+
+    if (source_type_ == SourceType::Bars) {
+        // The box crosses the frame every 4 seconds. Only the box moves, so the bars are redrawn
+        // just where this slot last had it instead of repainting the whole frame.
+        const int box = (std::min(width_, height_) / 4) & ~1;
+        const int box_y = ((height_ - box) / 2) & ~1;
+        const int travel = width_ - box;
+        const int step = std::max(2, travel / (std::max(fps_, 1) * 4)) & ~1;
+        const int box_x = travel > 0 ? static_cast<int>((frame_count_ * step) % travel) & ~1 : 0;
+
+        if (slot_box_x_[slot_idx] >= 0) {
+            DrawBars(slot, slot_box_x_[slot_idx], box_y, box, box);
+        }
+        DrawBox(slot, box_x, box_y, box);
+        slot_box_x_[slot_idx] = box_x;
+    } else {
+        // Fresh for every frame, so that no reference frame predicts any of it: the worst case
+        // an encoder can be handed. xorshift64 fills eight bytes a step, cheap next to the encode.
+        const size_t frame_size = static_cast<size_t>(width_) * height_ * 3 / 2;
+        uint64_t state = noise_state_;
+        for (size_t i = 0; i < frame_size; i += sizeof(state)) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            memcpy(slot + i, &state, std::min(sizeof(state), frame_size - i));
+        }
+        noise_state_ = state;
+    }
+
+    frame_count_++;
+    return V4L2Buffer(slot, V4L2_PIX_FMT_YUV420, width_ * height_ * 3 / 2, -1, 0, {0, 0});
+}
+
+V4L2Buffer SyntheticCapturer::NextFileFrame() {
+    if (next_frame_ >= frames_.size()) {
+        next_frame_ = first_keyframe_;
+    }
+    const FrameSpan &span = frames_[next_frame_++];
+    return V4L2Buffer(file_data_ + span.offset, format_, span.length, -1, span.flags, {0, 0});
+}
+
+void SyntheticCapturer::WaitForNextFrame() {
+    if (!realtime_) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    // A stall longer than a frame is not made up with a burst, a sensor would have dropped
+    // those frames as well.
+    if (now - next_deadline_ > frame_interval_) {
+        next_deadline_ = now;
+    }
+    std::this_thread::sleep_until(next_deadline_);
+    next_deadline_ += frame_interval_;
+}
+
+void SyntheticCapturer::CaptureImage() {
+    WaitForNextFrame();
+
+    auto buffer = IsFileSource() ? NextFileFrame() : NextPatternFrame();
+
+    timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    buffer.timestamp.tv_sec = ts.tv_sec;
+    buffer.timestamp.tv_usec = ts.tv_nsec / 1000;
+
+    if (latency::Enabled()) {
+        latency::RecordCapture(latency::SensorUs(buffer.timestamp), latency::NowUs());
+    }
+
+    auto frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer);
+
+    if (source_type_ == SourceType::H264) {
+        if (!decoder_) {
+            decoder_ = V4L2Decoder::Create({width_, height_, format_, true});
+        }
+
+        const timeval timestamp = buffer.timestamp;
+        decoder_->EmplaceBuffer(frame_buffer, [this, timestamp](V4L2FrameBufferRef decoded_buffer) {
+            // hw decoder doesn't output timestamps.
+            decoded_buffer->SetTimestamp(timestamp);
+            stream_subject_.Next(decoded_buffer);
+            latest_frame().Post(decoded_buffer);
+        });
+    } else {
+        stream_subject_.Next(frame_buffer);
+        latest_frame().Post(frame_buffer);
+    }
+}
+
+int SyntheticCapturer::fps() const { return fps_; }
+
+int SyntheticCapturer::width(int stream_idx) const { return width_; }
+
+int SyntheticCapturer::height(int stream_idx) const { return height_; }
+
+bool SyntheticCapturer::is_dma_capture(int stream_idx) const { return source_type_ == SourceType::H264; }
+
+uint32_t SyntheticCapturer::format() const { return format_; }
+
+Args SyntheticCapturer::config() const { return config_; }
+
+Subscription SyntheticCapturer::Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
+                                          int stream_idx) {
+    return stream_subject_.Subscribe(std::move(callback));
+}
+
+void SyntheticCapturer::StartCapture() {
+    next_deadline_ = std::chrono::steady_clock::now();
+
+    worker_ = std::make_unique<Worker>("Synthetic Capturer", [this]() {
+        CaptureImage();
+    });
+    worker_->Run();
+}
@@ -0,0 +1,103 @@
+#ifndef SYNTHETIC_CAPTURER_H_
+#define SYNTHETIC_CAPTURER_H_
+
+#include <chrono>
+#include <vector>
+
+#include "args.h"
+#include "capturer/video_capturer.h"
+#include "codecs/v4l2/v4l2_decoder.h"
+#include "common/interface/subject.h"
+#include "common/v4l2_frame_buffer.h"
+#include "common/worker.h"
+
+#include <rtc_base/memory/aligned_malloc.h>
+
+// A camera-free video source: a generated test pattern, or a Y4M, raw I420 or Annex-B H.264 file
+// replayed in a loop. Frames are stamped with CLOCK_MONOTONIC when they are handed out, so every
+// downstream stage, the latency tracer included, sees them exactly as it would a sensor's.
+class SyntheticCapturer : public VideoCapturer {
+  public:
+    static std::shared_ptr<SyntheticCapturer> Create(Args args);
+
+    SyntheticCapturer(Args args);
+    ~SyntheticCapturer() override;
+
+    int fps() const override;
+    int width(int stream_idx = 0) const override;
+    int height(int stream_idx = 0) const override;
+    bool is_dma_capture(int stream_idx = 0) const override;
+    uint32_t format() const override;
+    Args config() const override;
+
+    void StartCapture() override;
+
+    using VideoCapturer::Subscribe;
+    Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
+                           int stream_idx = 0) override;
+
+  private:
+    enum class SourceType {
+        Bars,
+        Noise,
+        Y4M,
+        RawI420,
+        H264,
+    };
+
+    struct FrameSpan {
+        size_t offset;
+        size_t length;
+        uint32_t flags;
+    };
+
+    // Patterns render into a small ring, the same way a device cycles through its mmap buffers.
+    static constexpr int kPatternSlots = 4;
+
+    int fps_;
+    int width_;
+    int height_;
+    bool hw_accel_;
+    bool realtime_;
+    uint32_t format_;
+    Args config_;
+    SourceType source_type_;
+    std::string source_;
+
+    // File sources are mapped once and handed out in place, so replay costs no copy.
+    int file_fd_;
+    uint8_t *file_data_;
+    size_t file_size_;
+    std::vector<FrameSpan> frames_;
+    size_t first_keyframe_;
+    size_t next_frame_;
+
+    std::vector<std::unique_ptr<uint8_t, webrtc::AlignedFreeDeleter>> slots_;
+    std::vector<int> slot_box_x_;
+    uint64_t frame_count_;
+    uint64_t noise_state_;
+
+    std::chrono::steady_clock::duration frame_interval_;
+    std::chrono::steady_clock::time_point next_deadline_;
+
+    std::unique_ptr<Worker> worker_;
+    std::unique_ptr<V4L2Decoder> decoder_;
+
+    Subject<V4L2FrameBufferRef> stream_subject_;
+
+    void Initialize();
+    void MapFile();
+    void IndexY4M();
+    void IndexRawI420();
+    void IndexH264();
+    void InitPattern();
+    void DrawBars(uint8_t *dst, int x, int y, int w, int h) const;
+    void DrawBox(uint8_t *dst, int x, int y, int size) const;
+    bool IsFileSource() const;
+    V4L2Buffer NextPatternFrame();
+    V4L2Buffer NextFileFrame();
+    void WaitForNextFrame();
+    void CaptureImage();
+};
+
+#endif // SYNTHETIC_CAPTURER_H_
@@ -2,14 +2,81 @@
 
 // Linux
 #include <linux/videodev2.h>
+#include <sys/epoll.h>
 #include <sys/mman.h>
 #include <sys/select.h>
 
+#include <algorithm>
+#include <mutex>
+
 // WebRTC
 #include <modules/video_capture/video_capture_factory.h>
 #include <third_party/libyuv/include/libyuv.h>
 
+#include "common/event_loop.h"
 #include "common/logging.h"
+#include "common/mjpeg_decoder.h"
+
+namespace {
+
+// With deferred requeue, a buffer is lent out only while the driver is still left with this many
+// to fill; below it the capture pool grows, and once it cannot the frame is queued back straight
+// after delivery as before.
+constexpr int kMinFreeBuffers = 2;
+constexpr int kMaxBufferCount = 12;
+
+} // namespace
+
+// Counts the capture buffers lent out to subscribers in deferred-requeue mode. Frames hold a
+// reference to the ledger rather than to the capturer, so one released after the capturer is gone
+// neither queues into a stopped device nor leaves the mapping behind: the last of them closes it.
+class V4L2Capturer::BufferLedger {
+  public:
+    explicit BufferLedger(int fd)
+        : fd_(fd),
+          held_(0),
+          retired_(false) {}
+
+    int held() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return held_;
+    }
+
+    void Hold() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        held_++;
+    }
+
+    void Release(v4l2_buffer buf) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        held_--;
+        if (!retired_) {
+            v4l2_util::QueueBuffer(fd_, &buf);
+        } else if (held_ == 0) {
+            v4l2_util::DeallocateBuffer(fd_, &group_);
+            v4l2_util::CloseDevice(fd_);
+        }
+    }
+
+    // Called once the stream is off. Returns true when frames are still out, in which case the
+    // device is left to the last of them to close.
+    bool Retire(const V4L2BufferGroup &group) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        retired_ = true;
+        if (held_ == 0) {
+            return false;
+        }
+        group_ = group;
+        return true;
+    }
+
+  private:
+    std::mutex mtx_;
+    int fd_;
+    int held_;
+    bool retired_;
+    V4L2BufferGroup group_;
+};
 
 std::shared_ptr<V4L2Capturer> V4L2Capturer::Create(Args args) {
     auto ptr = std::make_shared<V4L2Capturer>(args);
@@ -28,19 +95,37 @@ V4L2Capturer::V4L2Capturer(Args args)
       buffer_count_(4),
       hw_accel_(args.hw_accel),
       has_first_keyframe_(false),
+      decode_all_(false),
+      key_frame_requested_(false),
+      can_grow_buffers_(true),
       format_(args.format),
-      config_(args) {}
+      config_(args) {
+    if (args.num_streams > 1) {
+        sub_stream_ = std::make_unique<SubStreamScaler>(args.sub_width, args.sub_height);
+    }
+}
 
 V4L2Capturer::~V4L2Capturer() {
+    if (auto *event_loop = EventLoop::Shared()) {
+        event_loop->Remove(fd_);
+    }
     worker_.reset();
     decoder_.reset();
     v4l2_util::StreamOff(fd_, capture_.type);
+    if (ledger_ && ledger_->Retire(capture_)) {
+        return;
+    }
     v4l2_util::DeallocateBuffer(fd_, &capture_);
     v4l2_util::CloseDevice(fd_);
 }
 
 void V4L2Capturer::Initialize() {
-    if (!hw_accel_ && format_ == V4L2_PIX_FMT_H264) {
+    // Without the hardware decoder an H.264 camera serves only its encoded main stream, which the
+    // recorder and --shared-encoder take as it is. WebRTC otherwise, and the sub stream, want raw
+    // frames.
+    const bool wants_raw_frames = (config_.webrtc && !config_.shared_encoder) ||
+                                  config_.record_stream_idx != 0 || sub_stream_;
+    if (!hw_accel_ && format_ == V4L2_PIX_FMT_H264 && wants_raw_frames) {
         INFO_PRINT("Software decoding H264 camera source is not supported.");
         exit(EXIT_FAILURE);
     }
@@ -61,7 +146,12 @@ void V4L2Capturer::Initialize() {
         if (!SetControls(V4L2_CID_MPEG_VIDEO_BITRATE_MODE, V4L2_MPEG_VIDEO_BITRATE_MODE_VBR)) {
             ERROR_PRINT("Unable to set VBR mode");
         }
-        if (!SetControls(V4L2_CID_MPEG_VIDEO_H264_PROFILE, V4L2_MPEG_VIDEO_H264_PROFILE_HIGH)) {
+        // A main stream sent over WebRTC is forwarded as it is, and so has to be in the profile
+        // every browser decodes.
+        const int profile = config_.webrtc && config_.live_stream_idx == 0
+                                ? V4L2_MPEG_VIDEO_H264_PROFILE_CONSTRAINED_BASELINE
+                                : V4L2_MPEG_VIDEO_H264_PROFILE_HIGH;
+        if (!SetControls(V4L2_CID_MPEG_VIDEO_H264_PROFILE, profile)) {
             ERROR_PRINT("Unable to set H264 profile");
         }
         if (!SetControls(V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, true)) {
@@ -97,16 +187,56 @@ void V4L2Capturer::Initialize() {
 
 int V4L2Capturer::fps() const { return fps_; }
 
-int V4L2Capturer::width(int stream_idx) const { return width_; }
+int V4L2Capturer::width(int stream_idx) const {
+    return IsSubStream(stream_idx) ? sub_stream_->width() : width_;
+}
 
-int V4L2Capturer::height(int stream_idx) const { return height_; }
+int V4L2Capturer::height(int stream_idx) const {
+    return IsSubStream(stream_idx) ? sub_stream_->height() : height_;
+}
 
-bool V4L2Capturer::is_dma_capture() const { return hw_accel_ && IsCompressedFormat(); }
+bool V4L2Capturer::has_sub_stream() const { return sub_stream_ != nullptr; }
+
+bool V4L2Capturer::builds_pyramid() const { return true; }
+
+// The sub stream is scaled in software, so only the main one carries the decoder's dma buffers.
+bool V4L2Capturer::is_dma_capture(int stream_idx) const {
+    return hw_accel_ && IsCompressedFormat() && !IsSubStream(stream_idx);
+}
 
 uint32_t V4L2Capturer::format() const { return format_; }
 
 Args V4L2Capturer::config() const { return config_; }
 
+bool V4L2Capturer::IsSubStream(int stream_idx) const { return stream_idx == 1 && sub_stream_; }
+
+bool V4L2Capturer::HasRawSubscribers() const {
+    return stream_subject_.ObserverCount() > 0 || has_level_subscribers() ||
+           (sub_stream_ && sub_stream_->has_subscribers());
+}
+
+// Frames are decoded only while something takes raw frames. Otherwise the key frames alone are,
+// which decode on their own and keep GetLatestFrame() within a GOP of the present. Going back to
+// decoding every frame has to start on a key frame, so one is asked for instead of waiting.
+bool V4L2Capturer::ShouldDecode(const V4L2FrameBufferRef &frame_buffer) {
+    const bool is_keyframe = frame_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME;
+    if (is_keyframe) {
+        key_frame_requested_ = false;
+    }
+    if (!HasRawSubscribers()) {
+        decode_all_ = false;
+        return is_keyframe;
+    }
+    if (!decode_all_ && !is_keyframe) {
+        if (!key_frame_requested_) {
+            key_frame_requested_ = SetControls(V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME, 1);
+        }
+        return false;
+    }
+    decode_all_ = true;
+    return true;
+}
+
 bool V4L2Capturer::IsCompressedFormat() const {
     return format_ == V4L2_PIX_FMT_MJPEG || format_ == V4L2_PIX_FMT_H264;
 }
@@ -151,6 +281,10 @@ void V4L2Capturer::CaptureImage() {
         return;
     }
 
+    DequeueImage();
+}
+
+void V4L2Capturer::DequeueImage() {
     v4l2_buffer buf = {};
     buf.type = capture_.type;
     buf.memory = capture_.memory;
@@ -159,14 +293,38 @@ void V4L2Capturer::CaptureImage() {
         return;
     }
 
+    // A lent buffer is queued back by the last frame reference instead of here, so subscribers
+    // can keep it without a copy.
+    const bool lent = ledger_ && ReserveBuffer();
+
     auto buffer = V4L2Buffer::FromV4L2((uint8_t *)capture_.buffers[buf.index].start, buf, format_);
-    frame_buffer_ = V4L2FrameBuffer::Create(width_, height_, buffer);
-    if (hw_accel_ && format_ == V4L2_PIX_FMT_H264) {
+    V4L2FrameBufferRef frame_buffer;
+    if (lent) {
+        frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer, [ledger = ledger_, buf]() {
+            ledger->Release(buf);
+        });
+    } else {
+        frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer);
+    }
+
+    // The encoded stream does not depend on a decoder: the recorder and --shared-encoder take it
+    // as it is.
+    if (format_ == V4L2_PIX_FMT_H264) {
         if ((buffer.flags & V4L2_BUF_FLAG_KEYFRAME) != 0) {
             has_first_keyframe_ = true;
         }
         if (!has_first_keyframe_) {
-            v4l2_util::QueueBuffer(fd_, &buf);
+            if (!lent) {
+                v4l2_util::QueueBuffer(fd_, &buf);
+            }
+            return;
+        }
+
+        encoded_subject_.Next(frame_buffer);
+        if (!hw_accel_ || !ShouldDecode(frame_buffer)) {
+            if (!lent) {
+                v4l2_util::QueueBuffer(fd_, &buf);
+            }
             return;
         }
     }
@@ -176,33 +334,129 @@ void V4L2Capturer::CaptureImage() {
             decoder_ = V4L2Decoder::Create({width_, height_, format_, true});
         }
 
-        decoder_->EmplaceBuffer(frame_buffer_, [this, buffer](V4L2FrameBufferRef decoded_buffer) {
+        decoder_->EmplaceBuffer(frame_buffer, [this, buffer](V4L2FrameBufferRef decoded_buffer) {
             // hw decoder doesn't output timestamps.
-            decoded_buffer->GetRawBuffer().timestamp = buffer.timestamp;
-            stream_subject_.Next(decoded_buffer);
+            decoded_buffer->SetTimestamp(buffer.timestamp);
+            Publish(decoded_buffer);
         });
+    } else if (format_ == V4L2_PIX_FMT_MJPEG) {
+        PublishMjpeg(frame_buffer);
     } else {
-        stream_subject_.Next(frame_buffer_);
+        Publish(frame_buffer);
     }
 
-    if (!v4l2_util::QueueBuffer(fd_, &buf)) {
+    if (!lent && !v4l2_util::QueueBuffer(fd_, &buf)) {
         return;
     }
 }
 
-bool V4L2Capturer::SetControls(int key, int value) {
-    return v4l2_util::SetExtCtrl(fd_, key, value);
+void V4L2Capturer::Publish(V4L2FrameBufferRef frame_buffer) {
+    stream_subject_.Next(frame_buffer);
+    latest_frame(0).Post(frame_buffer);
+
+    // One pyramid per frame, shared by the level subscribers, the sub stream and its snapshot.
+    FramePyramid pyramid(frame_buffer);
+    PublishLevels(pyramid);
+    if (sub_stream_) {
+        sub_stream_->OnFrame(pyramid);
+        latest_frame(1).Post(frame_buffer->timestamp(), [&]() {
+            return sub_stream_->GetI420Frame(pyramid);
+        });
+    }
+}
+
+// Without a hardware decoder, a frame is decoded here once for every subscriber rather than by
+// libyuv inside each one's ToI420(). When only the sub stream is watched, the DCT-scaled decode
+// lands near its size and the main frame is never decoded in full.
+void V4L2Capturer::PublishMjpeg(V4L2FrameBufferRef frame_buffer) {
+    if (stream_subject_.ObserverCount() > 0 || has_level_subscribers()) {
+        if (auto decoded = mjpeg_decoder::Decode(frame_buffer, width_, height_)) {
+            Publish(decoded);
+        }
+        return;
+    }
+
+    latest_frame(0).Post(frame_buffer->timestamp(), [&]() -> LatestFrame::I420BufferRef {
+        auto decoded = mjpeg_decoder::Decode(frame_buffer, width_, height_);
+        return decoded ? decoded->ToI420() : nullptr;
+    });
+    if (!sub_stream_) {
+        return;
+    }
+
+    std::unique_ptr<FramePyramid> pyramid;
+    auto decode_sub_stream = [&]() {
+        if (!pyramid) {
+            if (auto decoded = mjpeg_decoder::Decode(frame_buffer, sub_stream_->width(),
+                                                     sub_stream_->height())) {
+                pyramid = std::make_unique<FramePyramid>(decoded);
+            }
+        }
+        return pyramid.get();
+    };
+    if (sub_stream_->has_subscribers() && decode_sub_stream()) {
+        sub_stream_->OnFrame(*pyramid);
+    }
+    latest_frame(1).Post(frame_buffer->timestamp(), [&]() -> LatestFrame::I420BufferRef {
+        return decode_sub_stream() ? sub_stream_->GetI420Frame(*pyramid) : nullptr;
+    });
+}
+
+bool V4L2Capturer::ReserveBuffer() {
+    // The buffer just dequeued is not counted as held yet.
+    const int free_buffers = static_cast<int>(capture_.num_buffers) - ledger_->held() - 1;
+    if (free_buffers < kMinFreeBuffers && !GrowBuffers(kMinFreeBuffers - free_buffers)) {
+        return false;
+    }
+    ledger_->Hold();
+    return true;
 }
 
-webrtc::scoped_refptr<webrtc::I420BufferInterface> V4L2Capturer::GetI420Frame(int stream_idx) {
-    return frame_buffer_->ToI420();
+bool V4L2Capturer::GrowBuffers(int count) {
+    count = std::min(count, kMaxBufferCount - buffer_count_);
+    if (!can_grow_buffers_ || count <= 0) {
+        return false;
+    }
+
+    const int first_index = capture_.num_buffers;
+    if (!v4l2_util::CreateBuffers(fd_, &capture_, count)) {
+        INFO_PRINT("Capture buffers cannot grow past %d, frames kept by subscribers are copied.",
+                   buffer_count_);
+        can_grow_buffers_ = false;
+        return false;
+    }
+
+    for (int i = first_index; i < capture_.num_buffers; i++) {
+        if (!v4l2_util::QueueBuffer(fd_, &capture_.buffers[i].inner)) {
+            can_grow_buffers_ = false;
+            return false;
+        }
+    }
+
+    buffer_count_ = capture_.num_buffers;
+    DEBUG_PRINT("Grew capture buffers to %d", buffer_count_);
+    return true;
+}
+
+bool V4L2Capturer::SetControls(int key, int value) {
+    return v4l2_util::SetExtCtrl(fd_, key, value);
 }
 
 Subscription V4L2Capturer::Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                                      int stream_idx) {
+    if (IsSubStream(stream_idx)) {
+        return sub_stream_->Subscribe(std::move(callback));
+    }
     return stream_subject_.Subscribe(std::move(callback));
 }
 
+Subscription V4L2Capturer::SubscribeEncoded(Subject<V4L2FrameBufferRef>::Callback callback) {
+    if (format_ != V4L2_PIX_FMT_H264) {
+        return Subscription();
+    }
+    return encoded_subject_.Subscribe(std::move(callback));
+}
+
 void V4L2Capturer::StartCapture() {
     if (!v4l2_util::AllocateBuffer(fd_, &capture_, buffer_count_) ||
         !v4l2_util::QueueBuffers(fd_, &capture_)) {
@@ -211,6 +465,21 @@ void V4L2Capturer::StartCapture() {
 
     v4l2_util::StreamOn(fd_, capture_.type);
 
+    if (config_.v4l2_deferred_requeue) {
+        ledger_ = std::make_shared<BufferLedger>(fd_);
+    }
+
+    if (auto *event_loop = EventLoop::Shared()) {
+        auto on_event = [this](uint32_t events) {
+            if (events & EPOLLIN) {
+                DequeueImage();
+            }
+        };
+        if (event_loop->Add(fd_, EPOLLIN, on_event)) {
+            return;
+        }
+    }
+
     worker_ = std::make_unique<Worker>("V4L2 Capturer", [this]() {
         CaptureImage();
     });
@@ -4,6 +4,7 @@
 #include <modules/video_capture/video_capture.h>
 
 #include "args.h"
+#include "capturer/sub_stream_scaler.h"
 #include "capturer/video_capturer.h"
 #include "codecs/v4l2/v4l2_decoder.h"
 #include "common/interface/subject.h"
@@ -21,18 +22,25 @@ class V4L2Capturer : public VideoCapturer {
     int fps() const override;
     int width(int stream_idx = 0) const override;
     int height(int stream_idx = 0) const override;
-    bool is_dma_capture() const override;
+    bool has_sub_stream() const override;
+    bool is_dma_capture(int stream_idx = 0) const override;
     uint32_t format() const override;
     Args config() const override;
 
     bool SetControls(int key, int value) override;
     void StartCapture() override;
 
-    webrtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(int stream_idx = 0) override;
+    using VideoCapturer::Subscribe;
     Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                            int stream_idx = 0) override;
+    Subscription SubscribeEncoded(Subject<V4L2FrameBufferRef>::Callback callback) override;
+
+  protected:
+    bool builds_pyramid() const override;
 
   private:
+    class BufferLedger;
+
     int camera_id_;
     int fd_;
     int fps_;
@@ -42,18 +50,34 @@ class V4L2Capturer : public VideoCapturer {
     int buffer_count_;
     bool hw_accel_;
     bool has_first_keyframe_;
+    // H.264 only: whether every frame goes to the decoder, or only key frames, see DequeueImage().
+    bool decode_all_;
+    bool key_frame_requested_;
+    bool can_grow_buffers_;
     uint32_t format_;
     Args config_;
     V4L2BufferGroup capture_;
     std::unique_ptr<Worker> worker_;
     std::unique_ptr<V4L2Decoder> decoder_;
+    // Only set with --v4l2-deferred-requeue.
+    std::shared_ptr<BufferLedger> ledger_;
 
-    V4L2FrameBufferRef frame_buffer_;
     Subject<V4L2FrameBufferRef> stream_subject_;
+    Subject<V4L2FrameBufferRef> encoded_subject_;
+    std::unique_ptr<SubStreamScaler> sub_stream_;
 
     void Initialize();
     bool IsCompressedFormat() const;
+    bool IsSubStream(int stream_idx) const;
+    bool HasRawSubscribers() const;
+    // Whether `frame_buffer` should go to the decoder; false when it is only forwarded.
+    bool ShouldDecode(const V4L2FrameBufferRef &frame_buffer);
+    void Publish(V4L2FrameBufferRef frame_buffer);
+    void PublishMjpeg(V4L2FrameBufferRef frame_buffer);
+    bool ReserveBuffer();
+    bool GrowBuffers(int count);
     void CaptureImage();
+    void DequeueImage();
     bool CheckMatchingDevice(std::string unique_name);
     int GetCameraIndex(webrtc::VideoCaptureModule::DeviceInfo *device_info);
 };
@@ -1,8 +1,19 @@
 #ifndef VIDEO_CAPTURER_H_
 #define VIDEO_CAPTURER_H_
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
 #include "args.h"
+#include "common/frame_decimator.h"
+#include "common/frame_mailbox.h"
+#include "common/frame_pyramid.h"
 #include "common/interface/subject.h"
+#include "common/latest_frame.h"
 #include "common/v4l2_frame_buffer.h"
 
 // multiple video stream capturer interface
@@ -15,14 +26,170 @@ class VideoCapturer {
     virtual int width(int stream_idx = 0) const = 0;
     virtual int height(int stream_idx = 0) const = 0;
     virtual bool has_sub_stream() const { return false; }
-    virtual bool is_dma_capture() const = 0;
+    virtual bool is_dma_capture(int stream_idx = 0) const = 0;
     virtual uint32_t format() const = 0;
     virtual Args config() const = 0;
     virtual void StartCapture() = 0;
-    virtual webrtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(int stream_idx = 0) = 0;
     virtual bool SetControls(int key, int value) { return false; };
     virtual Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                                    int stream_idx = 0) = 0;
+    // The main stream as the camera encoded it, for a camera that delivers H.264: every access
+    // unit from the first key frame on, ahead of any decode. Nothing from other cameras.
+    virtual Subscription SubscribeEncoded(Subject<V4L2FrameBufferRef>::Callback callback) {
+        return Subscription();
+    }
+
+    // Subscribes under a name that shows up in the thread names and the latency report. With
+    // --async-dispatch the callback runs on a thread of its own behind a bounded FrameMailbox, so
+    // it may take as long as it likes without holding up the capture thread. A `max_fps` above 0
+    // thins the stream out first, see FrameDecimator, so skipped frames cost nothing beyond the
+    // check.
+    Subscription Subscribe(const std::string &name, Subject<V4L2FrameBufferRef>::Callback callback,
+                           int stream_idx = 0, int max_fps = 0, int phase = 0) {
+        return SubscribeWith(name, std::move(callback), max_fps, phase,
+                             [this, stream_idx](Subject<V4L2FrameBufferRef>::Callback callback) {
+                                 return Subscribe(std::move(callback), stream_idx);
+                             });
+    }
+
+    // The same for a halving of the main stream, at 1/2^level of its size, taken from the
+    // FramePyramid built once per main frame, so consumers of smaller sizes share one cascade
+    // instead of each scaling the full frame. Level 0 is the main stream itself; levels deeper
+    // than kMaxPyramidLevel are clamped to it.
+    Subscription SubscribeLevel(const std::string &name, int level,
+                                Subject<V4L2FrameBufferRef>::Callback callback, int max_fps = 0,
+                                int phase = 0) {
+        if (level <= 0) {
+            return Subscribe(name, std::move(callback), 0, max_fps, phase);
+        }
+        level = std::min(level, kMaxPyramidLevel);
+        if (!builds_pyramid()) {
+            FeedPyramid();
+        }
+        return SubscribeWith(name, std::move(callback), max_fps, phase,
+                             [this, level](Subject<V4L2FrameBufferRef>::Callback callback) {
+                                 return level_subjects_[level - 1].Subscribe(std::move(callback));
+                             });
+    }
+
+    // The next frame of a stream as an owning I420 copy, with its sequence number and capture
+    // timestamp. Safe to call from any thread and to keep for as long as needed; the capture
+    // thread never waits on it.
+    LatestFrame::Frame GetLatestFrame(int stream_idx = 0,
+                                      std::chrono::milliseconds timeout = kLatestFrameTimeout) {
+        return latest_frame(stream_idx).Take(timeout);
+    }
+    // nullptr if the stream delivered nothing within the timeout.
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(int stream_idx = 0) {
+        return GetLatestFrame(stream_idx).buffer;
+    }
+
+    static constexpr int kMaxPyramidLevel = 3;
+
+  protected:
+    static constexpr std::chrono::milliseconds kLatestFrameTimeout{1000};
+
+    // Whether the capturer hands every main frame's pyramid to PublishLevels() itself, sharing it
+    // with its software sub stream. Otherwise the levels are built from a plain subscription to
+    // the main stream, once someone subscribes to one.
+    virtual bool builds_pyramid() const { return false; }
+
+    bool has_level_subscribers() const {
+        for (const auto &subject : level_subjects_) {
+            if (subject.ObserverCount() > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The capture thread. Builds the levels down to the deepest one subscribed to, all of them
+    // before any is published, and hands each to its subscribers.
+    void PublishLevels(FramePyramid &pyramid) {
+        int deepest = 0;
+        for (int level = 1; level <= kMaxPyramidLevel; level++) {
+            if (level_subjects_[level - 1].ObserverCount() > 0) {
+                deepest = level;
+            }
+        }
+        if (deepest == 0 || !pyramid.Level(deepest)) {
+            return;
+        }
+        for (int level = 1; level <= deepest; level++) {
+            auto &subject = level_subjects_[level - 1];
+            if (subject.ObserverCount() > 0) {
+                subject.Next(pyramid.Level(level));
+            }
+        }
+    }
+
+    // Where a capturer posts every frame it hands out, for GetLatestFrame().
+    LatestFrame &latest_frame(int stream_idx = 0) {
+        return latest_frames_[stream_idx == 1 ? 1 : 0];
+    }
+
+  private:
+    std::array<LatestFrame, 2> latest_frames_;
+    std::array<Subject<V4L2FrameBufferRef>, kMaxPyramidLevel> level_subjects_;
+    std::mutex pyramid_mtx_;
+    bool feeding_pyramid_ = false;
+    Subscription pyramid_subscription_;
+
+    // Stays subscribed once started; a frame nobody wants a level of costs only the check.
+    void FeedPyramid() {
+        std::lock_guard<std::mutex> lock(pyramid_mtx_);
+        if (feeding_pyramid_) {
+            return;
+        }
+        feeding_pyramid_ = true;
+        pyramid_subscription_ = Subscribe([this](const V4L2FrameBufferRef &frame_buffer) {
+            if (has_level_subscribers()) {
+                FramePyramid pyramid(frame_buffer);
+                PublishLevels(pyramid);
+            }
+        });
+    }
+
+    // Wraps `callback` in the mailbox and decimator the named subscriptions get, and subscribes
+    // the result with `subscribe`.
+    template <typename SubscribeFn>
+    Subscription SubscribeWith(const std::string &name,
+                               Subject<V4L2FrameBufferRef>::Callback callback, int max_fps,
+                               int phase, SubscribeFn subscribe) {
+        const Args args = config();
+        std::shared_ptr<FrameMailbox> mailbox;
+        if (args.async_dispatch) {
+            FrameMailbox::Options options;
+            options.name = name;
+            options.depth = args.async_queue_depth;
+            FrameMailbox::ParseDropPolicy(args.async_drop_policy, &options.drop_policy);
+            mailbox = FrameMailbox::Create(std::move(options), std::move(callback));
+            callback = [mailbox](const V4L2FrameBufferRef &frame_buffer) {
+                mailbox->Push(frame_buffer);
+            };
+        }
+
+        if (max_fps > 0) {
+            auto decimator = FrameDecimator::Create({name, max_fps, phase});
+            callback = [decimator, callback = std::move(callback)](
+                           const V4L2FrameBufferRef &frame_buffer) {
+                if (decimator->Accept(frame_buffer)) {
+                    callback(frame_buffer);
+                }
+            };
+        }
+
+        if (!mailbox) {
+            return subscribe(std::move(callback));
+        }
+        // A capture thread already inside Next() may still push after the unsubscribe, which
+        // Close() turns into a no-op; the observer's reference keeps the mailbox itself valid.
+        auto subscription = std::make_shared<Subscription>(subscribe(std::move(callback)));
+        return Subscription([subscription, mailbox]() mutable {
+            subscription.reset();
+            mailbox->Close();
+        });
+    }
 };
 
 #endif
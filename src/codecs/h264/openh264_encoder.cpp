@@ -66,6 +66,8 @@ bool Openh264Encoder::Init() {
     return true;
 }
 
+void Openh264Encoder::ForceKeyFrame() { encoder_->ForceIntraFrame(true); }
+
 void Openh264Encoder::Encode(webrtc::scoped_refptr<webrtc::I420BufferInterface> frame_buffer,
                              std::function<void(uint8_t *, int, bool)> on_capture) {
     src_pic_ = {0};
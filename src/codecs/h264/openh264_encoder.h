@@ -15,6 +15,8 @@ class Openh264Encoder {
     Openh264Encoder(EncoderConfig config);
     ~Openh264Encoder();
     bool Init();
+    // The next Encode() produces an IDR frame.
+    void ForceKeyFrame();
     void Encode(webrtc::scoped_refptr<webrtc::I420BufferInterface> frame_buffer,
                 std::function<void(uint8_t *, int, bool is_keyframe)> on_capture);
 
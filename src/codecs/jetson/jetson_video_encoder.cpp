@@ -16,7 +16,13 @@ std::unique_ptr<webrtc::VideoEncoder> JetsonVideoEncoder::Create(Args args) {
 JetsonVideoEncoder::JetsonVideoEncoder(Args args)
     : fps_adjuster_(args.fps),
       bitrate_adjuster_(webrtc::Clock::GetRealTimeClock(), .85, 1),
-      callback_(nullptr) {}
+      callback_(nullptr),
+      key_frame_requester_(KeyFrameScheduler::NewRequesterId()),
+      key_frames_(KeyFrameScheduler::Create({
+          .name = "jetson encoder",
+          .merge_window_ms = args.keyframe_merge_window,
+          .min_interval_ms = args.min_keyframe_interval,
+      })) {}
 
 int32_t JetsonVideoEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
                                        const VideoEncoder::Settings &settings) {
@@ -70,6 +76,9 @@ int32_t JetsonVideoEncoder::Encode(const webrtc::VideoFrame &frame,
     }
 
     if ((*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey) {
+        key_frames_->Request(key_frame_requester_);
+    }
+    if (key_frames_->Poll()) {
         encoder_->ForceKeyFrame();
     }
 
@@ -136,6 +145,9 @@ void JetsonVideoEncoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &
     encoded_image_._frameType = encoded_buffer.flags & V4L2_BUF_FLAG_KEYFRAME
                                     ? webrtc::VideoFrameType::kVideoFrameKey
                                     : webrtc::VideoFrameType::kVideoFrameDelta;
+    if (encoded_buffer.flags & V4L2_BUF_FLAG_KEYFRAME) {
+        key_frames_->OnKeyFrame();
+    }
 
     auto cb = callback_.load(std::memory_order_acquire);
     if (!cb) {
@@ -9,6 +9,7 @@
 
 #include "args.h"
 #include "codecs/jetson/jetson_encoder.h"
+#include "common/key_frame_scheduler.h"
 #include "common/v4l2_utils.h"
 
 class JetsonVideoEncoder : public webrtc::VideoEncoder {
@@ -35,6 +36,9 @@ class JetsonVideoEncoder : public webrtc::VideoEncoder {
     webrtc::EncodedImage encoded_image_;
     std::atomic<webrtc::EncodedImageCallback *> callback_;
     webrtc::BitrateAdjuster bitrate_adjuster_;
+    // Loss reports from this encoder's one peer, merged and spaced out like a shared encoder's.
+    const int key_frame_requester_;
+    const std::shared_ptr<KeyFrameScheduler> key_frames_;
     std::unique_ptr<JetsonEncoder> encoder_;
 
     virtual void SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer);
@@ -1,7 +1,9 @@
 #include "codecs/v4l2/v4l2_codec.h"
+#include "common/event_loop.h"
 #include "common/latency_tracer.h"
 #include "common/logging.h"
 #include <cstring>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <thread>
 
@@ -14,6 +16,9 @@ V4L2Codec::V4L2Codec()
 
 V4L2Codec::~V4L2Codec() {
     abort_ = true;
+    if (auto *event_loop = EventLoop::Shared()) {
+        event_loop->Remove(fd_);
+    }
     worker_.reset();
     v4l2_util::StreamOff(fd_, output_.type);
     v4l2_util::StreamOff(fd_, capture_.type);
@@ -118,6 +123,21 @@ void V4L2Codec::Start() {
     v4l2_util::StreamOn(fd_, capture_.type);
 
     abort_ = false;
+
+    if (auto *event_loop = EventLoop::Shared()) {
+        auto on_event = [this](uint32_t events) {
+            if (events & EPOLLIN) {
+                DequeueBuffers();
+            }
+            if (events & EPOLLPRI) {
+                HandleEvent();
+            }
+        };
+        if (event_loop->Add(fd_, EPOLLIN | EPOLLPRI, on_event)) {
+            return;
+        }
+    }
+
     worker_ = std::make_unique<Worker>(file_name_, [this]() {
         CaptureBuffer();
     });
@@ -189,51 +209,61 @@ bool V4L2Codec::CaptureBuffer() {
         return false;
     }
 
-    if (rd_fds && FD_ISSET(fd_, rd_fds)) {
-        struct v4l2_buffer buf = {0};
-        struct v4l2_plane planes = {0};
-        buf.memory = output_.memory;
-        buf.length = 1;
-        buf.m.planes = &planes;
-        buf.type = output_.type;
-        if (!v4l2_util::DequeueBuffer(fd_, &buf)) {
-            return false;
-        }
-        output_buffer_index_.push(buf.index);
-
-        buf = {};
-        planes = {};
-        buf.memory = capture_.memory;
-        buf.length = 1;
-        buf.m.planes = &planes;
-        buf.type = capture_.type;
-        if (!v4l2_util::DequeueBuffer(fd_, &buf)) {
-            return false;
-        }
+    if (rd_fds && FD_ISSET(fd_, rd_fds) && !DequeueBuffers()) {
+        return false;
+    }
 
-        auto buffer = V4L2Buffer::FromCapturedPlane(
-            capture_.buffers[buf.index].start, buf.m.planes[0].bytesused,
-            capture_.buffers[buf.index].dmafd, buf.flags, dst_fmt_);
-        auto frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer);
+    if (ex_fds && FD_ISSET(fd_, ex_fds)) {
+        ERROR_PRINT("Exception in fd(%d).", fd_);
+        HandleEvent();
+    }
 
-        if (abort_) {
-            return false;
-        }
+    return true;
+}
 
-        auto item = capturing_tasks_.pop();
-        if (item) {
-            auto task = item.value();
-            task(frame_buffer);
-        }
+bool V4L2Codec::DequeueBuffers() {
+    if (abort_) {
+        return false;
+    }
 
-        if (!v4l2_util::QueueBuffer(fd_, &capture_.buffers[buf.index].inner)) {
-            return false;
-        }
+    struct v4l2_buffer buf = {0};
+    struct v4l2_plane planes = {0};
+    buf.memory = output_.memory;
+    buf.length = 1;
+    buf.m.planes = &planes;
+    buf.type = output_.type;
+    if (!v4l2_util::DequeueBuffer(fd_, &buf)) {
+        return false;
+    }
+    output_buffer_index_.push(buf.index);
+
+    buf = {};
+    planes = {};
+    buf.memory = capture_.memory;
+    buf.length = 1;
+    buf.m.planes = &planes;
+    buf.type = capture_.type;
+    if (!v4l2_util::DequeueBuffer(fd_, &buf)) {
+        return false;
     }
 
-    if (ex_fds && FD_ISSET(fd_, ex_fds)) {
-        ERROR_PRINT("Exception in fd(%d).", fd_);
-        HandleEvent();
+    auto buffer = V4L2Buffer::FromCapturedPlane(
+        capture_.buffers[buf.index].start, buf.m.planes[0].bytesused,
+        capture_.buffers[buf.index].dmafd, buf.flags, dst_fmt_);
+    auto frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer);
+
+    if (abort_) {
+        return false;
+    }
+
+    auto item = capturing_tasks_.pop();
+    if (item) {
+        auto task = item.value();
+        task(frame_buffer);
+    }
+
+    if (!v4l2_util::QueueBuffer(fd_, &capture_.buffers[buf.index].inner)) {
+        return false;
     }
 
     return true;
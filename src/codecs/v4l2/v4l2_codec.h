@@ -46,6 +46,7 @@ class V4L2Codec : public IFrameProcessor {
                        v4l2_buf_type type, v4l2_memory memory, int buffer_num,
                        bool has_dmafd = false);
     bool CaptureBuffer();
+    bool DequeueBuffers();
 };
 
 #endif // V4L2_CODEC_
@@ -16,7 +16,13 @@ std::unique_ptr<webrtc::VideoEncoder> V4L2H264Encoder::Create(Args args) {
 V4L2H264Encoder::V4L2H264Encoder(Args args)
     : fps_adjuster_(args.fps),
       bitrate_adjuster_(webrtc::Clock::GetRealTimeClock(), .85, 1),
-      callback_(nullptr) {}
+      callback_(nullptr),
+      key_frame_requester_(KeyFrameScheduler::NewRequesterId()),
+      key_frames_(KeyFrameScheduler::Create({
+          .name = "v4l2 encoder",
+          .merge_window_ms = args.keyframe_merge_window,
+          .min_interval_ms = args.min_keyframe_interval,
+      })) {}
 
 int32_t V4L2H264Encoder::InitEncode(const webrtc::VideoCodec *codec_settings,
                                     const VideoEncoder::Settings &settings) {
@@ -74,6 +80,9 @@ int32_t V4L2H264Encoder::Encode(const webrtc::VideoFrame &frame,
     }
 
     if ((*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey) {
+        key_frames_->Request(key_frame_requester_);
+    }
+    if (key_frames_->Poll()) {
         encoder_->ForceKeyFrame();
     }
 
@@ -137,6 +146,9 @@ void V4L2H264Encoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &enc
     encoded_image_._frameType = encoded_buffer.flags & V4L2_BUF_FLAG_KEYFRAME
                                     ? webrtc::VideoFrameType::kVideoFrameKey
                                     : webrtc::VideoFrameType::kVideoFrameDelta;
+    if (encoded_buffer.flags & V4L2_BUF_FLAG_KEYFRAME) {
+        key_frames_->OnKeyFrame();
+    }
 
     auto result = callback_->OnEncodedImage(encoded_image_, &codec_specific);
     if (result.error != webrtc::EncodedImageCallback::Result::OK) {
@@ -8,6 +8,7 @@
 
 #include "args.h"
 #include "codecs/v4l2/v4l2_encoder.h"
+#include "common/key_frame_scheduler.h"
 #include "common/v4l2_utils.h"
 
 class V4L2H264Encoder : public webrtc::VideoEncoder {
@@ -34,6 +35,9 @@ class V4L2H264Encoder : public webrtc::VideoEncoder {
     webrtc::EncodedImage encoded_image_;
     webrtc::EncodedImageCallback *callback_;
     webrtc::BitrateAdjuster bitrate_adjuster_;
+    // Loss reports from this encoder's one peer, merged and spaced out like a shared encoder's.
+    const int key_frame_requester_;
+    const std::shared_ptr<KeyFrameScheduler> key_frames_;
     std::unique_ptr<V4L2Encoder> encoder_;
 
     virtual void SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer);
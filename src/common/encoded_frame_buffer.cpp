@@ -0,0 +1,28 @@
+#include "common/encoded_frame_buffer.h"
+
+webrtc::scoped_refptr<EncodedFrameBuffer>
+EncodedFrameBuffer::Create(V4L2FrameBufferRef frame_buffer, std::weak_ptr<EncodedSource> source,
+                           uint64_t sequence) {
+    return webrtc::make_ref_counted<EncodedFrameBuffer>(std::move(frame_buffer), std::move(source),
+                                                        sequence);
+}
+
+EncodedFrameBuffer::EncodedFrameBuffer(V4L2FrameBufferRef frame_buffer,
+                                       std::weak_ptr<EncodedSource> source, uint64_t sequence)
+    : frame_buffer_(std::move(frame_buffer)),
+      source_(std::move(source)),
+      sequence_(sequence) {}
+
+webrtc::VideoFrameBuffer::Type EncodedFrameBuffer::type() const { return Type::kNative; }
+
+int EncodedFrameBuffer::width() const { return frame_buffer_->width(); }
+
+int EncodedFrameBuffer::height() const { return frame_buffer_->height(); }
+
+webrtc::scoped_refptr<webrtc::I420BufferInterface> EncodedFrameBuffer::ToI420() { return nullptr; }
+
+const V4L2FrameBufferRef &EncodedFrameBuffer::frame_buffer() const { return frame_buffer_; }
+
+std::shared_ptr<EncodedSource> EncodedFrameBuffer::source() const { return source_.lock(); }
+
+uint64_t EncodedFrameBuffer::sequence() const { return sequence_; }
@@ -0,0 +1,46 @@
+#ifndef COMMON_ENCODED_FRAME_BUFFER_H_
+#define COMMON_ENCODED_FRAME_BUFFER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include <api/video/video_frame_buffer.h>
+
+#include "common/interface/encoded_source.h"
+#include "common/v4l2_frame_buffer.h"
+
+// An access unit of an EncodedSource on its way through a WebRTC track to the encoder that only
+// forwards it. It is native and cannot be converted or scaled, so a track carrying these must be
+// sent with a passthrough encoder and never adapted.
+//
+// It also leads back to the source, which is where that encoder's key frame and rate requests
+// have to go, and carries its place in the track, so that the encoder can tell when frames were
+// dropped on the way.
+class EncodedFrameBuffer : public webrtc::VideoFrameBuffer {
+  public:
+    static webrtc::scoped_refptr<EncodedFrameBuffer> Create(V4L2FrameBufferRef frame_buffer,
+                                                            std::weak_ptr<EncodedSource> source,
+                                                            uint64_t sequence);
+
+    EncodedFrameBuffer(V4L2FrameBufferRef frame_buffer, std::weak_ptr<EncodedSource> source,
+                       uint64_t sequence);
+
+    Type type() const override;
+    int width() const override;
+    int height() const override;
+    // nullptr: there is nothing to decode it with.
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+
+    const V4L2FrameBufferRef &frame_buffer() const;
+    // nullptr once the source is gone.
+    std::shared_ptr<EncodedSource> source() const;
+    // Counts the track's frames, one apart from the one before.
+    uint64_t sequence() const;
+
+  private:
+    const V4L2FrameBufferRef frame_buffer_;
+    const std::weak_ptr<EncodedSource> source_;
+    const uint64_t sequence_;
+};
+
+#endif // COMMON_ENCODED_FRAME_BUFFER_H_
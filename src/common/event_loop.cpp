@@ -0,0 +1,182 @@
+#include "common/event_loop.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "common/logging.h"
+#include "common/thread_policy.h"
+
+namespace {
+
+std::mutex config_mtx;
+int configured_thread_count = 0;
+std::vector<int> configured_cpus;
+
+} // namespace
+
+void EventLoop::Configure(int thread_count, std::vector<int> cpus) {
+    std::lock_guard<std::mutex> lock(config_mtx);
+    configured_thread_count = thread_count;
+    configured_cpus = std::move(cpus);
+}
+
+EventLoop *EventLoop::Shared() {
+    // Left running for the life of the process, like the devices registered with it.
+    static EventLoop *loop = []() -> EventLoop * {
+        std::lock_guard<std::mutex> lock(config_mtx);
+        if (configured_thread_count <= 0) {
+            return nullptr;
+        }
+        return new EventLoop(configured_thread_count, configured_cpus);
+    }();
+    return loop;
+}
+
+EventLoop::EventLoop(int thread_count, std::vector<int> cpus)
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      next_id_(0),
+      abort_(false),
+      cpus_(std::move(cpus)) {
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        ERROR_PRINT("Unable to create the device event loop: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Never read, so once written it keeps waking every thread until they have all left.
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = UINT64_MAX;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    for (int i = 0; i < thread_count; i++) {
+        threads_.push_back(webrtc::PlatformThread::SpawnJoinable(
+            [this, i]() {
+                this->Thread("event loop " + std::to_string(i));
+            },
+            "event loop " + std::to_string(i),
+            webrtc::ThreadAttributes().SetPriority(webrtc::ThreadPriority::kHigh)));
+    }
+    DEBUG_PRINT("Device event loop is running on %d thread(s).", thread_count);
+}
+
+EventLoop::~EventLoop() {
+    abort_.store(true);
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0) {
+        ERROR_PRINT("Unable to wake the device event loop: %s", strerror(errno));
+    }
+    for (auto &thread : threads_) {
+        thread.Finalize();
+    }
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+bool EventLoop::Add(int fd, uint32_t events, Handler handler) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto entry = std::make_shared<Entry>();
+    entry->id = next_id_++;
+    entry->fd = fd;
+    entry->events = events;
+    entry->handler = std::move(handler);
+    entry->running = false;
+
+    epoll_event ev = {};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.u64 = entry->id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        ERROR_PRINT("Unable to add fd(%d) to the device event loop: %s", fd, strerror(errno));
+        return false;
+    }
+    entries_[fd] = std::move(entry);
+    return true;
+}
+
+void EventLoop::Remove(int fd) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = entries_.find(fd);
+    if (it == entries_.end()) {
+        return;
+    }
+    auto entry = it->second;
+    entries_.erase(it);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+
+    cond_.wait(lock, [&entry]() {
+        return !entry->running || entry->thread_id == std::this_thread::get_id();
+    });
+}
+
+void EventLoop::Thread(const std::string &name) {
+    if (!cpus_.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : cpus_) {
+            CPU_SET(cpu, &cpu_set);
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+            ERROR_PRINT("Unable to pin the device event loop to the given cpus.");
+        }
+    }
+    // A --thread-policy rule for the thread takes precedence over --event-cpus.
+    thread_policy::Apply(name);
+
+    while (!abort_.load()) {
+        Poll();
+    }
+}
+
+void EventLoop::Poll() {
+    // One event per wait, so a thread busy in a slow handler is not sitting on events that
+    // another idle thread could be serving.
+    epoll_event ev;
+    int r = epoll_wait(epoll_fd_, &ev, 1, -1);
+    if (r < 0) {
+        if (errno != EINTR) {
+            ERROR_PRINT("epoll_wait failed: %s", strerror(errno));
+        }
+        return;
+    } else if (r == 0 || ev.data.u64 == UINT64_MAX) {
+        return;
+    }
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        // An event fetched just before its fd was removed, or one whose fd number has since been
+        // reused by another device, is dropped.
+        for (auto &[fd, candidate] : entries_) {
+            if (candidate->id == ev.data.u64) {
+                entry = candidate;
+                break;
+            }
+        }
+        if (!entry) {
+            return;
+        }
+        entry->running = true;
+        entry->thread_id = std::this_thread::get_id();
+    }
+
+    entry->handler(ev.events);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        entry->running = false;
+        auto it = entries_.find(entry->fd);
+        if (it != entries_.end() && it->second == entry) {
+            epoll_event rearm = {};
+            rearm.events = entry->events | EPOLLONESHOT;
+            rearm.data.u64 = entry->id;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, entry->fd, &rearm);
+        }
+    }
+    cond_.notify_all();
+}
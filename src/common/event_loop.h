@@ -0,0 +1,64 @@
+#ifndef COMMON_EVENT_LOOP_H_
+#define COMMON_EVENT_LOOP_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/platform_thread.h>
+
+// One epoll instance, served by a small set of threads, that every V4L2 device registers its fd
+// with instead of running a select() thread of its own. A registered fd is armed one-shot: it
+// is handed to a single thread at a time and re-armed when its handler returns, so a handler
+// never runs concurrently with itself and needs no more locking than its select() loop did.
+class EventLoop {
+  public:
+    // Receives the ready epoll events, e.g. EPOLLIN | EPOLLPRI.
+    using Handler = std::function<void(uint32_t events)>;
+
+    // Sets up the loop returned by Shared(). Only the first call to Shared() reads it, so this
+    // has to happen before any device is opened. A thread count of 0 disables the shared loop.
+    static void Configure(int thread_count, std::vector<int> cpus);
+    // nullptr when the loop is disabled, in which case devices poll on their own threads.
+    static EventLoop *Shared();
+
+    EventLoop(int thread_count, std::vector<int> cpus);
+    ~EventLoop();
+
+    bool Add(int fd, uint32_t events, Handler handler);
+    // Once this returns the handler is not running and will not run again. It may be called
+    // from inside the handler being removed.
+    void Remove(int fd);
+
+  private:
+    struct Entry {
+        uint64_t id;
+        int fd;
+        uint32_t events;
+        Handler handler;
+        bool running;
+        std::thread::id thread_id;
+    };
+
+    int epoll_fd_;
+    int wake_fd_;
+    uint64_t next_id_;
+    std::atomic<bool> abort_;
+    std::vector<int> cpus_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::map<int, std::shared_ptr<Entry>> entries_;
+    std::vector<webrtc::PlatformThread> threads_;
+
+    void Thread(const std::string &name);
+    void Poll();
+};
+
+#endif // COMMON_EVENT_LOOP_H_
@@ -0,0 +1,114 @@
+#include "common/frame_buffer_pool.h"
+
+#include <algorithm>
+#include <bit>
+
+#include <rtc_base/memory/aligned_malloc.h>
+
+namespace {
+
+// Aligning pointer to 64 bytes for improved performance, e.g. use SIMD.
+const size_t kBufferAlignment = 64;
+
+// Smallest class. Below it the pool is not worth a lock.
+const size_t kMinClassSize = 4096;
+
+// Enough idle storage to cover the recorder queue and a snapshot in flight for a couple of
+// resolutions, without holding on to more than a small board can spare.
+const size_t kSharedMaxBuffersPerClass = 6;
+const size_t kSharedMaxPooledBytes = 32 * 1024 * 1024;
+
+} // namespace
+
+void FrameBufferPool::Deleter::operator()(uint8_t *data) const {
+    if (pool_) {
+        pool_->Release(data, capacity_);
+    } else {
+        webrtc::AlignedFree(data);
+    }
+}
+
+FrameBufferPool &FrameBufferPool::Shared() {
+    static FrameBufferPool *pool =
+        new FrameBufferPool(kSharedMaxBuffersPerClass, kSharedMaxPooledBytes);
+    return *pool;
+}
+
+FrameBufferPool::FrameBufferPool(size_t max_buffers_per_class, size_t max_pooled_bytes)
+    : max_buffers_per_class_(max_buffers_per_class),
+      max_pooled_bytes_(max_pooled_bytes) {}
+
+FrameBufferPool::~FrameBufferPool() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &[capacity, buffers] : free_buffers_) {
+        for (uint8_t *data : buffers) {
+            webrtc::AlignedFree(data);
+        }
+    }
+}
+
+size_t FrameBufferPool::SizeClass(size_t size) {
+    if (size <= kMinClassSize) {
+        return kMinClassSize;
+    }
+    // A granule of a quarter of the enclosing power of two gives four classes per doubling.
+    const size_t granule = size_t(1) << (std::bit_width(size - 1) - 3);
+    return (size + granule - 1) & ~(granule - 1);
+}
+
+FrameBufferPool::Buffer FrameBufferPool::Acquire(size_t size) {
+    const size_t capacity = SizeClass(size);
+    uint8_t *data = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = free_buffers_.find(capacity);
+        if (it != free_buffers_.end() && !it->second.empty()) {
+            data = it->second.back();
+            it->second.pop_back();
+            stats_.pooled_bytes -= capacity;
+            stats_.hits++;
+        } else {
+            stats_.misses++;
+        }
+        stats_.outstanding++;
+        stats_.high_water = std::max(stats_.high_water, stats_.outstanding);
+    }
+
+    if (!data) {
+        data = static_cast<uint8_t *>(webrtc::AlignedMalloc(capacity, kBufferAlignment));
+    }
+
+    return Buffer(data, Deleter(this, capacity));
+}
+
+void FrameBufferPool::Release(uint8_t *data, size_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.outstanding--;
+
+        auto &buffers = free_buffers_[capacity];
+        if (buffers.size() < max_buffers_per_class_ &&
+            stats_.pooled_bytes + capacity <= max_pooled_bytes_) {
+            buffers.push_back(data);
+            stats_.pooled_bytes += capacity;
+            return;
+        }
+    }
+
+    webrtc::AlignedFree(data);
+}
+
+FrameBufferPool::Stats FrameBufferPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+FrameBufferPool::Stats FrameBufferPool::TakeStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats_.hits = 0;
+    stats_.misses = 0;
+    stats_.high_water = stats_.outstanding;
+    return stats;
+}
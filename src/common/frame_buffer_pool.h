@@ -0,0 +1,71 @@
+#ifndef COMMON_FRAME_BUFFER_POOL_H_
+#define COMMON_FRAME_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Recycles the storage behind owning V4L2FrameBuffers. A recorder clones every mmap-backed frame,
+// so without it the allocator sees a full frame allocated and freed per frame per consumer, and
+// every fresh block page-faults again on its first write.
+//
+// Blocks are grouped into size classes, four per power of two, so raw frames of one resolution
+// always share a class and compressed frames, whose size drifts from frame to frame, still get
+// reused at the cost of at most a quarter of slack. Idle storage is bounded both per class and
+// in total; anything over the bound is freed rather than kept.
+class FrameBufferPool {
+  public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t outstanding = 0; // handed out and not yet returned
+        uint64_t high_water = 0;  // most buffers outstanding at once
+        size_t pooled_bytes = 0;  // idle storage kept for reuse
+    };
+
+    // Returns the storage to the pool it came from instead of freeing it.
+    class Deleter {
+      public:
+        Deleter() = default;
+        Deleter(FrameBufferPool *pool, size_t capacity)
+            : pool_(pool),
+              capacity_(capacity) {}
+
+        void operator()(uint8_t *data) const;
+
+      private:
+        FrameBufferPool *pool_ = nullptr;
+        size_t capacity_ = 0;
+    };
+
+    using Buffer = std::unique_ptr<uint8_t, Deleter>;
+
+    // The process-wide pool. It is never destroyed, so a frame released during shutdown still
+    // has somewhere to go.
+    static FrameBufferPool &Shared();
+
+    FrameBufferPool(size_t max_buffers_per_class, size_t max_pooled_bytes);
+    ~FrameBufferPool();
+
+    Buffer Acquire(size_t size);
+
+    Stats GetStats() const;
+    // Like GetStats(), but restarts hits, misses and the high-water mark, for interval reports.
+    Stats TakeStats();
+
+  private:
+    const size_t max_buffers_per_class_;
+    const size_t max_pooled_bytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<size_t, std::vector<uint8_t *>> free_buffers_;
+    Stats stats_;
+
+    static size_t SizeClass(size_t size);
+    void Release(uint8_t *data, size_t capacity);
+};
+
+#endif // COMMON_FRAME_BUFFER_POOL_H_
@@ -0,0 +1,88 @@
+#include "common/frame_decimator.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "common/logging.h"
+
+namespace {
+
+std::mutex registry_mtx;
+std::vector<FrameDecimator *> registry;
+
+int64_t ToUs(timeval tv) { return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec; }
+
+} // namespace
+
+std::shared_ptr<FrameDecimator> FrameDecimator::Create(Options options) {
+    return std::make_shared<FrameDecimator>(std::move(options));
+}
+
+std::vector<FrameDecimator::Stats> FrameDecimator::TakeStats() {
+    std::vector<Stats> stats;
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    for (FrameDecimator *decimator : registry) {
+        Stats s;
+        s.name = decimator->options_.name;
+        s.max_fps = decimator->options_.max_fps;
+        s.passed = decimator->passed_.exchange(0, std::memory_order_relaxed);
+        s.skipped = decimator->skipped_.exchange(0, std::memory_order_relaxed);
+        stats.push_back(std::move(s));
+    }
+    return stats;
+}
+
+FrameDecimator::FrameDecimator(Options options)
+    : options_(std::move(options)),
+      interval_us_(options_.max_fps > 0 ? 1000000 / options_.max_fps : 0),
+      phase_left_(std::max(options_.phase, 0)),
+      next_due_us_(0),
+      last_us_(0),
+      passed_(0),
+      skipped_(0) {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    registry.push_back(this);
+    DEBUG_PRINT("Frames for '%s' are capped at %d fps.", options_.name.c_str(), options_.max_fps);
+}
+
+FrameDecimator::~FrameDecimator() {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    registry.erase(std::remove(registry.begin(), registry.end(), this), registry.end());
+}
+
+bool FrameDecimator::Accept(const V4L2FrameBufferRef &frame_buffer) {
+    if (interval_us_ <= 0 || frame_buffer->format() == V4L2_PIX_FMT_H264) {
+        passed_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (phase_left_ > 0) {
+        last_us_ = ToUs(frame_buffer->timestamp());
+        phase_left_--;
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Slack for timestamp jitter, so a 30 fps camera capped at 15 keeps every other frame rather
+    // than sometimes every third. Under half a camera interval, or it would take a frame early.
+    const int64_t now_us = ToUs(frame_buffer->timestamp());
+    const int64_t source_interval_us = now_us - last_us_;
+    last_us_ = now_us;
+    const int64_t slack_us = source_interval_us > 0
+                                 ? std::min(interval_us_ / 4, source_interval_us / 2)
+                                 : interval_us_ / 4;
+    const int64_t early_us = next_due_us_ - now_us;
+    if (next_due_us_ != 0 && early_us > slack_us && early_us <= interval_us_) {
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Kept on schedule while frames keep up with it, and restarted after a gap or a clock step.
+    if (next_due_us_ == 0 || early_us > interval_us_ || early_us <= -interval_us_) {
+        next_due_us_ += interval_us_ - early_us;
+    } else {
+        next_due_us_ += interval_us_;
+    }
+    passed_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
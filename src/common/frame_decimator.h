@@ -0,0 +1,55 @@
+#ifndef COMMON_FRAME_DECIMATOR_H_
+#define COMMON_FRAME_DECIMATOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/v4l2_frame_buffer.h"
+
+// Thins a capture stream out to the rate one subscriber asked for, in the fan-out and before the
+// subscriber's callback runs, so a skipped frame is never cloned, queued or converted for it.
+//
+// Frames are picked by capture timestamp rather than by counting, so the kept rate holds when
+// the camera's own rate drifts or frames go missing. H.264 frames all pass: dropping an inter
+// frame would break everything up to the next keyframe.
+class FrameDecimator {
+  public:
+    struct Options {
+        std::string name;
+        int max_fps = 0; // 0 keeps every frame
+        // Frames to skip before the first one kept, so that subscribers at the same rate can be
+        // put on different frames instead of all waking on the same one.
+        int phase = 0;
+    };
+
+    struct Stats {
+        std::string name;
+        int max_fps = 0;
+        uint64_t passed = 0;
+        uint64_t skipped = 0;
+    };
+
+    static std::shared_ptr<FrameDecimator> Create(Options options);
+    // Every live decimator, with the counters since the previous call.
+    static std::vector<Stats> TakeStats();
+
+    explicit FrameDecimator(Options options);
+    ~FrameDecimator();
+
+    // Capture thread. Whether the subscriber gets this frame.
+    bool Accept(const V4L2FrameBufferRef &frame_buffer);
+
+  private:
+    const Options options_;
+    const int64_t interval_us_;
+    int phase_left_;
+    int64_t next_due_us_;
+    int64_t last_us_;
+    std::atomic<uint64_t> passed_;
+    std::atomic<uint64_t> skipped_;
+};
+
+#endif // COMMON_FRAME_DECIMATOR_H_
@@ -0,0 +1,177 @@
+#include "common/frame_mailbox.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "common/logging.h"
+
+namespace {
+
+// How long the dispatch thread sleeps between checks for Close(), when no frame wakes it first.
+constexpr auto kIdleWait = std::chrono::milliseconds(100);
+
+std::mutex registry_mtx;
+std::vector<FrameMailbox *> registry;
+
+} // namespace
+
+std::shared_ptr<FrameMailbox> FrameMailbox::Create(Options options, Callback callback) {
+    return std::make_shared<FrameMailbox>(std::move(options), std::move(callback));
+}
+
+bool FrameMailbox::ParseDropPolicy(const std::string &name, DropPolicy *policy) {
+    if (name == "drop-oldest") {
+        *policy = DropPolicy::kDropOldest;
+    } else if (name == "drop-newest") {
+        *policy = DropPolicy::kDropNewest;
+    } else if (name == "keyframe") {
+        *policy = DropPolicy::kKeyframe;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<FrameMailbox::Stats> FrameMailbox::TakeStats() {
+    std::vector<Stats> stats;
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    for (FrameMailbox *mailbox : registry) {
+        Stats s;
+        s.name = mailbox->options_.name;
+        s.delivered = mailbox->delivered_.exchange(0, std::memory_order_relaxed);
+        s.dropped = mailbox->dropped_.exchange(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> queue_lock(mailbox->mtx_);
+            s.depth = mailbox->queue_.size();
+            s.high_water = mailbox->high_water_;
+            mailbox->high_water_ = s.depth;
+        }
+        stats.push_back(std::move(s));
+    }
+    return stats;
+}
+
+FrameMailbox::FrameMailbox(Options options, Callback callback)
+    : options_(std::move(options)),
+      callback_(std::move(callback)),
+      closed_(false),
+      awaiting_keyframe_(false),
+      high_water_(0),
+      delivered_(0),
+      dropped_(0) {
+    {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        registry.push_back(this);
+    }
+    worker_ = std::make_unique<Worker>("mailbox " + options_.name, [this]() {
+        Dispatch();
+    });
+    worker_->Run();
+    DEBUG_PRINT("Frames for '%s' are dispatched from a queue of %d.", options_.name.c_str(),
+                options_.depth);
+}
+
+FrameMailbox::~FrameMailbox() { Close(); }
+
+void FrameMailbox::Close() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+    }
+    cond_.notify_all();
+    worker_.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.clear();
+    }
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    registry.erase(std::remove(registry.begin(), registry.end(), this), registry.end());
+}
+
+bool FrameMailbox::IsKeyframe(const V4L2FrameBufferRef &frame_buffer) {
+    return frame_buffer->format() == V4L2_PIX_FMT_H264 &&
+           (frame_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME);
+}
+
+void FrameMailbox::Push(const V4L2FrameBufferRef &frame_buffer) {
+    const size_t depth = static_cast<size_t>(std::max(options_.depth, 1));
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (closed_) {
+            return;
+        }
+
+        switch (options_.drop_policy) {
+            case DropPolicy::kDropOldest:
+                if (queue_.size() >= depth) {
+                    queue_.pop_front();
+                    dropped++;
+                }
+                break;
+            case DropPolicy::kDropNewest:
+                if (queue_.size() >= depth) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                break;
+            case DropPolicy::kKeyframe:
+                if (frame_buffer->format() != V4L2_PIX_FMT_H264) {
+                    if (queue_.size() >= depth) {
+                        queue_.pop_front();
+                        dropped++;
+                    }
+                } else if (IsKeyframe(frame_buffer)) {
+                    awaiting_keyframe_ = false;
+                    if (queue_.size() >= depth) {
+                        dropped += queue_.size();
+                        queue_.clear();
+                    }
+                } else if (awaiting_keyframe_ || queue_.size() >= depth) {
+                    awaiting_keyframe_ = true;
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                break;
+        }
+    }
+    if (dropped > 0) {
+        dropped_.fetch_add(dropped, std::memory_order_relaxed);
+    }
+
+    // Only a frame that is going to be queued is copied, and outside the lock, so the dispatch
+    // thread is never kept waiting on a memcpy. The room made above is still there: Push() has
+    // the one caller, and the dispatch thread only takes frames out.
+    V4L2FrameBufferRef owned = frame_buffer->IsRetainable() ? frame_buffer : frame_buffer->Clone();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (closed_) {
+            return;
+        }
+        queue_.push_back(std::move(owned));
+        high_water_ = std::max(high_water_, queue_.size());
+    }
+    cond_.notify_one();
+}
+
+void FrameMailbox::Dispatch() {
+    V4L2FrameBufferRef frame_buffer;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!cond_.wait_for(lock, kIdleWait, [this]() {
+                return closed_ || !queue_.empty();
+            }) ||
+            closed_) {
+            return;
+        }
+        frame_buffer = std::move(queue_.front());
+        queue_.pop_front();
+    }
+
+    callback_(std::move(frame_buffer));
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+}
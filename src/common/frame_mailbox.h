@@ -0,0 +1,85 @@
+#ifndef COMMON_FRAME_MAILBOX_H_
+#define COMMON_FRAME_MAILBOX_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/v4l2_frame_buffer.h"
+#include "common/worker.h"
+
+// A bounded queue and a dispatch thread of its own between a capture stream and one subscriber,
+// so a subscriber that blocks, e.g. a recorder rotating its file, holds up only its own frames
+// rather than the capture thread and every other subscriber behind it.
+//
+// Push() never waits. A frame that would not outlive the capture callback is cloned on the way
+// in, once the drop policy has accepted it, the same way VideoRecorder::OnBuffer() does; a
+// retainable one is queued by reference, so a lent capture buffer stays out of the driver while
+// it sits in the queue and the depth has to be kept well under the capture buffer count.
+class FrameMailbox {
+  public:
+    using Callback = std::function<void(V4L2FrameBufferRef)>;
+
+    // What Push() gives up when the queue is full.
+    enum class DropPolicy {
+        kDropOldest, // the oldest queued frame, so the subscriber always catches up to live
+        kDropNewest, // the incoming frame, so what is queued is delivered in order
+        // Never breaks a GOP: an incoming H.264 keyframe replaces everything queued, and once an
+        // inter frame has been dropped the rest are skipped until the next keyframe. Raw frames
+        // stand alone, so for them this is drop-oldest.
+        kKeyframe,
+    };
+
+    struct Options {
+        std::string name;
+        int depth = 2;
+        DropPolicy drop_policy = DropPolicy::kDropOldest;
+    };
+
+    struct Stats {
+        std::string name;
+        size_t depth = 0;
+        size_t high_water = 0;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0;
+    };
+
+    static std::shared_ptr<FrameMailbox> Create(Options options, Callback callback);
+    // Accepts "drop-oldest", "drop-newest" and "keyframe".
+    static bool ParseDropPolicy(const std::string &name, DropPolicy *policy);
+    // Every open mailbox, with the counters and high water mark since the previous call.
+    static std::vector<Stats> TakeStats();
+
+    FrameMailbox(Options options, Callback callback);
+    ~FrameMailbox();
+
+    // Capture thread, and only ever one thread per mailbox.
+    void Push(const V4L2FrameBufferRef &frame_buffer);
+    // Stops the dispatch thread and lets go of the queued frames; later pushes are ignored. Must
+    // not be called from the callback.
+    void Close();
+
+  private:
+    const Options options_;
+    const Callback callback_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::deque<V4L2FrameBufferRef> queue_;
+    bool closed_;
+    bool awaiting_keyframe_;
+    size_t high_water_;
+    std::atomic<uint64_t> delivered_;
+    std::atomic<uint64_t> dropped_;
+    std::unique_ptr<Worker> worker_;
+
+    static bool IsKeyframe(const V4L2FrameBufferRef &frame_buffer);
+    void Dispatch();
+};
+
+#endif // COMMON_FRAME_MAILBOX_H_
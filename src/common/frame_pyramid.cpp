@@ -0,0 +1,80 @@
+#include "common/frame_pyramid.h"
+
+#include <algorithm>
+
+#include "common/frame_scaler.h"
+#include "common/latency_tracer.h"
+
+int FramePyramid::Halve(int size) {
+    // Even, so every level splits into whole chroma samples.
+    return std::max((size / 2) & ~1, 2);
+}
+
+FramePyramid::FramePyramid(V4L2FrameBufferRef frame_buffer) {
+    levels_.push_back(std::move(frame_buffer));
+}
+
+V4L2FrameBufferRef FramePyramid::Scale(int width, int height) {
+    // A simulcast encoder scales its layers one after another, but nothing stops two threads
+    // asking.
+    std::lock_guard<std::mutex> lock(mtx_);
+    V4L2FrameBufferRef above = levels_.back();
+    for (size_t i = 0; i + 1 < levels_.size(); i++) {
+        if (levels_[i + 1]->width() < width || levels_[i + 1]->height() < height) {
+            above = levels_[i];
+            break;
+        }
+    }
+
+    if (above == levels_.back()) {
+        const bool traced = latency::Enabled();
+        const int64_t start_us = traced ? latency::NowUs() : 0;
+        bool built = false;
+        while (true) {
+            const int level_width = Halve(above->width());
+            const int level_height = Halve(above->height());
+            if (level_width < width || level_height < height || level_width >= above->width()) {
+                break;
+            }
+            auto level = frame_scaler::Scale(above, 0, 0, above->width(), above->height(),
+                                             level_width, level_height);
+            if (!level) {
+                break;
+            }
+            levels_.push_back(level);
+            above = level;
+            built = true;
+        }
+        if (traced && built) {
+            latency::RecordSince(latency::Stage::kPyramid, start_us);
+        }
+    }
+
+    if (above->width() == width && above->height() == height) {
+        return above;
+    }
+    return frame_scaler::Scale(above, 0, 0, above->width(), above->height(), width, height);
+}
+
+V4L2FrameBufferRef FramePyramid::Level(int level) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (level < static_cast<int>(levels_.size())) {
+        return levels_[level];
+    }
+
+    const bool traced = latency::Enabled();
+    const int64_t start_us = traced ? latency::NowUs() : 0;
+    while (static_cast<int>(levels_.size()) <= level) {
+        const V4L2FrameBufferRef &above = levels_.back();
+        auto next = frame_scaler::Scale(above, 0, 0, above->width(), above->height(),
+                                        Halve(above->width()), Halve(above->height()));
+        if (!next) {
+            return nullptr;
+        }
+        levels_.push_back(next);
+    }
+    if (traced) {
+        latency::RecordSince(latency::Stage::kPyramid, start_us);
+    }
+    return levels_[level];
+}
@@ -0,0 +1,37 @@
+#ifndef COMMON_FRAME_PYRAMID_H_
+#define COMMON_FRAME_PYRAMID_H_
+
+#include <mutex>
+#include <vector>
+
+#include "common/v4l2_frame_buffer.h"
+
+// Halved copies of one frame, for a consumer that wants it at several smaller sizes, built in a
+// cascade on first use: level 1 is scaled from the frame itself and every further level from the
+// one above it, a quarter of its size and likely still in cache. All levels together read about
+// 1.33 frames' worth of pixels, where scaling each size from the full frame would read it once
+// per size.
+//
+// Levels are only built down to the smallest size asked for. They are pooled I420 buffers, with
+// the source timestamp, that callers may keep without a copy.
+class FramePyramid {
+  public:
+    // A level's width or height, given the one above it.
+    static int Halve(int size);
+
+    explicit FramePyramid(V4L2FrameBufferRef frame_buffer);
+
+    // Any thread. The whole frame at `width` x `height`, scaled from the smallest level that is
+    // still at least that size: the level itself if it is exactly that, the frame if none is.
+    // nullptr on failure.
+    V4L2FrameBufferRef Scale(int width, int height);
+    // Any thread. Level `level` itself, 0 being the frame, with every level above it built on the
+    // way. nullptr on failure.
+    V4L2FrameBufferRef Level(int level);
+
+  private:
+    std::mutex mtx_;
+    std::vector<V4L2FrameBufferRef> levels_; // levels_[0] is the frame itself
+};
+
+#endif // COMMON_FRAME_PYRAMID_H_
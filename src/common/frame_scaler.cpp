@@ -0,0 +1,306 @@
+#include "common/frame_scaler.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "common/logging.h"
+
+namespace {
+
+// 16-bit accumulators hold the sum of up to 257 rows of 8-bit samples.
+constexpr int kMaxRowsPerSum = 257;
+// Output chroma rows per stripe, at least, so a small frame is not split finer than it is worth.
+constexpr int kMinRowsPerStripe = 16;
+// Fixed-point reciprocals of the row and column counts, so a pixel costs no division.
+constexpr int kReciprocalBits = 24;
+
+// The source columns or rows that one output pixel averages.
+struct Span {
+    int begin;
+    int count;
+    uint64_t reciprocal; // 2^kReciprocalBits / count
+};
+
+// Everything ScaleRows() reads, set up once per frame.
+struct Job {
+    uint32_t format;
+    // The crop's first column in each plane, at row 0. For YUYV, `y` is the packed plane.
+    const uint8_t *y;
+    const uint8_t *u; // the interleaved plane for NV12
+    const uint8_t *v;
+    int stride_y;
+    int stride_uv;
+    int luma_bytes;   // bytes summed per luma, or packed, row
+    int chroma_bytes; // bytes summed per chroma row, NV12 and I420 only
+    std::vector<Span> cols;
+    std::vector<Span> rows; // absolute source rows
+    std::vector<Span> chroma_cols;
+    std::vector<Span> chroma_rows; // absolute source chroma rows, NV12 and I420 only
+    uint8_t *dst_y;
+    uint8_t *dst_u;
+    uint8_t *dst_v;
+    int dst_stride_y;
+    int dst_stride_uv;
+    int height;
+};
+
+std::vector<Span> MakeSpans(int offset, int src_size, int dst_size) {
+    std::vector<Span> spans(dst_size);
+    for (int i = 0; i < dst_size; i++) {
+        const int begin = static_cast<int64_t>(i) * src_size / dst_size;
+        const int end = static_cast<int64_t>(i + 1) * src_size / dst_size;
+        const int count = std::max(end - begin, 1);
+        spans[i] = {offset + begin, count, (uint64_t{1} << kReciprocalBits) / count};
+    }
+    return spans;
+}
+
+// acc[i] = src[i]
+void WidenRow(const uint8_t *src, uint16_t *acc, int n) {
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t s = vld1q_u8(src + i);
+        vst1q_u16(acc + i, vmovl_u8(vget_low_u8(s)));
+        vst1q_u16(acc + i + 8, vmovl_u8(vget_high_u8(s)));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i), _mm_unpacklo_epi8(s, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i + 8), _mm_unpackhi_epi8(s, zero));
+    }
+#endif
+    for (; i < n; i++) {
+        acc[i] = src[i];
+    }
+}
+
+// acc[i] += src[i]
+void AccumulateRow(const uint8_t *src, uint16_t *acc, int n) {
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t s = vld1q_u8(src + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(s)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(s)));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i *lo = reinterpret_cast<__m128i *>(acc + i);
+        __m128i *hi = reinterpret_cast<__m128i *>(acc + i + 8);
+        _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(s, zero)));
+        _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(s, zero)));
+    }
+#endif
+    for (; i < n; i++) {
+        acc[i] += src[i];
+    }
+}
+
+void SumRows(const uint8_t *src, int stride, const Span &rows, int n, uint16_t *acc) {
+    src += static_cast<ptrdiff_t>(rows.begin) * stride;
+    WidenRow(src, acc, n);
+    for (int r = 1; r < rows.count; r++) {
+        AccumulateRow(src + static_cast<ptrdiff_t>(r) * stride, acc, n);
+    }
+}
+
+// Narrows summed rows to output pixels, each the mean of the samples `step` apart under its
+// column span, in `acc` and, for YUYV chroma, `extra` as well, over `row_count` rows in all.
+void ReduceRow(const uint16_t *acc, const uint16_t *extra, int step, const std::vector<Span> &cols,
+               int row_count, uint8_t *dst) {
+    const uint64_t row_reciprocal = (uint64_t{1} << kReciprocalBits) / row_count;
+    const uint64_t half = uint64_t{1} << (2 * kReciprocalBits - 1);
+    for (size_t x = 0; x < cols.size(); x++) {
+        const Span &span = cols[x];
+        const uint16_t *p = acc + span.begin * step;
+        uint32_t sum = 0;
+        for (int i = 0; i < span.count; i++) {
+            sum += p[i * step];
+        }
+        if (extra) {
+            p = extra + span.begin * step;
+            for (int i = 0; i < span.count; i++) {
+                sum += p[i * step];
+            }
+        }
+        const uint64_t mean =
+            (sum * span.reciprocal * row_reciprocal + half) >> (2 * kReciprocalBits);
+        dst[x] = static_cast<uint8_t>(std::min<uint64_t>(mean, 255));
+    }
+}
+
+// Output chroma rows [first, last), with the two luma rows over each.
+void ScaleRows(const Job &job, int first, int last) {
+    thread_local std::vector<uint16_t> accumulators;
+    accumulators.resize(2 * job.luma_bytes + 2 * job.chroma_bytes);
+    uint16_t *luma[2] = {accumulators.data(), accumulators.data() + job.luma_bytes};
+    uint16_t *chroma[2] = {luma[1] + job.luma_bytes, luma[1] + job.luma_bytes + job.chroma_bytes};
+    const bool packed = job.format == V4L2_PIX_FMT_YUYV;
+
+    for (int c = first; c < last; c++) {
+        int luma_rows[2] = {0, 0};
+        for (int i = 0; i < 2 && 2 * c + i < job.height; i++) {
+            const int y = 2 * c + i;
+            const Span &rows = job.rows[y];
+            SumRows(job.y, job.stride_y, rows, job.luma_bytes, luma[i]);
+            ReduceRow(luma[i], nullptr, packed ? 2 : 1, job.cols, rows.count,
+                      job.dst_y + y * job.dst_stride_y);
+            luma_rows[i] = rows.count;
+        }
+
+        uint8_t *dst_u = job.dst_u + c * job.dst_stride_uv;
+        uint8_t *dst_v = job.dst_v + c * job.dst_stride_uv;
+        if (packed) {
+            // Every YUYV row carries chroma, so a chroma row is the sums of both luma rows.
+            const uint16_t *second = luma_rows[1] > 0 ? luma[1] : nullptr;
+            const int row_count = luma_rows[0] + luma_rows[1];
+            ReduceRow(luma[0] + 1, second ? second + 1 : nullptr, 4, job.chroma_cols, row_count,
+                      dst_u);
+            ReduceRow(luma[0] + 3, second ? second + 3 : nullptr, 4, job.chroma_cols, row_count,
+                      dst_v);
+            continue;
+        }
+
+        const Span &rows = job.chroma_rows[c];
+        SumRows(job.u, job.stride_uv, rows, job.chroma_bytes, chroma[0]);
+        if (job.format == V4L2_PIX_FMT_NV12) {
+            ReduceRow(chroma[0], nullptr, 2, job.chroma_cols, rows.count, dst_u);
+            ReduceRow(chroma[0] + 1, nullptr, 2, job.chroma_cols, rows.count, dst_v);
+        } else {
+            SumRows(job.v, job.stride_uv, rows, job.chroma_bytes, chroma[1]);
+            ReduceRow(chroma[0], nullptr, 1, job.chroma_cols, rows.count, dst_u);
+            ReduceRow(chroma[1], nullptr, 1, job.chroma_cols, rows.count, dst_v);
+        }
+    }
+}
+
+size_t FrameSize(uint32_t format, int width, int height) {
+    const size_t chroma_size = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+    switch (format) {
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_NV12:
+            return static_cast<size_t>(width) * height + 2 * chroma_size;
+        case V4L2_PIX_FMT_YUYV:
+            return static_cast<size_t>(width) * height * 2;
+        default:
+            return 0;
+    }
+}
+
+// For the formats and scales the row kernels do not cover.
+bool ScaleFromI420(const V4L2FrameBufferRef &src, int crop_x, int crop_y, int crop_width,
+                   int crop_height, const Job &dst, int width, int height) {
+    auto i420_buffer = src->ToI420();
+    if (!i420_buffer) {
+        return false;
+    }
+    const uint8_t *src_y = i420_buffer->DataY() + crop_y * i420_buffer->StrideY() + crop_x;
+    const uint8_t *src_u = i420_buffer->DataU() + crop_y / 2 * i420_buffer->StrideU() + crop_x / 2;
+    const uint8_t *src_v = i420_buffer->DataV() + crop_y / 2 * i420_buffer->StrideV() + crop_x / 2;
+    return libyuv::I420Scale(src_y, i420_buffer->StrideY(), src_u, i420_buffer->StrideU(), src_v,
+                             i420_buffer->StrideV(), crop_width, crop_height, dst.dst_y,
+                             dst.dst_stride_y, dst.dst_u, dst.dst_stride_uv, dst.dst_v,
+                             dst.dst_stride_uv, width, height, libyuv::kFilterBox) >= 0;
+}
+
+} // namespace
+
+namespace frame_scaler {
+
+V4L2FrameBufferRef Scale(const V4L2FrameBufferRef &src, int crop_x, int crop_y, int crop_width,
+                         int crop_height, int width, int height) {
+    return Scale(src, crop_x, crop_y, crop_width, crop_height, width, height,
+                 ThreadPool::Shared());
+}
+
+V4L2FrameBufferRef Scale(const V4L2FrameBufferRef &src, int crop_x, int crop_y, int crop_width,
+                         int crop_height, int width, int height, ThreadPool &pool) {
+    const int src_width = src->width();
+    const int src_height = src->height();
+    crop_x = std::clamp(crop_x, 0, src_width - 1) & ~1;
+    crop_y = std::clamp(crop_y, 0, src_height - 1) & ~1;
+    crop_width = std::clamp(crop_width, 1, src_width - crop_x);
+    crop_height = std::clamp(crop_height, 1, src_height - crop_y);
+    if (width <= 0 || height <= 0) {
+        return nullptr;
+    }
+
+    Job job = {};
+    job.format = src->format();
+    job.height = height;
+    job.dst_stride_y = width;
+    job.dst_stride_uv = (width + 1) / 2;
+    const int dst_chroma_size = job.dst_stride_uv * ((height + 1) / 2);
+    auto dst = V4L2FrameBuffer::Create(width, height, width * height + 2 * dst_chroma_size,
+                                       V4L2_PIX_FMT_YUV420);
+    job.dst_y = dst->MutableData();
+    job.dst_u = job.dst_y + width * height;
+    job.dst_v = job.dst_u + dst_chroma_size;
+
+    const auto *data = static_cast<const uint8_t *>(src->Data());
+    const size_t frame_size = FrameSize(job.format, src_width, src_height);
+    const bool in_place = data && frame_size > 0 && src->size() >= frame_size &&
+                          crop_width >= width && crop_height >= height &&
+                          (crop_height + height - 1) / height <= kMaxRowsPerSum;
+    if (!in_place) {
+        if (!ScaleFromI420(src, crop_x, crop_y, crop_width, crop_height, job, width, height)) {
+            ERROR_PRINT("libyuv I420Scale Failed");
+            return nullptr;
+        }
+        dst->SetTimestamp(src->timestamp());
+        return dst;
+    }
+
+    const int chroma_width = (crop_width + 1) / 2;
+    const int dst_chroma_width = (width + 1) / 2;
+    job.cols = MakeSpans(0, crop_width, width);
+    job.rows = MakeSpans(crop_y, crop_height, height);
+    job.chroma_cols = MakeSpans(0, chroma_width, dst_chroma_width);
+    if (job.format == V4L2_PIX_FMT_YUYV) {
+        job.stride_y = src_width * 2;
+        job.y = data + crop_x * 2;
+        job.luma_bytes = chroma_width * 4;
+    } else {
+        const int chroma_stride = (src_width + 1) / 2;
+        const uint8_t *chroma = data + src_width * src_height;
+        job.stride_y = src_width;
+        job.y = data + crop_x;
+        job.luma_bytes = crop_width;
+        job.chroma_rows = MakeSpans(crop_y / 2, (crop_height + 1) / 2, (height + 1) / 2);
+        if (job.format == V4L2_PIX_FMT_NV12) {
+            job.stride_uv = chroma_stride * 2;
+            job.u = chroma + crop_x;
+            job.chroma_bytes = chroma_width * 2;
+        } else {
+            job.stride_uv = chroma_stride;
+            job.u = chroma + crop_x / 2;
+            job.v = chroma + chroma_stride * ((src_height + 1) / 2) + crop_x / 2;
+            job.chroma_bytes = chroma_width;
+        }
+    }
+
+    // Stripes of whole chroma rows, each with the luma rows over them, so that no two threads
+    // write the same output row.
+    const int chroma_height = (height + 1) / 2;
+    const int stripes = std::clamp(chroma_height / kMinRowsPerStripe, 1, pool.concurrency());
+    pool.ParallelFor(stripes, [&job, chroma_height, stripes](int i) {
+        ScaleRows(job, chroma_height * i / stripes, chroma_height * (i + 1) / stripes);
+    });
+    dst->SetTimestamp(src->timestamp());
+    return dst;
+}
+
+} // namespace frame_scaler
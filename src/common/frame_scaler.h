@@ -0,0 +1,27 @@
+#ifndef COMMON_FRAME_SCALER_H_
+#define COMMON_FRAME_SCALER_H_
+
+#include "common/thread_pool.h"
+#include "common/v4l2_frame_buffer.h"
+
+// Crops, converts and downscales a capture frame to I420 in a single pass over its memory,
+// instead of a full-size ToI420() followed by a scale from that copy.
+//
+// Each output row is a box filter: the source rows under it are summed into a row of 16-bit
+// accumulators by a NEON or SSE2 kernel, straight from the native layout, and the sums are then
+// narrowed across the columns under each output pixel. I420, NV12 and YUYV frames are read in
+// place; anything else, and any upscale, is converted first and handed to libyuv. The in-place
+// path splits large frames into stripes of output rows on ThreadPool::Shared().
+namespace frame_scaler {
+
+// The result is a pooled I420 frame of `width` x `height` that carries the source timestamp.
+// The crop is snapped to even offsets, so it never splits a chroma sample. nullptr on failure.
+V4L2FrameBufferRef Scale(const V4L2FrameBufferRef &src, int crop_x, int crop_y, int crop_width,
+                         int crop_height, int width, int height);
+// The same, striped on `pool` instead of the shared pool.
+V4L2FrameBufferRef Scale(const V4L2FrameBufferRef &src, int crop_x, int crop_y, int crop_width,
+                         int crop_height, int width, int height, ThreadPool &pool);
+
+} // namespace frame_scaler
+
+#endif // COMMON_FRAME_SCALER_H_
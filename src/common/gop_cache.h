@@ -0,0 +1,80 @@
+#ifndef COMMON_GOP_CACHE_H_
+#define COMMON_GOP_CACHE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// The frames of an encoded stream since its last key frame, for --fast-start to replay to a
+// viewer that joins mid-stream so it can decode the current frame without waiting for, or asking
+// everyone for, the next key frame.
+//
+// Bounded by frame count and bytes: a GOP that outgrows either is dropped whole, and the cache
+// stays empty until the next key frame. A replay is only of use from a key frame on.
+//
+// Those bounds only keep memory in check; what a peer is actually sent is held to much less, see
+// kMaxGopReplayUs.
+template <typename T> class GopCache {
+  public:
+    static constexpr size_t kMaxFrames = 300;
+    static constexpr size_t kMaxBytes = 8 * 1024 * 1024;
+
+    GopCache(size_t max_frames = kMaxFrames, size_t max_bytes = kMaxBytes)
+        : max_frames_(max_frames),
+          max_bytes_(max_bytes),
+          bytes_(0) {}
+
+    GopCache(const GopCache &) = delete;
+    GopCache &operator=(const GopCache &) = delete;
+
+    void Add(T frame, bool is_key_frame, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (is_key_frame) {
+            frames_.clear();
+            bytes_ = 0;
+        } else if (frames_.empty()) {
+            return;
+        }
+        if (frames_.size() >= max_frames_ || bytes_ + size > max_bytes_) {
+            frames_.clear();
+            bytes_ = 0;
+            return;
+        }
+        frames_.push_back(std::move(frame));
+        bytes_ += size;
+    }
+
+    // A copy, key frame first; empty when there is no complete GOP to replay.
+    std::vector<T> Frames() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frames_;
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_.clear();
+        bytes_ = 0;
+    }
+
+  private:
+    const size_t max_frames_;
+    const size_t max_bytes_;
+    mutable std::mutex mutex_;
+    std::vector<T> frames_;
+    size_t bytes_;
+};
+
+// A replay goes out in one burst ahead of the live stream. One that spans more capture time than
+// this, or is more than a joining peer's link carries in that time at its start bitrate, is not
+// sent: the peer is left to the scheduled key frame, as without --fast-start.
+constexpr int64_t kMaxGopReplayUs = 2000000;
+
+// The most bytes a replay to a peer starting at `start_bitrate_kbps` may hold.
+inline size_t GopReplayBudget(int start_bitrate_kbps) {
+    return static_cast<size_t>(std::max(start_bitrate_kbps, 0)) * 1000 / 8 * kMaxGopReplayUs /
+           1000000;
+}
+
+#endif // COMMON_GOP_CACHE_H_
@@ -0,0 +1,34 @@
+#ifndef COMMON_INTERFACE_ENCODED_SOURCE_H_
+#define COMMON_INTERFACE_ENCODED_SOURCE_H_
+
+#include <vector>
+
+#include "common/interface/subject.h"
+#include "common/v4l2_frame_buffer.h"
+
+// A camera stream that is already H.264, shaped the way an H.264 camera delivers it: one Annex B
+// access unit per V4L2FrameBuffer of V4L2_PIX_FMT_H264, key frames flagged with
+// V4L2_BUF_FLAG_KEYFRAME and carrying SPS and PPS, and the capture timestamp of the raw frame.
+//
+// Whoever forwards the stream rather than muxing it can ask for a key frame or a different rate;
+// a source may ignore either. A source may also keep the frames since its last key frame, for a
+// peer that joins to start from without waiting for the next one.
+class EncodedSource {
+  public:
+    virtual ~EncodedSource() = default;
+
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    virtual int fps() const = 0;
+    virtual Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback) = 0;
+
+    // `requester`, from KeyFrameScheduler::NewRequesterId(), is who the request is counted for.
+    virtual void ForceKeyFrame(int requester) {}
+    // `requester`'s target rate, which a source weighs against everyone else's. 0 withdraws it,
+    // for a requester that is paused or gone.
+    virtual void SetBitrate(int requester, int bitrate_bps) {}
+    // Oldest first, starting with a key frame; empty when none is kept.
+    virtual std::vector<V4L2FrameBufferRef> CachedGop() const { return {}; }
+};
+
+#endif // COMMON_INTERFACE_ENCODED_SOURCE_H_
@@ -2,6 +2,7 @@
 #define COMMON_INTERFACE_SUBJECT_H_
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -31,12 +32,25 @@ class Subscription {
     std::function<void()> unsubscribe_;
 };
 
+// Observers are kept in an immutable list that Subscribe and unsubscribe replace wholesale, so
+// Next() runs without a lock or an allocation: it pins the current list with a reader count,
+// iterates it, and lets go. A replaced list is freed by a later writer once no reader can still be
+// iterating it. A callback may subscribe or unsubscribe, including itself, from inside Next().
 template <typename T> class Subject {
   public:
     using Callback = std::function<void(const T &)>;
 
     Subject()
-        : alive_(std::make_shared<bool>(true)) {}
+        : alive_(std::make_shared<bool>(true)),
+          readers_(0),
+          observers_(new List()) {}
+
+    ~Subject() {
+        delete observers_.load();
+        for (const List *list : retired_) {
+            delete list;
+        }
+    }
 
     Subscription Subscribe(Callback callback) {
         auto observer = std::make_shared<Observer>();
@@ -44,48 +58,76 @@ template <typename T> class Subject {
 
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            observers_.push_back(observer);
+            auto *list = new List(*observers_.load());
+            list->push_back(observer);
+            Replace(list);
         }
 
         std::weak_ptr<bool> weak_alive = alive_;
-        auto *mutex_ptr = &mutex_;
-        auto *observers_ptr = &observers_;
-        return Subscription{[weak_alive, mutex_ptr, observers_ptr, observer]() {
+        return Subscription{[this, weak_alive, observer]() {
             if (weak_alive.expired()) {
                 return;
             }
-            std::lock_guard<std::mutex> lock(*mutex_ptr);
-            observers_ptr->erase(
-                std::remove(observers_ptr->begin(), observers_ptr->end(), observer),
-                observers_ptr->end());
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto *list = new List(*observers_.load());
+            list->erase(std::remove(list->begin(), list->end(), observer), list->end());
+            Replace(list);
         }};
     }
 
     void Next(const T &value) {
-        std::vector<std::shared_ptr<Observer>> snapshot;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            snapshot = observers_;
-        }
-
-        for (auto &obs : snapshot) {
+        ReaderGuard guard(readers_);
+        const List *list = observers_.load();
+        for (const auto &obs : *list) {
             obs->callback(value);
         }
     }
 
     size_t ObserverCount() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return observers_.size();
+        ReaderGuard guard(readers_);
+        return observers_.load()->size();
     }
 
   private:
     struct Observer {
         Callback callback;
     };
+    using List = std::vector<std::shared_ptr<Observer>>;
+
+    // Counts a reader in for as long as it lives, so a callback that throws still lets go.
+    class ReaderGuard {
+      public:
+        explicit ReaderGuard(std::atomic<int> &readers)
+            : readers_(readers) {
+            readers_.fetch_add(1);
+        }
+        ~ReaderGuard() { readers_.fetch_sub(1, std::memory_order_release); }
+
+        ReaderGuard(const ReaderGuard &) = delete;
+        ReaderGuard &operator=(const ReaderGuard &) = delete;
+
+      private:
+        std::atomic<int> &readers_;
+    };
 
     std::shared_ptr<bool> alive_;
-    mutable std::mutex mutex_;
-    std::vector<std::shared_ptr<Observer>> observers_;
+    mutable std::atomic<int> readers_;
+    std::atomic<const List *> observers_;
+    // Writers only. Lists swapped out while a reader may still hold them.
+    std::mutex mutex_;
+    std::vector<const List *> retired_;
+
+    // Called with mutex_ held. A reader pins a list by counting itself in before loading it, so
+    // once the swap is done and the count reads zero, no reader holds any retired list.
+    void Replace(const List *list) {
+        retired_.push_back(observers_.exchange(list));
+        if (readers_.load() == 0) {
+            for (const List *retired : retired_) {
+                delete retired;
+            }
+            retired_.clear();
+        }
+    }
 };
 
 #endif // COMMON_INTERFACE_SUBJECT_H_
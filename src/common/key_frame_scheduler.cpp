@@ -0,0 +1,100 @@
+#include "common/key_frame_scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+#include "common/logging.h"
+
+namespace {
+
+std::mutex registry_mtx;
+std::vector<KeyFrameScheduler *> registry;
+std::atomic<int> next_requester_id{1};
+
+int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+std::shared_ptr<KeyFrameScheduler> KeyFrameScheduler::Create(Options options) {
+    return std::make_shared<KeyFrameScheduler>(std::move(options));
+}
+
+std::vector<KeyFrameScheduler::Stats> KeyFrameScheduler::TakeStats() {
+    std::vector<Stats> stats;
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    for (KeyFrameScheduler *scheduler : registry) {
+        std::lock_guard<std::mutex> scheduler_lock(scheduler->mtx_);
+        Stats s;
+        s.name = scheduler->options_.name;
+        s.granted = std::exchange(scheduler->granted_, 0);
+        s.merged = std::exchange(scheduler->merged_, 0);
+        s.requests.swap(scheduler->requests_);
+        stats.push_back(std::move(s));
+    }
+    return stats;
+}
+
+int KeyFrameScheduler::NewRequesterId() {
+    return next_requester_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+KeyFrameScheduler::KeyFrameScheduler(Options options)
+    : options_(std::move(options)),
+      pending_(0),
+      first_request_us_(0),
+      last_key_frame_us_(0),
+      granted_(0),
+      merged_(0) {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    registry.push_back(this);
+    DEBUG_PRINT("Key frames for '%s' are merged over %d ms and at least %d ms apart.",
+                options_.name.c_str(), options_.merge_window_ms, options_.min_interval_ms);
+}
+
+KeyFrameScheduler::~KeyFrameScheduler() {
+    std::lock_guard<std::mutex> lock(registry_mtx);
+    registry.erase(std::remove(registry.begin(), registry.end(), this), registry.end());
+}
+
+void KeyFrameScheduler::Request(int requester) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    requests_[requester]++;
+    if (pending_++ == 0) {
+        first_request_us_ = NowUs();
+    }
+}
+
+bool KeyFrameScheduler::Poll() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (pending_ == 0) {
+        return false;
+    }
+    const int64_t now_us = NowUs();
+    if (now_us - first_request_us_ < options_.merge_window_ms * 1000LL) {
+        return false;
+    }
+    if (last_key_frame_us_ != 0 &&
+        now_us - last_key_frame_us_ < options_.min_interval_ms * 1000LL) {
+        return false;
+    }
+    granted_++;
+    merged_ += pending_ - 1;
+    pending_ = 0;
+    // Counted from here rather than from when the encoder delivers it, which for a hardware
+    // encoder is a frame or two later.
+    last_key_frame_us_ = now_us;
+    return true;
+}
+
+void KeyFrameScheduler::OnKeyFrame() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    last_key_frame_us_ = NowUs();
+    merged_ += pending_;
+    pending_ = 0;
+}
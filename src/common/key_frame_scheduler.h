@@ -0,0 +1,61 @@
+#ifndef COMMON_KEY_FRAME_SCHEDULER_H_
+#define COMMON_KEY_FRAME_SCHEDULER_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Decides when an encoder forces a key frame, for everyone who may ask it for one: the peers of a
+// shared encode, or the one peer of its own that keeps losing packets.
+//
+// A request is held for a merge window, and every request that arrives in it is answered by the
+// same key frame. A forced key frame also waits until the last one, forced or the encoder's own,
+// is at least the minimum interval old, so a burst of joins or loss reports costs one IDR rather
+// than one each. A request still waiting when the encoder makes a key frame anyway is answered by
+// that one.
+class KeyFrameScheduler {
+  public:
+    struct Options {
+        std::string name;
+        int merge_window_ms = 0;
+        int min_interval_ms = 0;
+    };
+
+    struct Stats {
+        std::string name;
+        uint64_t granted = 0; // key frames forced
+        uint64_t merged = 0;  // requests answered by a key frame forced or made for another
+        std::map<int, uint64_t> requests; // by requester
+    };
+
+    static std::shared_ptr<KeyFrameScheduler> Create(Options options);
+    // Every live scheduler, with the counts since the previous call.
+    static std::vector<Stats> TakeStats();
+    // An id for one requester's count in Stats, unique for the life of the process.
+    static int NewRequesterId();
+
+    explicit KeyFrameScheduler(Options options);
+    ~KeyFrameScheduler();
+
+    // Any thread.
+    void Request(int requester);
+    // The encoder's thread, once for each frame about to be encoded. Whether to force a key frame.
+    bool Poll();
+    // The encoder's thread, for every key frame it delivers.
+    void OnKeyFrame();
+
+  private:
+    const Options options_;
+    std::mutex mtx_;
+    int pending_;
+    int64_t first_request_us_;
+    int64_t last_key_frame_us_;
+    uint64_t granted_;
+    uint64_t merged_;
+    std::map<int, uint64_t> requests_;
+};
+
+#endif // COMMON_KEY_FRAME_SCHEDULER_H_
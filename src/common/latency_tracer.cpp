@@ -10,6 +10,10 @@
 #include <mutex>
 #include <string>
 
+#include "common/frame_buffer_pool.h"
+#include "common/frame_decimator.h"
+#include "common/frame_mailbox.h"
+#include "common/key_frame_scheduler.h"
 #include "common/logging.h"
 #include "common/worker.h"
 
@@ -31,17 +35,18 @@ constexpr int kSlotBits = 10;
 constexpr int kSlotCount = 1 << kSlotBits;
 
 const char *const kStageNames[] = {
-    "sensor->capture", "sensor->track_in", "sensor->onframe",  "sensor->encode_in",
-    "sensor->encoded", "sensor->sent",     "capture_cb_work",  "argus_copy",
-    "i420_scale",      "nvtransform",      "scaler_dwell",     "hw_encode_dwell",
-    "encode_call",     "on_encoded_image", "capture_interval",
+    "sensor->capture",  "sensor->track_in", "sensor->onframe", "sensor->encode_in",
+    "sensor->encoded",  "sensor->sent",     "capture_cb_work", "argus_copy",
+    "mjpeg_decode",     "i420_scale",       "pyramid",         "nvtransform",
+    "scaler_dwell",     "scaler_switch",    "hw_encode_dwell", "encode_call",
+    "on_encoded_image", "capture_interval",
 };
 static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) ==
                   static_cast<size_t>(Stage::kStageCount),
               "kStageNames must stay in sync with Stage");
 
 const char *const kCounterNames[] = {
-    "captured",     "encoded",      "adapt_drop", "encoder_queue_drop",
+    "captured",     "encoded",      "scaler_hit", "scaler_miss", "adapt_drop", "encoder_queue_drop",
     "scaler_nobuf", "scaler_qfull", "v4l2_nobuf", "dq_timeout",
 };
 static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) ==
@@ -268,6 +273,68 @@ void Report() {
                   g_produced_kbps.load(std::memory_order_relaxed));
     table += line;
 
+    // A steady miss count means owning frames are outliving the pool's bound and every clone is a
+    // fresh allocation again.
+    const FrameBufferPool::Stats pool = FrameBufferPool::Shared().TakeStats();
+    std::snprintf(line, sizeof(line),
+                  "\n  -- frame pool -- hit=%llu miss=%llu outstanding=%llu high_water=%llu "
+                  "pooled=%.1fMB",
+                  static_cast<unsigned long long>(pool.hits),
+                  static_cast<unsigned long long>(pool.misses),
+                  static_cast<unsigned long long>(pool.outstanding),
+                  static_cast<unsigned long long>(pool.high_water),
+                  pool.pooled_bytes / (1024.0 * 1024.0));
+    table += line;
+
+    // Only on the hardware scaler path, and only once AdaptFrame() has changed the size. Misses
+    // that keep coming mean the sizes cycle through more scalers than are kept open.
+    const uint64_t scaler_hits = counters[static_cast<int>(Counter::kScalerCacheHit)];
+    const uint64_t scaler_misses = counters[static_cast<int>(Counter::kScalerCacheMiss)];
+    if (scaler_hits + scaler_misses > 0) {
+        std::snprintf(line, sizeof(line), "\n  -- scaler cache -- hit=%llu miss=%llu",
+                      static_cast<unsigned long long>(scaler_hits),
+                      static_cast<unsigned long long>(scaler_misses));
+        table += line;
+    }
+
+    // Only with --async-dispatch. A subscriber whose depth sits at its high water mark is not
+    // keeping up, and its drops are frames the capture thread would otherwise have waited on.
+    for (const FrameMailbox::Stats &mailbox : FrameMailbox::TakeStats()) {
+        std::snprintf(line, sizeof(line),
+                      "\n  -- subscriber %s -- depth=%zu high_water=%zu delivered=%llu dropped=%llu",
+                      mailbox.name.c_str(), mailbox.depth, mailbox.high_water,
+                      static_cast<unsigned long long>(mailbox.delivered),
+                      static_cast<unsigned long long>(mailbox.dropped));
+        table += line;
+    }
+
+    // Subscribers capped with a frame rate. The skips are by design; a passed count well under
+    // the cap means the camera itself is delivering less.
+    for (const FrameDecimator::Stats &decimator : FrameDecimator::TakeStats()) {
+        std::snprintf(line, sizeof(line), "\n  -- rate %s -- max_fps=%d passed=%llu skipped=%llu",
+                      decimator.name.c_str(), decimator.max_fps,
+                      static_cast<unsigned long long>(decimator.passed),
+                      static_cast<unsigned long long>(decimator.skipped));
+        table += line;
+    }
+
+    // Only the encoders something asked for a key frame. Requests well above granted are the
+    // scheduler at work; a peer whose count keeps climbing is one that keeps losing packets.
+    for (const KeyFrameScheduler::Stats &key_frames : KeyFrameScheduler::TakeStats()) {
+        if (key_frames.requests.empty() && key_frames.granted == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "\n  -- key frames %s -- granted=%llu merged=%llu",
+                      key_frames.name.c_str(), static_cast<unsigned long long>(key_frames.granted),
+                      static_cast<unsigned long long>(key_frames.merged));
+        table += line;
+        for (const auto &[requester, count] : key_frames.requests) {
+            std::snprintf(line, sizeof(line), " peer%d=%llu", requester,
+                          static_cast<unsigned long long>(count));
+            table += line;
+        }
+    }
+
     std::snprintf(line, sizeof(line), "\n  -- resolution -- src %dx%d  sent %dx%d",
                   g_src_width.load(std::memory_order_relaxed),
                   g_src_height.load(std::memory_order_relaxed),
@@ -23,11 +23,14 @@ enum class Stage : int {
     kSensorToEncoded,     // -> the encoded frame comes back out of the encoder
     kSensorToSent,        // -> OnEncodedImage() returned, i.e. packetized and handed to the pacer
 
-    kCaptureCallback, // libcamera RequestComplete entry -> queueRequest (buffer starvation window)
+    kCaptureCallback, // libcamera RequestComplete entry -> requeue or lend (buffer starvation window)
     kArgusCopy,       // IImageNativeBuffer::copyToNvBuffer
-    kI420Scale,       // ToI420() + I420Buffer::ScaleFrom
+    kMjpegDecode,     // software MJPEG decode, at whatever DCT scale was asked for
+    kI420Scale,       // frame_scaler::Scale, crop + convert + scale to I420
+    kPyramid,         // the FramePyramid levels one consumer had built
     kNvTransform,     // NvBufSurf::NvTransform
     kScalerDwell,     // scaler queue push -> pop on the worker thread
+    kScalerSwitch,    // moving to another hw scaler when AdaptFrame() changes the size
     kHwEncodeDwell,   // buffer queued to the hw encoder -> dequeued from the capture plane
     kEncodeCall,      // duration of VideoEncoder::Encode() (the whole cost for sync encoders)
     kOnEncodedImage,  // duration of the downstream OnEncodedImage(): packetize + pacer handoff
@@ -39,6 +42,8 @@ enum class Stage : int {
 enum class Counter : int {
     kFramesCaptured = 0,
     kFramesEncoded,
+    kScalerCacheHit,   // a hw scaler switch found the scaler already open
+    kScalerCacheMiss,  // a hw scaler had to be opened
     kAdaptDrop,        // AdaptFrame() returned false
     kEncoderQueueDrop, // handed to OnFrame() but never reached Encode()
     kScalerNoBuffer,   // scaler had no free buffer
@@ -0,0 +1,67 @@
+#include "common/latest_frame.h"
+
+#include <thread>
+
+namespace {
+
+// How often a waiting reader looks for a fresh frame. Well under a frame interval, and readers
+// are rare enough that the polling costs nothing.
+constexpr auto kPollInterval = std::chrono::milliseconds(2);
+
+} // namespace
+
+LatestFrame::LatestFrame()
+    : back_(0),
+      middle_(1),
+      front_(2),
+      seq_(0),
+      waiting_(0) {}
+
+void LatestFrame::Post(const V4L2FrameBufferRef &frame_buffer) {
+    Post(frame_buffer->timestamp(), [&frame_buffer]() {
+        return frame_buffer->ToI420();
+    });
+}
+
+void LatestFrame::Post(timeval timestamp, const std::function<I420BufferRef()> &to_i420) {
+    const uint64_t seq = seq_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (waiting_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    auto i420_buffer = to_i420();
+    if (!i420_buffer) {
+        return;
+    }
+
+    Frame &slot = slots_[back_];
+    slot.buffer = webrtc::I420Buffer::Copy(*i420_buffer);
+    slot.seq = seq;
+    slot.timestamp = timestamp;
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & ~kFresh;
+}
+
+LatestFrame::Frame LatestFrame::Take(std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(reader_mtx_);
+    const uint64_t requested_at = seq_.load(std::memory_order_relaxed);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    waiting_.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+        if (middle_.load(std::memory_order_acquire) & kFresh) {
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & ~kFresh;
+            // A frame left over from a reader that gave up is older than this request.
+            if (slots_[front_].seq > requested_at) {
+                break;
+            }
+            continue;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(kPollInterval);
+    }
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+
+    return slots_[front_];
+}
@@ -0,0 +1,56 @@
+#ifndef COMMON_LATEST_FRAME_H_
+#define COMMON_LATEST_FRAME_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "common/v4l2_frame_buffer.h"
+
+// A single-slot mailbox that carries the newest frame of a stream from its capture thread to
+// readers on other threads, such as snapshots and recording thumbnails.
+//
+// Frames are only copied while a reader is waiting for one. The copy is an owning I420 buffer,
+// so a reader never sees capture memory that has gone back to the driver. The three slots form a
+// triple buffer: the capture thread fills its own slot and swaps it in with one atomic exchange,
+// and never waits for a reader. Readers are serialised among themselves.
+class LatestFrame {
+  public:
+    using I420BufferRef = webrtc::scoped_refptr<webrtc::I420BufferInterface>;
+
+    struct Frame {
+        I420BufferRef buffer;
+        // Counts every frame offered to the mailbox, so a gap shows how many were skipped.
+        uint64_t seq = 0;
+        timeval timestamp = {};
+    };
+
+    LatestFrame();
+
+    // Capture thread, for every frame the stream hands out.
+    void Post(const V4L2FrameBufferRef &frame_buffer);
+    // Same, for a stream that only produces its I420 image on request, e.g. a scaled sub stream.
+    void Post(timeval timestamp, const std::function<I420BufferRef()> &to_i420);
+
+    // Returns the first frame posted after the call, waiting up to `timeout` for it. Once the
+    // timeout expires it returns the last frame it had instead, which is empty if none arrived.
+    Frame Take(std::chrono::milliseconds timeout);
+
+  private:
+    static constexpr uint8_t kFresh = 0x4;
+
+    Frame slots_[3];
+    // Slot the capture thread fills next. Only touched by the capture thread.
+    uint8_t back_;
+    // Slot index of the newest complete frame, with kFresh set until a reader takes it.
+    std::atomic<uint8_t> middle_;
+    // Slot the readers last took. Guarded by reader_mtx_.
+    uint8_t front_;
+    std::atomic<uint64_t> seq_;
+    std::atomic<int> waiting_;
+    std::mutex reader_mtx_;
+};
+
+#endif // COMMON_LATEST_FRAME_H_
@@ -0,0 +1,37 @@
+#include "common/layered_frame_buffer.h"
+
+#include "common/frame_scaler.h"
+
+webrtc::scoped_refptr<LayeredFrameBuffer>
+LayeredFrameBuffer::Create(V4L2FrameBufferRef frame_buffer) {
+    return webrtc::make_ref_counted<LayeredFrameBuffer>(std::move(frame_buffer));
+}
+
+LayeredFrameBuffer::LayeredFrameBuffer(V4L2FrameBufferRef frame_buffer)
+    : frame_buffer_(frame_buffer),
+      pyramid_(std::move(frame_buffer)) {}
+
+webrtc::VideoFrameBuffer::Type LayeredFrameBuffer::type() const { return Type::kNative; }
+
+int LayeredFrameBuffer::width() const { return frame_buffer_->width(); }
+
+int LayeredFrameBuffer::height() const { return frame_buffer_->height(); }
+
+webrtc::scoped_refptr<webrtc::I420BufferInterface> LayeredFrameBuffer::ToI420() {
+    return frame_buffer_->ToI420();
+}
+
+webrtc::scoped_refptr<webrtc::VideoFrameBuffer>
+LayeredFrameBuffer::GetMappedFrameBuffer(webrtc::ArrayView<Type> types) {
+    return frame_buffer_->GetMappedFrameBuffer(types);
+}
+
+webrtc::scoped_refptr<webrtc::VideoFrameBuffer>
+LayeredFrameBuffer::CropAndScale(int offset_x, int offset_y, int crop_width, int crop_height,
+                                 int scaled_width, int scaled_height) {
+    if (offset_x != 0 || offset_y != 0 || crop_width != width() || crop_height != height()) {
+        return frame_scaler::Scale(frame_buffer_, offset_x, offset_y, crop_width, crop_height,
+                                   scaled_width, scaled_height);
+    }
+    return pyramid_.Scale(scaled_width, scaled_height);
+}
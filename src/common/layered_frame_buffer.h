@@ -0,0 +1,36 @@
+#ifndef COMMON_LAYERED_FRAME_BUFFER_H_
+#define COMMON_LAYERED_FRAME_BUFFER_H_
+
+#include <api/video/video_frame_buffer.h>
+
+#include "common/frame_pyramid.h"
+#include "common/v4l2_frame_buffer.h"
+
+// A frame handed to a simulcast encoder, which asks for one downscaled copy per layer. Instead
+// of each layer scaling the full frame, the uncropped copies come from the frame's FramePyramid,
+// and a layer between two halvings is scaled from the nearest larger one.
+//
+// Everything else, ToI420() and the in-place mapping included, is the full frame's.
+class LayeredFrameBuffer : public webrtc::VideoFrameBuffer {
+  public:
+    static webrtc::scoped_refptr<LayeredFrameBuffer> Create(V4L2FrameBufferRef frame_buffer);
+
+    explicit LayeredFrameBuffer(V4L2FrameBufferRef frame_buffer);
+
+    Type type() const override;
+    int width() const override;
+    int height() const override;
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer>
+    GetMappedFrameBuffer(webrtc::ArrayView<Type> types) override;
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> CropAndScale(int offset_x, int offset_y,
+                                                                 int crop_width, int crop_height,
+                                                                 int scaled_width,
+                                                                 int scaled_height) override;
+
+  private:
+    const V4L2FrameBufferRef frame_buffer_;
+    FramePyramid pyramid_;
+};
+
+#endif // COMMON_LAYERED_FRAME_BUFFER_H_
@@ -0,0 +1,425 @@
+#include "common/mjpeg_decoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csetjmp>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include <jpeglib.h>
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "common/latency_tracer.h"
+#include "common/logging.h"
+#include "common/thread_pool.h"
+
+namespace {
+
+// A stripe also pays for a header parse and a copy of its rows, which stops paying off below
+// a few MCU rows.
+constexpr int kMinStripeMcuRows = 4;
+
+struct ErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+void OnError(j_common_ptr cinfo) { longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1); }
+
+// UVC cameras routinely send a few corrupt bytes, which libjpeg recovers from on its own.
+void OnMessage(j_common_ptr) {}
+
+struct I420Planes {
+    uint8_t *y;
+    uint8_t *u;
+    uint8_t *v;
+    int stride_y;
+    int stride_uv;
+};
+
+// What decoding needs to know about a frame before handing it to libjpeg: its size, whether raw
+// output can produce I420 from it, and where its restart intervals sit.
+struct Layout {
+    int width = 0;
+    int height = 0;
+    int mcu_width = 0;  // in pixels
+    int mcu_height = 0; // in pixels
+    bool planar = false;
+    int restart_interval = 0; // in MCUs
+    size_t height_offset = 0; // of the image height in the frame header
+    size_t scan_offset = 0;   // first entropy-coded byte
+    // [begin, end) of each restart interval. Empty when the frame cannot be cut into stripes.
+    std::vector<std::pair<size_t, size_t>> segments;
+};
+
+int ReadU16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+
+int ScaledSize(int size, int denom) { return (size + denom - 1) / denom; }
+
+int ScaledBlockSize(const jpeg_component_info &component) {
+#if JPEG_LIB_VERSION >= 70
+    return component.DCT_v_scaled_size;
+#else
+    return component.DCT_scaled_size;
+#endif
+}
+
+void FindSegments(const uint8_t *data, size_t size, Layout *layout) {
+    size_t begin = layout->scan_offset;
+    for (size_t i = begin; i + 1 < size; i++) {
+        // 0xFF00 is a stuffed data byte and 0xFFFF a fill byte; anything else is a marker.
+        if (data[i] != 0xFF || data[i + 1] == 0x00 || data[i + 1] == 0xFF) {
+            continue;
+        }
+        layout->segments.emplace_back(begin, i);
+        if (data[i + 1] < 0xD0 || data[i + 1] > 0xD7) {
+            return;
+        }
+        begin = i + 2;
+        i++;
+    }
+    // Cut short before EOI; libjpeg makes the best of it in one piece.
+    layout->segments.clear();
+}
+
+bool ParseLayout(const uint8_t *data, size_t size, Layout *layout) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    bool sequential = false;
+    int components = 0;
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+        const size_t length = ReadU16(data + pos + 2);
+        const uint8_t *payload = data + pos + 4;
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+            marker != 0xCC) {
+            if (length < 8) {
+                return false;
+            }
+            components = payload[5];
+            if (length < 8 + 3 * static_cast<size_t>(components)) {
+                return false;
+            }
+            layout->height_offset = pos + 5;
+            layout->height = ReadU16(payload + 1);
+            layout->width = ReadU16(payload + 3);
+
+            int sampling[3] = {};
+            int max_h = 1;
+            int max_v = 1;
+            for (int i = 0; i < components; i++) {
+                const uint8_t factors = payload[6 + 3 * i + 1];
+                max_h = std::max(max_h, factors >> 4);
+                max_v = std::max(max_v, factors & 0x0F);
+                if (i < 3) {
+                    sampling[i] = factors;
+                }
+            }
+            layout->mcu_width = 8 * max_h;
+            layout->mcu_height = 8 * max_v;
+            // 4:2:0, 4:2:2 or 4:4:4 luma over 1x1 chroma.
+            layout->planar = components == 3 &&
+                             (sampling[0] == 0x22 || sampling[0] == 0x21 || sampling[0] == 0x11) &&
+                             sampling[1] == 0x11 && sampling[2] == 0x11;
+            // Only a Huffman-coded sequential frame is a single scan that restarts can cut.
+            sequential = marker == 0xC0 || marker == 0xC1;
+        } else if (marker == 0xDD && length >= 4) {
+            layout->restart_interval = ReadU16(payload);
+        } else if (marker == 0xDA) {
+            if (layout->width == 0 || layout->height == 0) {
+                return false;
+            }
+            if (sequential && layout->planar && layout->restart_interval > 0 && length >= 3 &&
+                payload[0] == components) {
+                layout->scan_offset = pos + 2 + length;
+                FindSegments(data, size, layout);
+            }
+            return true;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+// Returns how many stripes to decode the frame in, 1 when it cannot or need not be cut. A stripe
+// is always whole MCU rows and whole restart intervals, so each one decodes on its own.
+int PlanStripes(const Layout &layout, int denom, int *rows_per_stripe, int *segments_per_stripe) {
+    if (layout.segments.empty()) {
+        return 1;
+    }
+
+    const int mcus_per_row = (layout.width + layout.mcu_width - 1) / layout.mcu_width;
+    const int mcu_rows = (layout.height + layout.mcu_height - 1) / layout.mcu_height;
+    const int interval = layout.restart_interval;
+    if (layout.segments.size() !=
+        static_cast<size_t>((mcus_per_row * mcu_rows + interval - 1) / interval)) {
+        return 1;
+    }
+
+    // The smallest run of MCU rows that is also a run of whole restart intervals.
+    int unit_rows;
+    int unit_segments;
+    if (interval % mcus_per_row == 0) {
+        unit_rows = interval / mcus_per_row;
+        unit_segments = 1;
+    } else if (mcus_per_row % interval == 0) {
+        unit_rows = 1;
+        unit_segments = mcus_per_row / interval;
+    } else {
+        return 1;
+    }
+    // Every stripe starts on an even output row, so none shares a chroma row with the next.
+    if ((unit_rows * layout.mcu_height / denom) % 2 != 0) {
+        unit_rows *= 2;
+        unit_segments *= 2;
+    }
+
+    const int units = (mcu_rows + unit_rows - 1) / unit_rows;
+    const int stripes = std::min({ThreadPool::Shared().concurrency(), units,
+                                  std::max(mcu_rows / kMinStripeMcuRows, 1)});
+    if (stripes <= 1) {
+        return 1;
+    }
+    const int units_per_stripe = (units + stripes - 1) / stripes;
+    *rows_per_stripe = units_per_stripe * unit_rows;
+    *segments_per_stripe = units_per_stripe * unit_segments;
+    return (units + units_per_stripe - 1) / units_per_stripe;
+}
+
+// A JPEG of its own for a run of restart intervals: the frame's headers with the image height cut
+// down to the stripe, then the intervals with their markers renumbered from RST0.
+void BuildStripe(const uint8_t *data, const Layout &layout, int first_segment, int segment_count,
+                 int height, std::vector<uint8_t> *stripe) {
+    stripe->assign(data, data + layout.scan_offset);
+    (*stripe)[layout.height_offset] = height >> 8;
+    (*stripe)[layout.height_offset + 1] = height & 0xFF;
+    for (int i = 0; i < segment_count; i++) {
+        if (i > 0) {
+            stripe->push_back(0xFF);
+            stripe->push_back(0xD0 + (i - 1) % 8);
+        }
+        const auto &segment = layout.segments[first_segment + i];
+        stripe->insert(stripe->end(), data + segment.first, data + segment.second);
+    }
+    stripe->push_back(0xFF);
+    stripe->push_back(0xD9);
+}
+
+// Decodes at 1/`denom` into `dst`, which takes exactly `width` x `height` from its first row.
+// Raw output skips libjpeg's upsampling and color conversion; libyuv then takes each band of
+// planes down to I420 while it is still in cache.
+bool DecodeInto(const uint8_t *data, size_t size, int denom, int width, int height,
+                const I420Planes &dst) {
+    thread_local std::vector<uint8_t> scratch;
+
+    jpeg_decompress_struct cinfo;
+    ErrorManager error;
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = OnError;
+    error.pub.output_message = OnMessage;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<uint8_t *>(data), size);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK || cinfo.num_components != 3) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.raw_data_out = TRUE;
+    cinfo.out_color_space = JCS_YCbCr;
+    cinfo.do_fancy_upsampling = FALSE;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    jpeg_start_decompress(&cinfo);
+
+    // Planes as raw output hands them over. libjpeg-turbo scales chroma blocks up in the IDCT
+    // where it can, so at a reduced scale the chroma planes can come out at luma resolution.
+    const jpeg_component_info *components = cinfo.comp_info;
+    int rows[3];
+    int strides[3];
+    for (int i = 0; i < 3; i++) {
+        const int block = ScaledBlockSize(components[i]);
+        const int h_samp = components[i].h_samp_factor;
+        rows[i] = components[i].v_samp_factor * block;
+        // Whole MCUs are written, so the last one may reach past the image.
+        strides[i] = (components[i].width_in_blocks + h_samp - 1) / h_samp * h_samp * block;
+    }
+    const int chroma_h = strides[0] / strides[1];
+    const int chroma_v = rows[0] / rows[1];
+    if (static_cast<int>(cinfo.output_width) != width ||
+        static_cast<int>(cinfo.output_height) != height || strides[1] != strides[2] ||
+        rows[1] != rows[2] || strides[0] != chroma_h * strides[1] ||
+        rows[0] != chroma_v * rows[1] || chroma_h > 2 || chroma_v > chroma_h ||
+        rows[0] > 16) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    // Bands are an even number of rows, so that each maps onto whole I420 chroma rows.
+    const int passes = rows[0] % 2 != 0 ? 2 : 1;
+    scratch.resize(passes * (rows[0] * strides[0] + 2 * rows[1] * strides[1]));
+    uint8_t *planes[3];
+    planes[0] = scratch.data();
+    planes[1] = planes[0] + passes * rows[0] * strides[0];
+    planes[2] = planes[1] + passes * rows[1] * strides[1];
+    JSAMPROW row_pointers[3][32];
+    for (int i = 0; i < 3; i++) {
+        for (int r = 0; r < passes * rows[i]; r++) {
+            row_pointers[i][r] = planes[i] + r * strides[i];
+        }
+    }
+
+    int y = 0;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        int band = 0;
+        for (int pass = 0; pass < passes && cinfo.output_scanline < cinfo.output_height; pass++) {
+            JSAMPARRAY arrays[3] = {row_pointers[0] + pass * rows[0],
+                                    row_pointers[1] + pass * rows[1],
+                                    row_pointers[2] + pass * rows[2]};
+            if (jpeg_read_raw_data(&cinfo, arrays, rows[0]) == 0) {
+                jpeg_destroy_decompress(&cinfo);
+                return false;
+            }
+            band += rows[0];
+        }
+
+        const int band_height = std::min(band, height - y);
+        uint8_t *dst_y = dst.y + y * dst.stride_y;
+        uint8_t *dst_u = dst.u + y / 2 * dst.stride_uv;
+        uint8_t *dst_v = dst.v + y / 2 * dst.stride_uv;
+        if (chroma_v == 2) {
+            libyuv::I420Copy(planes[0], strides[0], planes[1], strides[1], planes[2], strides[2],
+                             dst_y, dst.stride_y, dst_u, dst.stride_uv, dst_v, dst.stride_uv,
+                             width, band_height);
+        } else if (chroma_h == 2) {
+            libyuv::I422ToI420(planes[0], strides[0], planes[1], strides[1], planes[2],
+                               strides[2], dst_y, dst.stride_y, dst_u, dst.stride_uv, dst_v,
+                               dst.stride_uv, width, band_height);
+        } else {
+            libyuv::I444ToI420(planes[0], strides[0], planes[1], strides[1], planes[2],
+                               strides[2], dst_y, dst.stride_y, dst_u, dst.stride_uv, dst_v,
+                               dst.stride_uv, width, band_height);
+        }
+        y += band;
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+V4L2FrameBufferRef CreateI420(int width, int height, I420Planes *planes) {
+    const int stride_uv = (width + 1) / 2;
+    const int chroma_size = stride_uv * ((height + 1) / 2);
+    auto frame = V4L2FrameBuffer::Create(width, height, width * height + 2 * chroma_size,
+                                         V4L2_PIX_FMT_YUV420);
+    planes->y = frame->MutableData();
+    planes->u = planes->y + width * height;
+    planes->v = planes->u + chroma_size;
+    planes->stride_y = width;
+    planes->stride_uv = stride_uv;
+    return frame;
+}
+
+} // namespace
+
+namespace mjpeg_decoder {
+
+V4L2FrameBufferRef Decode(const V4L2FrameBufferRef &jpeg, int width, int height) {
+    const int64_t start_us = latency::Enabled() ? latency::NowUs() : 0;
+    const auto *data = static_cast<const uint8_t *>(jpeg->Data());
+    const size_t size = jpeg->size();
+
+    Layout layout;
+    if (!data || !ParseLayout(data, size, &layout)) {
+        DEBUG_PRINT("Dropped an MJPEG frame without a readable header.");
+        return nullptr;
+    }
+
+    I420Planes dst;
+    V4L2FrameBufferRef frame;
+    if (!layout.planar) {
+        // Grayscale or unusual sampling: left to libyuv, at full size.
+        frame = CreateI420(layout.width, layout.height, &dst);
+        if (libyuv::ConvertToI420(data, size, dst.y, dst.stride_y, dst.u, dst.stride_uv, dst.v,
+                                  dst.stride_uv, 0, 0, layout.width, layout.height,
+                                  layout.width, layout.height, libyuv::kRotate0,
+                                  V4L2_PIX_FMT_MJPEG) < 0) {
+            return nullptr;
+        }
+        frame->SetTimestamp(jpeg->timestamp());
+        return frame;
+    }
+
+    int denom = 1;
+    for (int d = 8; d > 1; d /= 2) {
+        if (ScaledSize(layout.width, d) >= width && ScaledSize(layout.height, d) >= height) {
+            denom = d;
+            break;
+        }
+    }
+    const int out_width = ScaledSize(layout.width, denom);
+    const int out_height = ScaledSize(layout.height, denom);
+    frame = CreateI420(out_width, out_height, &dst);
+
+    int rows_per_stripe = 0;
+    int segments_per_stripe = 0;
+    const int stripes = PlanStripes(layout, denom, &rows_per_stripe, &segments_per_stripe);
+    bool ok;
+    if (stripes > 1) {
+        std::atomic<bool> stripes_ok(true);
+        ThreadPool::Shared().ParallelFor(stripes, [&](int i) {
+            thread_local std::vector<uint8_t> stripe;
+            const int top = i * rows_per_stripe * layout.mcu_height;
+            const int stripe_height =
+                std::min(layout.height - top, rows_per_stripe * layout.mcu_height);
+            const int first_segment = i * segments_per_stripe;
+            const int segment_count = std::min(
+                segments_per_stripe, static_cast<int>(layout.segments.size()) - first_segment);
+            BuildStripe(data, layout, first_segment, segment_count, stripe_height, &stripe);
+
+            const int out_top = top / denom;
+            I420Planes planes = dst;
+            planes.y += out_top * dst.stride_y;
+            planes.u += out_top / 2 * dst.stride_uv;
+            planes.v += out_top / 2 * dst.stride_uv;
+            if (!DecodeInto(stripe.data(), stripe.size(), denom, out_width,
+                            ScaledSize(stripe_height, denom), planes)) {
+                stripes_ok.store(false, std::memory_order_relaxed);
+            }
+        });
+        ok = stripes_ok.load(std::memory_order_relaxed);
+    } else {
+        ok = DecodeInto(data, size, denom, out_width, out_height, dst);
+    }
+
+    if (!ok) {
+        DEBUG_PRINT("Dropped an MJPEG frame that failed to decode.");
+        return nullptr;
+    }
+    frame->SetTimestamp(jpeg->timestamp());
+    if (latency::Enabled()) {
+        latency::RecordSince(latency::Stage::kMjpegDecode, start_us);
+    }
+    return frame;
+}
+
+} // namespace mjpeg_decoder
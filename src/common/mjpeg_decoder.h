@@ -0,0 +1,22 @@
+#ifndef COMMON_MJPEG_DECODER_H_
+#define COMMON_MJPEG_DECODER_H_
+
+#include "common/v4l2_frame_buffer.h"
+
+// Software MJPEG decoding for USB cameras on hosts without a V4L2 M2M decoder, in place of the
+// single-threaded full-resolution decode libyuv does behind ToI420().
+//
+// libjpeg-turbo scales in the DCT domain, so a consumer that only wants a half, quarter or eighth
+// of the frame never pays for the full one. A frame with restart markers on MCU-row boundaries,
+// which most UVC cameras emit, is cut into horizontal stripes that the shared ThreadPool decodes
+// side by side; anything else is decoded in one piece.
+namespace mjpeg_decoder {
+
+// Decodes `jpeg` into a pooled I420 frame at the smallest DCT scale, from 1/8 up to 1/1, that
+// still covers `width` x `height`, so the result may be larger than asked for and the caller
+// scales what is left. The timestamp is carried over. Returns nullptr when the frame is corrupt.
+V4L2FrameBufferRef Decode(const V4L2FrameBufferRef &jpeg, int width, int height);
+
+} // namespace mjpeg_decoder
+
+#endif // COMMON_MJPEG_DECODER_H_
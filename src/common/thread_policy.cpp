@@ -0,0 +1,201 @@
+#include "common/thread_policy.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "common/logging.h"
+
+namespace thread_policy {
+
+namespace {
+
+struct Rule {
+    std::string name;
+    bool is_prefix = false;
+    std::vector<int> cpus;
+    std::optional<int> sched_policy;
+    int sched_priority = 0;
+    std::optional<int> nice;
+};
+
+std::mutex g_mutex;
+std::vector<Rule> g_rules;
+
+std::string Trim(const std::string &s) {
+    const size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    const size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+int ParseInt(const std::string &value, int min, int max, const std::string &setting) {
+    size_t used = 0;
+    int n = 0;
+    try {
+        n = std::stoi(value, &used);
+    } catch (const std::exception &) {
+        used = 0;
+    }
+    if (used == 0 || used != value.size() || n < min || n > max) {
+        throw std::runtime_error("Invalid thread policy setting \"" + setting + "\": expected " +
+                                 std::to_string(min) + " to " + std::to_string(max));
+    }
+    return n;
+}
+
+std::vector<int> ParseCpus(const std::string &value, const std::string &setting) {
+    std::vector<int> cpus;
+    std::istringstream list(value);
+    for (std::string item; std::getline(list, item, ',');) {
+        const size_t dash = item.find('-');
+        if (dash == std::string::npos) {
+            cpus.push_back(ParseInt(item, 0, CPU_SETSIZE - 1, setting));
+            continue;
+        }
+        const int first = ParseInt(item.substr(0, dash), 0, CPU_SETSIZE - 1, setting);
+        const int last = ParseInt(item.substr(dash + 1), first, CPU_SETSIZE - 1, setting);
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) {
+        throw std::runtime_error("Invalid thread policy setting \"" + setting +
+                                 "\": no cpus given");
+    }
+    return cpus;
+}
+
+Rule ParseRule(const std::string &text) {
+    const size_t eq = text.find('=');
+    if (eq == std::string::npos) {
+        throw std::runtime_error("Invalid thread policy rule \"" + text +
+                                 "\": expected <name>=<settings>");
+    }
+
+    Rule rule;
+    rule.name = Trim(text.substr(0, eq));
+    if (!rule.name.empty() && rule.name.back() == '*') {
+        rule.is_prefix = true;
+        rule.name.pop_back();
+    }
+    if (rule.name.empty() && !rule.is_prefix) {
+        throw std::runtime_error("Invalid thread policy rule \"" + text + "\": no thread name");
+    }
+
+    std::istringstream settings(text.substr(eq + 1));
+    for (std::string setting; settings >> setting;) {
+        const size_t colon = setting.find(':');
+        const std::string key = setting.substr(0, colon);
+        const std::string value = colon == std::string::npos ? "" : setting.substr(colon + 1);
+
+        if (key == "cpus") {
+            rule.cpus = ParseCpus(value, setting);
+        } else if (key == "fifo" || key == "rr") {
+            rule.sched_policy = key == "fifo" ? SCHED_FIFO : SCHED_RR;
+            rule.sched_priority = ParseInt(value, 1, 99, setting);
+        } else if (key == "other" && value.empty()) {
+            rule.sched_policy = SCHED_OTHER;
+            rule.sched_priority = 0;
+        } else if (key == "nice") {
+            rule.nice = ParseInt(value, -20, 19, setting);
+        } else {
+            throw std::runtime_error("Unknown thread policy setting \"" + setting + "\"");
+        }
+    }
+    return rule;
+}
+
+const Rule *FindRule(const std::string &thread_name) {
+    for (const auto &rule : g_rules) {
+        if (rule.is_prefix ? thread_name.rfind(rule.name, 0) == 0 : thread_name == rule.name) {
+            return &rule;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+void Configure(const std::string &rules) {
+    std::vector<Rule> parsed;
+    std::istringstream list(rules);
+    for (std::string text; std::getline(list, text, ';');) {
+        if (!Trim(text).empty()) {
+            parsed.push_back(ParseRule(text));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_rules = std::move(parsed);
+}
+
+bool Matches(const std::string &thread_name) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return FindRule(thread_name) != nullptr;
+}
+
+void Apply(const std::string &thread_name) {
+    Rule rule;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        const Rule *found = FindRule(thread_name);
+        if (!found) {
+            return;
+        }
+        rule = *found;
+    }
+
+    if (!rule.cpus.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : rule.cpus) {
+            CPU_SET(cpu, &cpu_set);
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+            ERROR_PRINT("Unable to set the cpu affinity of '%s'.", thread_name.c_str());
+        }
+    }
+
+    if (rule.sched_policy) {
+        sched_param param = {};
+        param.sched_priority = rule.sched_priority;
+        const int err = pthread_setschedparam(pthread_self(), *rule.sched_policy, &param);
+        if (err != 0) {
+            // Real-time policies need CAP_SYS_NICE or a matching RLIMIT_RTPRIO.
+            ERROR_PRINT("Unable to set the scheduling policy of '%s': %s", thread_name.c_str(),
+                        strerror(err));
+        }
+    }
+
+    // Linux keeps a nice value per thread, addressed by its tid.
+    if (rule.nice && setpriority(PRIO_PROCESS, syscall(SYS_gettid), *rule.nice) != 0) {
+        ERROR_PRINT("Unable to set the nice value of '%s': %s", thread_name.c_str(),
+                    strerror(errno));
+    }
+
+    DEBUG_PRINT("Applied thread policy to '%s'.", thread_name.c_str());
+}
+
+void ApplyOnce(const std::string &thread_name) {
+    thread_local bool applied = false;
+    if (applied) {
+        return;
+    }
+    applied = true;
+    Apply(thread_name);
+}
+
+} // namespace thread_policy
@@ -0,0 +1,36 @@
+#ifndef COMMON_THREAD_POLICY_H_
+#define COMMON_THREAD_POLICY_H_
+
+#include <string>
+
+// Per-thread cpu affinity and scheduling, looked up by thread name. Rules come from
+// --thread-policy as `<name>=<setting> [<setting>...]`, separated by `;`:
+//
+//   V4L2 Capturer=cpus:3 fifo:50; event loop*=cpus:3 fifo:45; webrtc network=cpus:0,1 nice:5
+//
+// A name ending in `*` matches any thread whose name starts with the rest, and the first rule
+// that matches wins. Settings are
+//   cpus:<list>   affinity, e.g. `cpus:2,3` or `cpus:1-3`
+//   fifo:<1-99>   SCHED_FIFO at that priority
+//   rr:<1-99>     SCHED_RR at that priority
+//   other         SCHED_OTHER, e.g. to take a Worker back down from its default high priority
+//   nice:<n>      nice value from -20 to 19, for SCHED_OTHER threads
+// Threads without a matching rule keep whatever they were started with.
+namespace thread_policy {
+
+// Throws std::runtime_error naming the offending part when `rules` does not parse.
+void Configure(const std::string &rules);
+
+// Whether any rule would apply to `thread_name`.
+bool Matches(const std::string &thread_name);
+
+// Applies the matching rule, if any, to the calling thread.
+void Apply(const std::string &thread_name);
+
+// Same as Apply, for threads owned by a library that hands out callbacks on them: it only acts
+// the first time a given thread calls it.
+void ApplyOnce(const std::string &thread_name);
+
+} // namespace thread_policy
+
+#endif // COMMON_THREAD_POLICY_H_
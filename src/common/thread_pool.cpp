@@ -0,0 +1,122 @@
+#include "common/thread_pool.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "common/logging.h"
+#include "common/thread_policy.h"
+
+namespace {
+
+std::mutex config_mtx;
+int configured_thread_count = -1;
+
+} // namespace
+
+void ThreadPool::Configure(int thread_count) {
+    std::lock_guard<std::mutex> lock(config_mtx);
+    configured_thread_count = thread_count;
+}
+
+ThreadPool &ThreadPool::Shared() {
+    // Never destroyed, so a stage still running at exit does not find its threads gone.
+    static ThreadPool *pool = []() {
+        std::lock_guard<std::mutex> lock(config_mtx);
+        if (configured_thread_count >= 0) {
+            return new ThreadPool(configured_thread_count);
+        }
+        const int cores = static_cast<int>(std::thread::hardware_concurrency());
+        return new ThreadPool(std::max(cores - 1, 0));
+    }();
+    return *pool;
+}
+
+ThreadPool::ThreadPool(int thread_count)
+    : abort_(false) {
+    for (int i = 0; i < thread_count; i++) {
+        const std::string name = "thread pool " + std::to_string(i);
+        threads_.push_back(webrtc::PlatformThread::SpawnJoinable(
+            [this, name]() {
+                this->Thread(name);
+            },
+            name, webrtc::ThreadAttributes().SetPriority(webrtc::ThreadPriority::kHigh)));
+    }
+    DEBUG_PRINT("Thread pool is running on %d thread(s).", thread_count);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        abort_ = true;
+    }
+    work_cond_.notify_all();
+    for (auto &thread : threads_) {
+        thread.Finalize();
+    }
+}
+
+int ThreadPool::concurrency() const { return static_cast<int>(threads_.size()) + 1; }
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)> &task) {
+    if (count <= 1 || threads_.empty()) {
+        for (int i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->task = &task;
+    job->count = count;
+    job->next = 0;
+    job->done = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        jobs_.push_back(job);
+    }
+    work_cond_.notify_all();
+
+    Work(*job);
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_cond_.wait(lock, [&job]() {
+        return job->done == job->count;
+    });
+    jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+}
+
+void ThreadPool::Thread(const std::string &name) {
+    thread_policy::Apply(name);
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            work_cond_.wait(lock, [this]() {
+                return abort_ || !jobs_.empty();
+            });
+            if (abort_) {
+                return;
+            }
+            job = jobs_.front();
+            if (job->next.load(std::memory_order_relaxed) >= job->count) {
+                // Every stripe is claimed; whoever holds them finishes the job.
+                jobs_.pop_front();
+                continue;
+            }
+        }
+        Work(*job);
+    }
+}
+
+void ThreadPool::Work(Job &job) {
+    // The task is only touched for a stripe this thread claimed, which keeps its caller waiting,
+    // so a job found after its caller has returned is never dereferenced.
+    for (int i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+        (*job.task)(i);
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (++job.done == job.count) {
+            done_cond_.notify_all();
+        }
+    }
+}
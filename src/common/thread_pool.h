@@ -0,0 +1,60 @@
+#ifndef COMMON_THREAD_POOL_H_
+#define COMMON_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rtc_base/platform_thread.h>
+
+// A few persistent threads that split one frame's work into stripes, for the software stages
+// that would otherwise run a whole frame on the capture thread. ParallelFor() is a barrier: the
+// caller works through stripes alongside the pool and returns once every stripe has finished, so
+// a stripe may write straight into the caller's buffers.
+//
+// Several callers may share the pool. Their jobs are served in order, and each caller keeps
+// working on its own job, so one never waits for another caller's stripes to finish its own.
+class ThreadPool {
+  public:
+    // Sets the size of the pool returned by Shared(). Only the first call to Shared() reads it.
+    // A negative count leaves one thread per core besides the caller's, 0 keeps all the work on
+    // the caller.
+    static void Configure(int thread_count);
+    // The process-wide pool.
+    static ThreadPool &Shared();
+
+    explicit ThreadPool(int thread_count);
+    ~ThreadPool();
+
+    // Threads taking part in a ParallelFor(), counting the caller.
+    int concurrency() const;
+
+    // Runs `task(0)` ... `task(count - 1)`, each exactly once and in no particular order.
+    void ParallelFor(int count, const std::function<void(int)> &task);
+
+  private:
+    struct Job {
+        const std::function<void(int)> *task;
+        int count;
+        std::atomic<int> next;
+        int done;
+    };
+
+    bool abort_;
+    std::mutex mtx_;
+    std::condition_variable work_cond_;
+    std::condition_variable done_cond_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<webrtc::PlatformThread> threads_;
+
+    void Thread(const std::string &name);
+    // Runs stripes of `job` until none are left to claim.
+    void Work(Job &job);
+};
+
+#endif // COMMON_THREAD_POOL_H_
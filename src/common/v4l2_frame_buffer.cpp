@@ -7,14 +7,12 @@
 #include <nvbufsurface.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 
 namespace {
 
-// Aligning pointer to 64 bytes for improved performance, e.g. use SIMD.
-const int kBufferAlignment = 64;
-
 #if defined(USE_LIBARGUS_CAPTURE)
 
 int ReadDmaBuffer(int src_dma_fd, uint8_t *dst_addr, size_t dst_size) {
@@ -111,6 +109,12 @@ webrtc::scoped_refptr<V4L2FrameBuffer> V4L2FrameBuffer::Create(int width, int he
     return webrtc::make_ref_counted<V4L2FrameBuffer>(width, height, buffer);
 }
 
+webrtc::scoped_refptr<V4L2FrameBuffer> V4L2FrameBuffer::Create(int width, int height,
+                                                               V4L2Buffer buffer,
+                                                               std::function<void()> on_release) {
+    return webrtc::make_ref_counted<V4L2FrameBuffer>(width, height, buffer, std::move(on_release));
+}
+
 V4L2FrameBuffer::V4L2FrameBuffer(int width, int height, uint32_t format, int size, uint32_t flags,
                                  timeval timestamp)
     : width_(width),
@@ -128,12 +132,22 @@ V4L2FrameBuffer::V4L2FrameBuffer(int width, int height, V4L2Buffer buffer)
     buffer_ = buffer;
 }
 
+V4L2FrameBuffer::V4L2FrameBuffer(int width, int height, V4L2Buffer buffer,
+                                 std::function<void()> on_release)
+    : V4L2FrameBuffer(width, height, buffer) {
+    on_release_ = std::move(on_release);
+}
+
 V4L2FrameBuffer::V4L2FrameBuffer(int width, int height, int size, uint32_t format)
     : V4L2FrameBuffer(width, height, format, size, 0, {0, 0}) {
-    data_.reset(static_cast<uint8_t *>(webrtc::AlignedMalloc(size_, kBufferAlignment)));
+    data_ = FrameBufferPool::Shared().Acquire(size_);
 }
 
-V4L2FrameBuffer::~V4L2FrameBuffer() {}
+V4L2FrameBuffer::~V4L2FrameBuffer() {
+    if (on_release_) {
+        on_release_();
+    }
+}
 
 webrtc::VideoFrameBuffer::Type V4L2FrameBuffer::type() const { return Type::kNative; }
 
@@ -145,19 +159,38 @@ uint32_t V4L2FrameBuffer::flags() const { return flags_; }
 timeval V4L2FrameBuffer::timestamp() const { return timestamp_; }
 
 webrtc::scoped_refptr<webrtc::I420BufferInterface> V4L2FrameBuffer::ToI420() {
+    // The view holds this frame, so it is not cached here: that would be a reference cycle.
+    if (format_ == V4L2_PIX_FMT_YUV420 && IsMappable()) {
+        return V4L2I420Buffer::Create(webrtc::scoped_refptr<V4L2FrameBuffer>(this));
+    }
+
+    std::call_once(i420_once_, [this]() {
+        i420_buffer_ = ConvertToI420();
+    });
+    return i420_buffer_;
+}
+
+// A successful conversion writes every pixel, so the buffer is only zero-filled when one fails or
+// the frame is short: it is cached and fanned out, and must never carry stale heap memory.
+webrtc::scoped_refptr<webrtc::I420BufferInterface> V4L2FrameBuffer::ConvertToI420() {
     webrtc::scoped_refptr<webrtc::I420Buffer> i420_buffer(
         webrtc::I420Buffer::Create(width_, height_));
-    i420_buffer->InitializeData();
 
     const uint8_t *src = static_cast<const uint8_t *>(Data());
 
     if (format_ == V4L2_PIX_FMT_YUV420) {
-        memcpy(i420_buffer->MutableDataY(), src, size_);
+        const uint32_t i420_size = width_ * height_ + 2 * ((width_ + 1) / 2) * ((height_ + 1) / 2);
+        if (size_ < i420_size) {
+            ERROR_PRINT("I420 frame is %u bytes, expected %u", size_, i420_size);
+            i420_buffer->InitializeData();
+        }
+        memcpy(i420_buffer->MutableDataY(), src, std::min(size_, i420_size));
     } else {
 #if defined(USE_LIBARGUS_CAPTURE)
         if (NvConvertToI420(buffer_.dmafd, i420_buffer->MutableDataY(), size_, width_, height_) <
             0) {
             ERROR_PRINT("NvConvertToI420 Failed");
+            i420_buffer->InitializeData();
         }
 #else
         if (libyuv::ConvertToI420(src, size_, i420_buffer->MutableDataY(), i420_buffer->StrideY(),
@@ -165,6 +198,7 @@ webrtc::scoped_refptr<webrtc::I420BufferInterface> V4L2FrameBuffer::ToI420() {
                                   i420_buffer->MutableDataV(), i420_buffer->StrideV(), 0, 0, width_,
                                   height_, width_, height_, libyuv::kRotate0, format_) < 0) {
             ERROR_PRINT("libyuv ConvertToI420 Failed");
+            i420_buffer->InitializeData();
         }
 #endif
     }
@@ -172,12 +206,37 @@ webrtc::scoped_refptr<webrtc::I420BufferInterface> V4L2FrameBuffer::ToI420() {
     return i420_buffer;
 }
 
+webrtc::scoped_refptr<webrtc::VideoFrameBuffer>
+V4L2FrameBuffer::GetMappedFrameBuffer(webrtc::ArrayView<Type> types) {
+    if (!IsMappable()) {
+        return nullptr;
+    }
+
+    for (Type type : types) {
+        if (type == Type::kI420 && format_ == V4L2_PIX_FMT_YUV420) {
+            return V4L2I420Buffer::Create(webrtc::scoped_refptr<V4L2FrameBuffer>(this));
+        }
+        if (type == Type::kNV12 && format_ == V4L2_PIX_FMT_NV12) {
+            return V4L2NV12Buffer::Create(webrtc::scoped_refptr<V4L2FrameBuffer>(this));
+        }
+    }
+    return nullptr;
+}
+
+// A view may outlive the capture callback, e.g. in an encoder queue, so only a frame whose
+// memory stays put for as long as it is referenced can be mapped.
+bool V4L2FrameBuffer::IsMappable() const { return Data() != nullptr && IsRetainable(); }
+
 V4L2Buffer V4L2FrameBuffer::GetRawBuffer() { return buffer_; }
 
 const void *V4L2FrameBuffer::Data() const { return data_ ? data_.get() : buffer_.start; }
 
 bool V4L2FrameBuffer::IsDmaOnly() const { return Data() == nullptr && buffer_.dmafd > 0; }
 
+bool V4L2FrameBuffer::IsRetainable() const {
+    return data_ != nullptr || on_release_ != nullptr || IsDmaOnly();
+}
+
 uint8_t *V4L2FrameBuffer::MutableData() {
     if (!data_) {
         throw std::runtime_error(
@@ -208,3 +267,42 @@ webrtc::scoped_refptr<V4L2FrameBuffer> V4L2FrameBuffer::Clone() const {
 
     return clone;
 }
+
+webrtc::scoped_refptr<V4L2I420Buffer> V4L2I420Buffer::Create(V4L2FrameBufferRef frame_buffer) {
+    return webrtc::make_ref_counted<V4L2I420Buffer>(std::move(frame_buffer));
+}
+
+V4L2I420Buffer::V4L2I420Buffer(V4L2FrameBufferRef frame_buffer)
+    : frame_buffer_(std::move(frame_buffer)),
+      data_(static_cast<const uint8_t *>(frame_buffer_->Data())) {}
+
+int V4L2I420Buffer::width() const { return frame_buffer_->width(); }
+int V4L2I420Buffer::height() const { return frame_buffer_->height(); }
+int V4L2I420Buffer::StrideY() const { return width(); }
+int V4L2I420Buffer::StrideU() const { return (width() + 1) / 2; }
+int V4L2I420Buffer::StrideV() const { return (width() + 1) / 2; }
+const uint8_t *V4L2I420Buffer::DataY() const { return data_; }
+const uint8_t *V4L2I420Buffer::DataU() const { return data_ + StrideY() * height(); }
+const uint8_t *V4L2I420Buffer::DataV() const {
+    return DataU() + StrideU() * ((height() + 1) / 2);
+}
+
+webrtc::scoped_refptr<V4L2NV12Buffer> V4L2NV12Buffer::Create(V4L2FrameBufferRef frame_buffer) {
+    return webrtc::make_ref_counted<V4L2NV12Buffer>(std::move(frame_buffer));
+}
+
+V4L2NV12Buffer::V4L2NV12Buffer(V4L2FrameBufferRef frame_buffer)
+    : frame_buffer_(std::move(frame_buffer)),
+      data_(static_cast<const uint8_t *>(frame_buffer_->Data())) {}
+
+int V4L2NV12Buffer::width() const { return frame_buffer_->width(); }
+int V4L2NV12Buffer::height() const { return frame_buffer_->height(); }
+int V4L2NV12Buffer::StrideY() const { return width(); }
+int V4L2NV12Buffer::StrideUV() const { return ((width() + 1) / 2) * 2; }
+const uint8_t *V4L2NV12Buffer::DataY() const { return data_; }
+const uint8_t *V4L2NV12Buffer::DataUV() const { return data_ + StrideY() * height(); }
+
+webrtc::scoped_refptr<webrtc::I420BufferInterface> V4L2NV12Buffer::ToI420() {
+    // The frame converts, and caches, from the same memory this view points into.
+    return frame_buffer_->ToI420();
+}
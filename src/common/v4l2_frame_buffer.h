@@ -1,27 +1,39 @@
 #ifndef COMMON_V4L2_FRAME_BUFFER_H_
 #define COMMON_V4L2_FRAME_BUFFER_H_
 
+#include "common/frame_buffer_pool.h"
 #include "common/v4l2_utils.h"
 
 #include <cstdint>
+#include <functional>
 #include <linux/videodev2.h>
+#include <mutex>
 #include <vector>
 
 #include <api/video/i420_buffer.h>
 #include <api/video/video_frame.h>
 #include <common_video/include/video_frame_buffer.h>
-#include <rtc_base/memory/aligned_malloc.h>
 
 class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
   public:
     static webrtc::scoped_refptr<V4L2FrameBuffer> Create(int width, int height, int size,
                                                          uint32_t format);
     static webrtc::scoped_refptr<V4L2FrameBuffer> Create(int width, int height, V4L2Buffer buffer);
+    // Wraps a buffer that is only lent out: `on_release` runs once the last reference is gone, and
+    // not before, so the memory stays valid for as long as any consumer holds the frame.
+    static webrtc::scoped_refptr<V4L2FrameBuffer> Create(int width, int height, V4L2Buffer buffer,
+                                                         std::function<void()> on_release);
 
     Type type() const override;
     int width() const override;
     int height() const override;
+    // Converted on the first call and shared with every later caller, so a frame fanned out to
+    // several consumers is converted once. Callers must treat the result as read-only.
     webrtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+    // Software encoders ask for this before falling back to ToI420(). A retainable I420 or NV12
+    // frame is handed over as a view of its own memory, without a conversion or a copy.
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer>
+    GetMappedFrameBuffer(webrtc::ArrayView<Type> types) override;
 
     uint32_t format() const;
     uint32_t size() const;
@@ -30,6 +42,9 @@ class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
 
     const void *Data() const;
     bool IsDmaOnly() const;
+    // True when the frame stays valid after the capture callback returns, so a consumer may keep
+    // the reference instead of taking a Clone().
+    bool IsRetainable() const;
     uint8_t *MutableData();
     V4L2Buffer GetRawBuffer();
     int GetDmaFd() const;
@@ -40,6 +55,7 @@ class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
   protected:
     V4L2FrameBuffer(int width, int height, int size, uint32_t format);
     V4L2FrameBuffer(int width, int height, V4L2Buffer buffer);
+    V4L2FrameBuffer(int width, int height, V4L2Buffer buffer, std::function<void()> on_release);
     ~V4L2FrameBuffer() override;
 
   private:
@@ -50,12 +66,62 @@ class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
     uint32_t flags_;
     timeval timestamp_;
     V4L2Buffer buffer_;
-    std::unique_ptr<uint8_t, webrtc::AlignedFreeDeleter> data_;
+    FrameBufferPool::Buffer data_;
+    std::function<void()> on_release_;
+    std::once_flag i420_once_;
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> i420_buffer_;
 
     V4L2FrameBuffer(int width, int height, uint32_t format, int size, uint32_t flags,
                     timeval timestamp);
+    bool IsMappable() const;
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> ConvertToI420();
 };
 
 using V4L2FrameBufferRef = webrtc::scoped_refptr<V4L2FrameBuffer>;
 
+// Zero-copy planar views of a V4L2FrameBuffer. Each holds a reference on the frame, so the
+// memory it points into stays valid for as long as the view is alive.
+class V4L2I420Buffer : public webrtc::I420BufferInterface {
+  public:
+    static webrtc::scoped_refptr<V4L2I420Buffer> Create(V4L2FrameBufferRef frame_buffer);
+
+    int width() const override;
+    int height() const override;
+    const uint8_t *DataY() const override;
+    const uint8_t *DataU() const override;
+    const uint8_t *DataV() const override;
+    int StrideY() const override;
+    int StrideU() const override;
+    int StrideV() const override;
+
+  protected:
+    explicit V4L2I420Buffer(V4L2FrameBufferRef frame_buffer);
+    ~V4L2I420Buffer() override = default;
+
+  private:
+    const V4L2FrameBufferRef frame_buffer_;
+    const uint8_t *const data_;
+};
+
+class V4L2NV12Buffer : public webrtc::NV12BufferInterface {
+  public:
+    static webrtc::scoped_refptr<V4L2NV12Buffer> Create(V4L2FrameBufferRef frame_buffer);
+
+    int width() const override;
+    int height() const override;
+    const uint8_t *DataY() const override;
+    const uint8_t *DataUV() const override;
+    int StrideY() const override;
+    int StrideUV() const override;
+    webrtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+
+  protected:
+    explicit V4L2NV12Buffer(V4L2FrameBufferRef frame_buffer);
+    ~V4L2NV12Buffer() override = default;
+
+  private:
+    const V4L2FrameBufferRef frame_buffer_;
+    const uint8_t *const data_;
+};
+
 #endif // COMMON_V4L2_FRAME_BUFFER_H_
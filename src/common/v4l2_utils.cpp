@@ -52,8 +52,8 @@ void UnMap(V4L2BufferGroup *gbuffer) {
     }
 }
 
-bool MMap(int fd, V4L2BufferGroup *gbuffer) {
-    for (int i = 0; i < gbuffer->num_buffers; i++) {
+bool MMap(int fd, V4L2BufferGroup *gbuffer, int first_index) {
+    for (int i = first_index; i < gbuffer->num_buffers; i++) {
         V4L2Buffer *buffer = &gbuffer->buffers[i];
         v4l2_buffer *inner = &buffer->inner;
         inner->type = gbuffer->type;
@@ -105,6 +105,24 @@ bool MMap(int fd, V4L2BufferGroup *gbuffer) {
     return true;
 }
 
+bool SetupBuffers(int fd, V4L2BufferGroup *gbuffer, int first_index) {
+    if (gbuffer->memory == V4L2_MEMORY_MMAP) {
+        return MMap(fd, gbuffer, first_index);
+    } else if (gbuffer->memory == V4L2_MEMORY_DMABUF) {
+        for (int i = first_index; i < gbuffer->num_buffers; i++) {
+            V4L2Buffer *buffer = &gbuffer->buffers[i];
+            v4l2_buffer *inner = &buffer->inner;
+            inner->type = gbuffer->type;
+            inner->memory = V4L2_MEMORY_DMABUF;
+            inner->index = i;
+            inner->length = 1;
+            inner->m.planes = buffer->plane;
+        }
+    }
+
+    return true;
+}
+
 } // namespace
 
 int OpenDevice(const char *file) {
@@ -296,21 +314,43 @@ bool AllocateBuffer(int fd, V4L2BufferGroup *gbuffer, int num_buffers) {
         return false;
     }
 
-    if (gbuffer->memory == V4L2_MEMORY_MMAP) {
-        return MMap(fd, gbuffer);
-    } else if (gbuffer->memory == V4L2_MEMORY_DMABUF) {
-        for (int i = 0; i < num_buffers; i++) {
-            V4L2Buffer *buffer = &gbuffer->buffers[i];
-            v4l2_buffer *inner = &buffer->inner;
-            inner->type = gbuffer->type;
-            inner->memory = V4L2_MEMORY_DMABUF;
-            inner->index = i;
-            inner->length = 1;
-            inner->m.planes = buffer->plane;
+    return SetupBuffers(fd, gbuffer, 0);
+}
+
+bool CreateBuffers(int fd, V4L2BufferGroup *gbuffer, int num_buffers) {
+    v4l2_create_buffers create = {};
+    create.count = num_buffers;
+    create.memory = gbuffer->memory;
+    create.format.type = gbuffer->type;
+
+    if (ioctl(fd, VIDIOC_G_FMT, &create.format) < 0) {
+        ERROR_PRINT("fd(%d) get format: %s", fd, strerror(errno));
+        return false;
+    }
+
+    if (ioctl(fd, VIDIOC_CREATE_BUFS, &create) < 0) {
+        ERROR_PRINT("fd(%d) create buffers: %s", fd, strerror(errno));
+        return false;
+    }
+
+    if (create.count == 0) {
+        DEBUG_PRINT("fd(%d) driver has no more buffers to give", fd);
+        return false;
+    }
+
+    const int first_index = create.index;
+    gbuffer->num_buffers = first_index + create.count;
+    gbuffer->buffers.resize(gbuffer->num_buffers);
+
+    // The resize may have moved the existing entries, and their plane arrays along with them.
+    if (gbuffer->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE ||
+        gbuffer->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+        for (int i = 0; i < first_index; i++) {
+            gbuffer->buffers[i].inner.m.planes = gbuffer->buffers[i].plane;
         }
     }
 
-    return true;
+    return SetupBuffers(fd, gbuffer, first_index);
 }
 
 bool DeallocateBuffer(int fd, V4L2BufferGroup *gbuffer) {
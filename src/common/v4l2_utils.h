@@ -73,6 +73,8 @@ bool SetExtCtrl(int fd, uint32_t id, int32_t value);
 bool StreamOn(int fd, v4l2_buf_type type);
 bool StreamOff(int fd, v4l2_buf_type type);
 bool AllocateBuffer(int fd, V4L2BufferGroup *gbuffer, int num_buffers);
+// Adds buffers to an allocated group, also while streaming. The new ones are not queued.
+bool CreateBuffers(int fd, V4L2BufferGroup *gbuffer, int num_buffers);
 bool DeallocateBuffer(int fd, V4L2BufferGroup *gbuffer);
 
 } // namespace v4l2_util
@@ -1,5 +1,6 @@
 #include "common/worker.h"
 #include "common/logging.h"
+#include "common/thread_policy.h"
 
 Worker::Worker(std::string name, std::function<void()> executing_function)
     : abort_(false),
@@ -15,6 +16,7 @@ Worker::~Worker() {
 void Worker::Run() {
     thread_ = webrtc::PlatformThread::SpawnJoinable(
         [this]() {
+            thread_policy::Apply(name_);
             this->Thread();
         },
         name_, webrtc::ThreadAttributes().SetPriority(webrtc::ThreadPriority::kHigh));
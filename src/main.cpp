@@ -1,9 +1,13 @@
 #include "args.h"
+#include "common/event_loop.h"
 #include "common/latency_tracer.h"
 #include "common/logging.h"
+#include "common/thread_pool.h"
 #include "common/utils.h"
 #include "parser.h"
 #include "recorder/recorder_manager.h"
+#include "recorder/shared_aac_encoder.h"
+#include "recorder/shared_h264_encoder.h"
 #include "rtc/conductor.h"
 #include "signaling/cloudflare_service.h"
 #include "signaling/livekit_service.h"
@@ -21,31 +25,68 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    EventLoop::Configure(args.event_threads, args.event_cpu_ids);
+    ThreadPool::Configure(args.pool_threads);
+
     if (args.latency_trace) {
         latency::Start(args.latency_trace_interval);
     }
 
     std::shared_ptr<Conductor> conductor = Conductor::Create(args);
-    std::unique_ptr<RecorderManager> bg_recorder_mgr;
-    std::shared_ptr<RecorderManager> ondemand_recorder_mgr;
-
-    // Background recorder
-    if ((args.record_mode == RecordMode::Background || args.record_mode == -1) &&
-        utils::CreateFolder(args.record_path)) {
-        bg_recorder_mgr =
-            RecorderManager::Create(conductor->VideoSource(), conductor->AudioSource(), args);
-        DEBUG_PRINT("Background recorder is running!");
+    std::vector<std::unique_ptr<RecorderManager>> bg_recorder_mgrs;
+    std::vector<std::shared_ptr<RecorderManager>> ondemand_recorder_mgrs;
+
+    // Recorders running side by side mux one encode rather than each encoding the same frames:
+    // both recorders of a camera share its H.264, and every recorder shares the AAC.
+    int recorder_count = 0;
+    for (int i = 0; i < conductor->CameraCount(); i++) {
+        const Args camera_args = conductor->CameraConfig(i);
+        if (camera_args.record) {
+            recorder_count += camera_args.record_mode == -1 ? 2 : 1;
+        }
     }
+    std::shared_ptr<SharedAacEncoder> shared_aac;
+    if (recorder_count > 1 && conductor->AudioSource()) {
+        shared_aac = SharedAacEncoder::Create(conductor->AudioSource());
+    }
+
+    for (int i = 0; i < conductor->CameraCount(); i++) {
+        Args camera_args = conductor->CameraConfig(i);
+        if (!camera_args.record) {
+            continue;
+        }
+
+        std::shared_ptr<EncodedSource> shared_video = conductor->EncodedVideoSource(i);
+        bool share_video = camera_args.record_mode == -1 && conductor->VideoSource(i);
+#if defined(USE_JETSON_HW_ENCODER)
+        // The shared encode would be OpenH264, dearer than two hardware ones.
+        share_video = share_video && !camera_args.hw_accel;
+#endif
+        if (!shared_video && share_video) {
+            shared_video = SharedH264Encoder::Create(conductor->VideoSource(i), camera_args);
+        }
+
+        // Background recorder
+        if ((camera_args.record_mode == RecordMode::Background || camera_args.record_mode == -1) &&
+            utils::CreateFolder(camera_args.record_path)) {
+            bg_recorder_mgrs.push_back(
+                RecorderManager::Create(conductor->VideoSource(i), conductor->AudioSource(),
+                                        camera_args, true, shared_video, shared_aac));
+            DEBUG_PRINT("Background recorder is running!");
+        }
 
-    // On-demand recorder
-    if (args.record_mode == RecordMode::OnDemand || args.record_mode == -1) {
-        Args ondemand_args = args;
-        ondemand_args.record_path = args.record_ondemand_path;
-        if (utils::CreateFolder(ondemand_args.record_path)) {
-            ondemand_recorder_mgr = RecorderManager::Create(
-                conductor->VideoSource(), conductor->AudioSource(), ondemand_args, false);
-            conductor->SetOnDemandRecorder(ondemand_recorder_mgr);
-            DEBUG_PRINT("On-demand recorder is ready.");
+        // On-demand recorder
+        if (camera_args.record_mode == RecordMode::OnDemand || camera_args.record_mode == -1) {
+            Args ondemand_args = camera_args;
+            ondemand_args.record_path = camera_args.record_ondemand_path;
+            if (utils::CreateFolder(ondemand_args.record_path)) {
+                std::shared_ptr<RecorderManager> ondemand_recorder_mgr = RecorderManager::Create(
+                    conductor->VideoSource(i), conductor->AudioSource(), ondemand_args, false,
+                    shared_video, shared_aac);
+                conductor->AddOnDemandRecorder(ondemand_recorder_mgr);
+                ondemand_recorder_mgrs.push_back(std::move(ondemand_recorder_mgr));
+                DEBUG_PRINT("On-demand recorder is ready.");
+            }
         }
     }
 
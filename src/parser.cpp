@@ -1,5 +1,7 @@
 #include "parser.h"
+#include "common/frame_mailbox.h"
 #include "common/logging.h"
+#include "common/thread_policy.h"
 #include "recorder/recorder_manager.h"
 #include "rtc/rtc_peer.h"
 
@@ -40,6 +42,16 @@ static const std::unordered_map<std::string, int> stream_source_table = {
     {"sub", 1},
 };
 
+static const std::unordered_map<std::string, int> replay_pacing_table = {
+    {"realtime", 1},
+    {"none", 0},
+};
+
+static const std::unordered_map<std::string, int> broadcast_bitrate_table = {
+    {"lowest", static_cast<int>(BroadcastBitrate::Lowest)},
+    {"highest", static_cast<int>(BroadcastBitrate::Highest)},
+};
+
 static const std::unordered_map<std::string, int> ipc_mode_table = {
     {"both", -1},
     {"lossy", ChannelMode::Lossy},
@@ -102,7 +114,59 @@ inline int ParseEnum(const std::unordered_map<std::string, int> table, const std
     return it->second;
 }
 
+// Options that set up the process rather than one camera: the threads, the peer connection
+// factory and the encoders it shares. Only the global value is ever applied, so a `cameras:`
+// entry may repeat it but not change it.
+static void CheckProcessWide(const Args &args, const Args &camera_args) {
+    auto check = [&camera_args](bool same, const std::string &option) {
+        if (!same) {
+            throw std::runtime_error("--" + option + " applies to every camera and cannot be " +
+                                     "set differently for camera " + camera_args.alias);
+        }
+    };
+    check(camera_args.hw_accel == args.hw_accel, "hw-accel");
+    check(camera_args.thread_policy == args.thread_policy, "thread-policy");
+    check(camera_args.event_threads == args.event_threads, "event-threads");
+    check(camera_args.event_cpus == args.event_cpus, "event-cpus");
+    check(camera_args.pool_threads == args.pool_threads, "pool-threads");
+    check(camera_args.shared_encoder == args.shared_encoder, "shared-encoder");
+    check(camera_args.simulcast == args.simulcast, "simulcast");
+    check(camera_args.broadcast_encoder == args.broadcast_encoder, "broadcast-encoder");
+    check(camera_args.broadcast_bitrate_str == args.broadcast_bitrate_str, "broadcast-bitrate");
+}
+
 void Parser::ParseArgs(int argc, char *argv[], Args &args) {
+    const int camera_count = ParseArgs(argc, argv, args, -1);
+
+    for (int i = 0; i < camera_count; i++) {
+        Args camera_args;
+        ParseArgs(argc, argv, camera_args, i);
+        CheckProcessWide(args, camera_args);
+        for (const auto &other : args.cameras) {
+            if (other.alias == camera_args.alias) {
+                throw std::runtime_error("Duplicate camera alias: " + camera_args.alias);
+            }
+        }
+        args.cameras.push_back(std::move(camera_args));
+    }
+
+    // A broadcast share is keyed on codec and resolution, not on the camera, so two cameras of
+    // the same size would feed one encoder and interleave their frames.
+    if (args.broadcast_encoder) {
+        int streamed = 0;
+        for (const auto &camera : args.cameras) {
+            if (!camera.camera.empty() && camera.webrtc) {
+                streamed++;
+            }
+        }
+        if (streamed > 1) {
+            throw std::runtime_error("--broadcast-encoder supports a single camera with webrtc "
+                                     "enabled, but " + std::to_string(streamed) + " have it");
+        }
+    }
+}
+
+int Parser::ParseArgs(int argc, char *argv[], Args &args, int camera_idx) {
     bpo::options_description opts("Options");
 
     // clang-format off
@@ -110,9 +174,32 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         ("help,h", "Display the help message")
         ("camera", bpo::value<std::string>(&args.camera)->default_value(args.camera),
             "Specify the camera using V4L2 or Libcamera. "
-            "e.g. \"libcamera:0\" for Libcamera, \"v4l2:0\" for V4L2 at `/dev/video0`.")
+            "e.g. \"libcamera:0\" for Libcamera, \"v4l2:0\" for V4L2 at `/dev/video0`. "
+            "\"file:<path>\" replays a .y4m, raw I420 or .h264 file and \"pattern:bars\" or "
+            "\"pattern:noise\" generates frames, both without a camera attached.")
         ("v4l2-format", bpo::value<std::string>(&args.v4l2_format)->default_value(args.v4l2_format),
             "The input format (`i420`, `yuyv`, `mjpeg`, `h264`) of the V4L2 camera.")
+        ("v4l2-deferred-requeue", bpo::bool_switch(&args.v4l2_deferred_requeue)->default_value(args.v4l2_deferred_requeue),
+            "Keep a V4L2 capture buffer out of the driver until the last consumer releases it, "
+            "so the recorder and snapshots read it in place instead of copying every frame. "
+            "Grows the capture buffer count as needed.")
+        ("event-threads", bpo::value<int>(&args.event_threads)->default_value(args.event_threads),
+            "Threads polling every V4L2 camera and codec device from one shared epoll loop. "
+            "0 gives each device its own polling thread instead.")
+        ("event-cpus", bpo::value<std::string>(&args.event_cpus)->default_value(args.event_cpus),
+            "Comma-separated cpus the --event-threads are pinned to, e.g. \"2,3\". "
+            "Empty leaves them to the scheduler.")
+        ("pool-threads", bpo::value<int>(&args.pool_threads)->default_value(args.pool_threads),
+            "Threads that software MJPEG decoding and scaling split each frame across, besides "
+            "the capture thread. -1 uses one per remaining core, 0 keeps the work on the "
+            "capture thread.")
+        ("thread-policy", bpo::value<std::string>(&args.thread_policy)->default_value(args.thread_policy),
+            "Cpu affinity and scheduling per thread name, as `<name>=<settings>` rules separated "
+            "by ';', e.g. \"V4L2 Capturer=cpus:3 fifo:50; webrtc network=cpus:0,1 nice:5\". "
+            "Settings are cpus:<list>, fifo:<1-99>, rr:<1-99>, other and nice:<-20-19>.")
+        ("replay-pacing", bpo::value<std::string>(&args.replay_pacing)->default_value(args.replay_pacing),
+            "How a file or pattern source delivers frames: 'realtime' paces them to --fps, "
+            "'none' delivers them as fast as the pipeline takes them.")
         ("uid", bpo::value<std::string>(&args.uid)->default_value(args.uid),
             "The unique id to identify the device.")
         ("fps", bpo::value<int>(&args.fps)->default_value(args.fps), "Specify the camera frames per second.")
@@ -130,6 +217,15 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         ("webrtc-source", bpo::value<std::string>(&args.webrtc_source)->default_value(args.webrtc_source),
             "Which capture stream WebRTC publishes: 'main' or 'sub'. "
             "'sub' needs --sub-width and --sub-height.")
+        ("async-dispatch", bpo::bool_switch(&args.async_dispatch)->default_value(args.async_dispatch),
+            "Deliver frames to the recorder and each live track from a bounded queue and thread "
+            "of their own, so a slow consumer drops frames instead of stalling the capture.")
+        ("async-queue-depth", bpo::value<int>(&args.async_queue_depth)->default_value(args.async_queue_depth),
+            "Frames each --async-dispatch queue holds. A zero-copy frame keeps its capture buffer "
+            "while queued, so keep this well under the capture buffer count.")
+        ("async-drop-policy", bpo::value<std::string>(&args.async_drop_policy)->default_value(args.async_drop_policy),
+            "What a full --async-dispatch queue gives up: 'drop-oldest', 'drop-newest' or "
+            "'keyframe', which never breaks an H.264 GOP.")
         ("sample-rate", bpo::value<int>(&args.sample_rate)->default_value(args.sample_rate),
             "Set the audio sample rate (in Hz).")
         ("no-audio", bpo::bool_switch(&args.no_audio)->default_value(args.no_audio), "Runs without audio source.")
@@ -184,8 +280,18 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         ("record-ondemand-path", bpo::value<std::string>(&args.record_ondemand_path)->default_value(args.record_ondemand_path),
             "Path for on-demand recordings triggered via DataChannel. "
             "Defaults to ${record-path}/on-demand/ if not set.")
+        ("record-fps", bpo::value<int>(&args.record_fps)->default_value(args.record_fps),
+            "Frames per second the recorder keeps, e.g. 5 for a timelapse-like archive. 0 keeps "
+            "every captured frame. An H.264 camera recorded from the main stream ignores it.")
         ("file-duration", bpo::value<int>(&args.file_duration)->default_value(args.file_duration),
             "The duration (in seconds) of each video file, or the interval between snapshots.")
+        ("shared-encoder", bpo::bool_switch(&args.shared_encoder)->default_value(args.shared_encoder),
+            "Encode each camera to H.264 once, at recording quality, and both record and stream "
+            "that instead of running an encoder for each. WebRTC then offers only H.264.")
+        ("shared-keyframe-interval", bpo::value<int>(&args.shared_keyframe_interval)->default_value(args.shared_keyframe_interval),
+            "Seconds between key frames of a shared H.264 encode, from --shared-encoder or "
+            "--record-mode=both. Video files are only split on a key frame, so this is also how "
+            "far --file-duration may overrun.")
         ("jpeg-quality", bpo::value<int>(&args.jpeg_quality)->default_value(args.jpeg_quality),
             "Set the quality of the snapshot and thumbnail images in range 0 to 100.")
         ("peer-timeout", bpo::value<int>(&args.peer_timeout)->default_value(args.peer_timeout),
@@ -198,6 +304,24 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
             "estimator then has to ramp up from while every frame is squeezed to fit it.")
         ("min-bitrate", bpo::value<int>(&args.min_bitrate)->default_value(args.min_bitrate),
             "Floor (in kbps) for the bandwidth estimate. 0 keeps WebRTC's default.")
+        ("simulcast", bpo::value<std::string>(&args.simulcast)->default_value(args.simulcast),
+            "Send 2 or 3 VP8/H.264 layers to an SFU, as `<scale down>:<max kbps>` per layer from "
+            "the lowest, e.g. \"4:200,2:700,1:2500\". Empty sends one encoding. Software encoding "
+            "only.")
+        ("broadcast-encoder", bpo::bool_switch(&args.broadcast_encoder)->default_value(args.broadcast_encoder),
+            "Encode each camera once per codec and resolution and send the result to every peer, "
+            "instead of running an encoder per peer.")
+        ("broadcast-bitrate", bpo::value<std::string>(&args.broadcast_bitrate_str)->default_value(args.broadcast_bitrate_str),
+            "Rate a shared --broadcast-encoder, or a forwarded H.264 camera, runs at: the `lowest` "
+            "or `highest` of its peers' targets.")
+        ("fast-start", bpo::bool_switch(&args.fast_start)->default_value(args.fast_start),
+            "Send a peer that joins a running --broadcast-encoder or forwarded H.264 stream the "
+            "frames since the last key frame, instead of having it wait for the next one.")
+        ("keyframe-merge-window", bpo::value<int>(&args.keyframe_merge_window)->default_value(args.keyframe_merge_window),
+            "Milliseconds a peer's key frame request waits for others, so that all of them are "
+            "answered by one key frame.")
+        ("min-keyframe-interval", bpo::value<int>(&args.min_keyframe_interval)->default_value(args.min_keyframe_interval),
+            "Minimum milliseconds between a forced key frame and the key frame before it.")
         ("hw-accel", bpo::bool_switch(&args.hw_accel)->default_value(args.hw_accel),
             "Enable hardware acceleration by sharing DMA buffers between the decoder, "
             "scaler, and encoder to reduce CPU usage.")
@@ -256,9 +380,26 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         ("config", bpo::value<std::string>()->default_value(""),
             "Path to a YAML configuration file. All CLI options can be specified as YAML keys. "
             "Command-line arguments take priority over values in the config file.");
+
+    // Only accepted inside an entry of the `cameras:` list.
+    bpo::options_description camera_opts("Camera");
+    camera_opts.add_options()
+        ("alias", bpo::value<std::string>(&args.alias)->default_value(args.alias),
+            "Short name of the camera, used for its recording subdirectory and track id.")
+        ("webrtc", bpo::value<bool>(&args.webrtc)->default_value(args.webrtc),
+            "Whether the camera is published as a WebRTC track.")
+        ("record", bpo::value<bool>(&args.record)->default_value(args.record),
+            "Whether the camera is recorded.");
     // clang-format on
 
+    bpo::options_description file_opts;
+    file_opts.add(opts);
+    if (camera_idx >= 0) {
+        file_opts.add(camera_opts);
+    }
+
     bpo::variables_map vm;
+    int camera_count = 0;
     try {
         // Store CLI arguments first so they take priority over config file values
         bpo::store(bpo::parse_command_line(argc, argv, opts), vm);
@@ -274,17 +415,36 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
             }
             // Convert YAML map to boost config-file (INI-style key=value).
             // bpo::store will not overwrite keys already set by the CLI above.
-            std::istringstream ini;
-            std::string ini_str;
-            for (auto it = yaml.begin(); it != yaml.end(); ++it) {
-                if (it->second.IsScalar()) {
-                    ini_str +=
-                        it->first.as<std::string>() + "=" + it->second.as<std::string>() + "\n";
+            auto store_scalars = [&vm, &file_opts](const YAML::Node &node) {
+                std::istringstream ini;
+                std::string ini_str;
+                for (auto it = node.begin(); it != node.end(); ++it) {
+                    if (it->second.IsScalar()) {
+                        ini_str += it->first.as<std::string>() + "=" +
+                                   it->second.as<std::string>() + "\n";
+                    }
+                }
+                ini.str(ini_str);
+                // allow_unregistered=true so unknown YAML keys don't cause errors
+                bpo::store(bpo::parse_config_file(ini, file_opts, /*allow_unregistered=*/true),
+                           vm);
+            };
+
+            const YAML::Node cameras = yaml["cameras"];
+            if (cameras.IsSequence()) {
+                camera_count = static_cast<int>(cameras.size());
+            }
+            // The camera's own keys are stored first, so they win over the global ones.
+            if (camera_idx >= 0) {
+                const YAML::Node camera = cameras[camera_idx];
+                if (!camera.IsMap()) {
+                    std::cerr << "Entry " << camera_idx << " of `cameras:` in '" << config_path
+                              << "' must be a YAML mapping." << std::endl;
+                    exit(1);
                 }
+                store_scalars(camera);
             }
-            ini.str(ini_str);
-            // allow_unregistered=true so unknown YAML keys don't cause errors
-            bpo::store(bpo::parse_config_file(ini, opts, /*allow_unregistered=*/true), vm);
+            store_scalars(yaml);
         }
 
         bpo::notify(vm);
@@ -296,6 +456,10 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         exit(1);
     }
 
+    if (camera_idx >= 0 && args.alias.empty()) {
+        args.alias = "cam" + std::to_string(camera_idx);
+    }
+
     if (vm.count("help")) {
         std::ostringstream oss;
         oss << opts;
@@ -398,6 +562,9 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         if (args.record_path.back() != '/') {
             args.record_path += '/';
         }
+        if (!args.alias.empty()) {
+            args.record_path += args.alias + '/';
+        }
     }
 
 #if defined(USE_LIBCAMERA_CAPTURE)
@@ -442,6 +609,34 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
 
     args.jpeg_quality = std::clamp(args.jpeg_quality, 0, 100);
     args.latency_trace_interval = std::clamp(args.latency_trace_interval, 1, 3600);
+    args.event_threads = std::clamp(args.event_threads, 0, 8);
+    args.pool_threads = std::clamp(args.pool_threads, -1, 16);
+
+    args.event_cpu_ids.clear();
+    std::istringstream event_cpus(args.event_cpus);
+    for (std::string cpu; std::getline(event_cpus, cpu, ',');) {
+        if (cpu.empty() || cpu.size() > 4 ||
+            cpu.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("Invalid cpu in --event-cpus: \"" + cpu + "\"");
+        }
+        args.event_cpu_ids.push_back(std::stoi(cpu));
+    }
+
+    if (camera_idx < 0) {
+        thread_policy::Configure(args.thread_policy);
+    }
+
+    args.async_queue_depth = std::clamp(args.async_queue_depth, 1, 16);
+    if (args.record_fps < 0 || args.record_fps >= args.fps) {
+        args.record_fps = 0;
+    }
+    args.shared_keyframe_interval = std::clamp(args.shared_keyframe_interval, 1, 60);
+    args.keyframe_merge_window = std::clamp(args.keyframe_merge_window, 0, 1000);
+    args.min_keyframe_interval = std::clamp(args.min_keyframe_interval, 0, 10000);
+    FrameMailbox::DropPolicy drop_policy;
+    if (!FrameMailbox::ParseDropPolicy(args.async_drop_policy, &drop_policy)) {
+        throw std::runtime_error("Invalid --async-drop-policy: " + args.async_drop_policy);
+    }
 
     // BitrateSettings is rejected outright unless 0 <= min <= start <= max, so an inconsistent
     // pair is pulled into range rather than silently disabling every bound.
@@ -453,20 +648,53 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         args.min_bitrate = std::min(args.min_bitrate, args.start_bitrate);
     }
 
+    args.simulcast_layers.clear();
+    std::istringstream simulcast(args.simulcast);
+    for (std::string layer; std::getline(simulcast, layer, ',');) {
+        SimulcastLayer parsed;
+        char colon = 0;
+        std::istringstream fields(layer);
+        if (!(fields >> parsed.scale_down >> colon >> parsed.max_kbps) || colon != ':' ||
+            !fields.eof() || parsed.scale_down < 1.0 || parsed.max_kbps <= 0 ||
+            (!args.simulcast_layers.empty() &&
+             parsed.scale_down >= args.simulcast_layers.back().scale_down)) {
+            throw std::runtime_error("Invalid layer in --simulcast: \"" + layer + "\"");
+        }
+        args.simulcast_layers.push_back(parsed);
+    }
+    if (args.simulcast_layers.size() == 1 || args.simulcast_layers.size() > 3) {
+        throw std::runtime_error("--simulcast takes 2 or 3 layers: " + args.simulcast);
+    }
+    if (!args.simulcast_layers.empty() && args.hw_accel) {
+        INFO_PRINT("--simulcast needs software encoding, sending a single encoding instead.");
+        args.simulcast_layers.clear();
+    }
+
     args.record_type = ParseEnum(record_type_table, args.record_type_str);
     args.ipc_channel_mode = ParseEnum(ipc_mode_table, args.ipc_channel);
+    args.broadcast_bitrate =
+        static_cast<BroadcastBitrate>(ParseEnum(broadcast_bitrate_table, args.broadcast_bitrate_str));
     args.record_mode = ParseEnum(record_mode_table, args.record_mode_str);
 
     // Resolve on-demand path fallback
     if (args.record_mode != RecordMode::Background && args.record_ondemand_path.empty() &&
         !args.record_path.empty()) {
         args.record_ondemand_path = args.record_path + "on-demand/";
+    } else if (!args.record_ondemand_path.empty()) {
+        if (args.record_ondemand_path.back() != '/') {
+            args.record_ondemand_path += '/';
+        }
+        if (!args.alias.empty()) {
+            args.record_ondemand_path += args.alias + '/';
+        }
     }
-    if (!args.record_ondemand_path.empty() && args.record_ondemand_path.back() != '/') {
-        args.record_ondemand_path += '/';
+
+    // With a `cameras:` list the flat camera options only seed its entries.
+    if (camera_idx >= 0 || camera_count == 0) {
+        ParseDevice(args);
     }
 
-    ParseDevice(args);
+    return camera_count;
 }
 
 void Parser::ParseWsUrl(Args &args) {
@@ -549,6 +777,28 @@ void Parser::ParseDevice(Args &args) {
     std::string prefix = args.camera.substr(0, pos);
     std::string id = args.camera.substr(pos + 1);
 
+    if (prefix == "file" || prefix == "pattern") {
+        if (id.empty()) {
+            throw std::runtime_error("Invalid camera string: " + args.camera +
+                                     ". Expected format: file:<path> or pattern:<name>");
+        }
+        args.source_path = id;
+        ParseEnum(replay_pacing_table, args.replay_pacing);
+
+        if (prefix == "pattern") {
+            args.camera_source = CameraSource::Pattern;
+            args.format = V4L2_PIX_FMT_YUV420;
+            INFO_PRINT("Using test pattern: %s", id.c_str());
+        } else {
+            args.camera_source = CameraSource::File;
+            const std::string ext = id.substr(id.find_last_of('.') + 1);
+            args.format =
+                (ext == "h264" || ext == "264") ? V4L2_PIX_FMT_H264 : V4L2_PIX_FMT_YUV420;
+            INFO_PRINT("Using replay file: %s", id.c_str());
+        }
+        return;
+    }
+
     try {
         args.camera_id = std::stoi(id);
     } catch (const std::exception &e) {
@@ -583,6 +833,7 @@ void Parser::ParseDevice(Args &args) {
 
     } else {
         throw std::runtime_error("Unknown camera type: " + prefix +
-                                 ". Expected 'libcamera', 'libargus' or 'v4l2'");
+                                 ". Expected 'libcamera', 'libargus', 'v4l2', 'file' or "
+                                 "'pattern'");
     }
 }
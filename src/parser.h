@@ -8,6 +8,11 @@ class Parser {
     static void ParseArgs(int argc, char *argv[], Args &args);
     static void ParseDevice(Args &args);
     static void ParseWsUrl(Args &args);
+
+  private:
+    // Parses the process-wide options when `camera_idx` is -1, or those of one `cameras:` entry,
+    // and returns the number of entries in the config file's `cameras:` list.
+    static int ParseArgs(int argc, char *argv[], Args &args, int camera_idx);
 };
 
 #endif // PARSER_H_
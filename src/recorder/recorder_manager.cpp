@@ -184,11 +184,18 @@ void RecUtil::CloseContext(AVFormatContext *fmt_ctx) {
     }
 }
 
-std::unique_ptr<RecorderManager> RecorderManager::Create(std::shared_ptr<VideoCapturer> video_src,
-                                                         std::shared_ptr<AudioCapturer> audio_src,
-                                                         Args config, bool auto_start) {
+std::unique_ptr<RecorderManager>
+RecorderManager::Create(std::shared_ptr<VideoCapturer> video_src,
+                        std::shared_ptr<AudioCapturer> audio_src, Args config, bool auto_start,
+                        std::shared_ptr<EncodedSource> encoded_src,
+                        std::shared_ptr<SharedAacEncoder> aac_src) {
     auto instance = std::make_unique<RecorderManager>(config);
     instance->auto_start_ = auto_start;
+    // Snapshots are taken from raw frames, no need to keep the shared encodes running for them.
+    if (config.record_type != RecordType::Snapshot) {
+        instance->encoded_src_ = std::move(encoded_src);
+        instance->aac_src_ = std::move(aac_src);
+    }
 
     if (video_src) {
         instance->CreateVideoRecorder(video_src);
@@ -236,9 +243,21 @@ void RecorderManager::CreateVideoRecorder(std::shared_ptr<VideoCapturer> capture
         if (config.record_type == RecordType::Snapshot) {
             return nullptr;
         }
-        if (capturer->format() == V4L2_PIX_FMT_H264) {
+        if (encoded_src_) {
+            fps = encoded_src_->fps();
+            width = encoded_src_->width();
+            height = encoded_src_->height();
             return RawH264Recorder::Create(width, height, fps);
-        } else if (config.hw_accel) {
+        }
+        // A sub stream is always scaled raw frames, whatever the camera delivers.
+        if (capturer->format() == V4L2_PIX_FMT_H264 && config.record_stream_idx == 0) {
+            return RawH264Recorder::Create(width, height, fps);
+        }
+        // Raw frames are thinned out to --record-fps on the way in, see SubscribeVideoSource().
+        if (config.record_fps > 0) {
+            fps = config.record_fps;
+        }
+        if (config.hw_accel) {
 #if defined(USE_RPI_HW_ENCODER)
             return V4L2H264Recorder::Create(width, height, fps);
 #elif defined(USE_JETSON_HW_ENCODER)
@@ -251,7 +270,7 @@ void RecorderManager::CreateVideoRecorder(std::shared_ptr<VideoCapturer> capture
 
 void RecorderManager::CreateAudioRecorder(std::shared_ptr<AudioCapturer> audio_src) {
     audio_recorder = ([this, &audio_src]() -> std::unique_ptr<AudioRecorder> {
-        if (config.record_type == RecordType::Snapshot) {
+        if (config.record_type == RecordType::Snapshot || aac_src_) {
             return nullptr;
         } else {
             return AudioRecorder::Create(audio_src->sample_rate());
@@ -268,36 +287,45 @@ RecorderManager::RecorderManager(Args config)
       record_path(config.record_path) {}
 
 void RecorderManager::SubscribeVideoSource(std::shared_ptr<VideoCapturer> video_src) {
-    video_subscription_ = video_src->Subscribe(
-        [this](V4L2FrameBufferRef buffer) {
-            bool is_keyframe = (buffer->flags() & V4L2_BUF_FLAG_KEYFRAME) ||
-                               (video_src_->format() != V4L2_PIX_FMT_H264);
+    auto on_buffer = [this](V4L2FrameBufferRef buffer) {
+        bool is_keyframe = (buffer->flags() & V4L2_BUF_FLAG_KEYFRAME) ||
+                           (!encoded_src_ && (video_src_->format() != V4L2_PIX_FMT_H264 ||
+                                              config.record_stream_idx != 0));
+
+        // waiting first keyframe to start recorders.
+        if (auto_start_ && !has_first_keyframe && is_keyframe) {
+            Start();
+            base_start_time_ = buffer->timestamp();
+            next_generate_time_ = ++file_index_ * config.file_duration;
+        }
 
-            // waiting first keyframe to start recorders.
-            if (auto_start_ && !has_first_keyframe && is_keyframe) {
+        int64_t total_elapsed_us =
+            (int64_t)(buffer->timestamp().tv_sec - base_start_time_.tv_sec) * 1000000LL +
+            (int64_t)(buffer->timestamp().tv_usec - base_start_time_.tv_usec);
+        double total_elapsed_time = total_elapsed_us / 1e6;
+
+        if (has_first_keyframe) {
+            if (total_elapsed_time >= next_generate_time_ && is_keyframe) {
+                Stop();
                 Start();
-                base_start_time_ = buffer->timestamp();
                 next_generate_time_ = ++file_index_ * config.file_duration;
             }
 
-            int64_t total_elapsed_us =
-                (int64_t)(buffer->timestamp().tv_sec - base_start_time_.tv_sec) * 1000000LL +
-                (int64_t)(buffer->timestamp().tv_usec - base_start_time_.tv_usec);
-            double total_elapsed_time = total_elapsed_us / 1e6;
-
-            if (has_first_keyframe) {
-                if (total_elapsed_time >= next_generate_time_ && is_keyframe) {
-                    Stop();
-                    Start();
-                    next_generate_time_ = ++file_index_ * config.file_duration;
-                }
-
-                if (video_recorder) {
-                    video_recorder->OnBuffer(buffer);
-                }
+            if (video_recorder) {
+                video_recorder->OnBuffer(buffer);
             }
-        },
-        config.record_stream_idx);
+        }
+    };
+
+    if (encoded_src_) {
+        video_subscription_ = encoded_src_->Subscribe(std::move(on_buffer));
+    } else if (video_src->format() == V4L2_PIX_FMT_H264 && config.record_stream_idx == 0) {
+        // The main stream itself is decoded, if at all, for whoever takes raw frames.
+        video_subscription_ = video_src->SubscribeEncoded(std::move(on_buffer));
+    } else {
+        video_subscription_ = video_src->Subscribe("recorder", std::move(on_buffer),
+                                                   config.record_stream_idx, config.record_fps);
+    }
 
     if (video_recorder) {
         video_recorder->OnPacketed([this](AVPacket *pkt) {
@@ -307,6 +335,14 @@ void RecorderManager::SubscribeVideoSource(std::shared_ptr<VideoCapturer> video_
 }
 
 void RecorderManager::SubscribeAudioSource(std::shared_ptr<AudioCapturer> audio_src) {
+    if (aac_src_) {
+        audio_subscription_ = aac_src_->Subscribe([this](AVPacket *const &pkt) {
+            if (has_first_keyframe) {
+                WriteSharedAudio(pkt);
+            }
+        });
+        return;
+    }
     if (!audio_recorder) {
         return;
     }
@@ -324,7 +360,33 @@ void RecorderManager::SubscribeAudioSource(std::shared_ptr<AudioCapturer> audio_
 
 void RecorderManager::WriteIntoFile(AVPacket *pkt) {
     std::lock_guard<std::mutex> lock(ctx_mux);
+    WritePacket(pkt);
+}
+
+void RecorderManager::WriteSharedAudio(const AVPacket *pkt) {
+    std::lock_guard<std::mutex> lock(ctx_mux);
+    if (!fmt_ctx || !aac_st_) {
+        return;
+    }
 
+    // The shared encoder counts from when it started, each file from its own first packet.
+    if (aac_base_pts_ == AV_NOPTS_VALUE) {
+        aac_base_pts_ = pkt->pts;
+    }
+    AVPacket *copy = av_packet_clone(pkt);
+    if (!copy) {
+        return;
+    }
+    const AVRational time_base = aac_src_->time_base();
+    copy->stream_index = aac_st_->index;
+    copy->pts = av_rescale_q(pkt->pts - aac_base_pts_, time_base, aac_st_->time_base);
+    copy->dts = av_rescale_q(pkt->dts - aac_base_pts_, time_base, aac_st_->time_base);
+    copy->duration = av_rescale_q(pkt->duration, time_base, aac_st_->time_base);
+    WritePacket(copy);
+    av_packet_free(&copy);
+}
+
+void RecorderManager::WritePacket(AVPacket *pkt) {
     if (!fmt_ctx || !has_first_keyframe)
         return;
 
@@ -386,6 +448,9 @@ void RecorderManager::Start() {
         }
         if (audio_recorder) {
             audio_recorder->AddStream(fmt_ctx);
+        } else if (aac_src_) {
+            aac_st_ = aac_src_->AddStream(fmt_ctx);
+            aac_base_pts_ = AV_NOPTS_VALUE;
         }
 
         header_written_ = false;
@@ -400,6 +465,12 @@ void RecorderManager::Start() {
         audio_recorder->Start();
     }
 
+    // Started on request, a file of the shared stream opens with its next key frame. Ask for one
+    // rather than wait out the interval.
+    if (encoded_src_ && !auto_start_) {
+        encoded_src_->ForceKeyFrame(key_frame_requester_);
+    }
+
     if (config.record_type != RecordType::Video) {
         auto image_path = ReplaceExtension(new_file.GetFullPath(), PREVIEW_IMAGE_EXTENSION);
         MakePreviewImage(image_path);
@@ -423,6 +494,7 @@ void RecorderManager::Stop() {
         std::lock_guard<std::mutex> lock(ctx_mux);
         RecUtil::CloseContext(fmt_ctx);
         fmt_ctx = nullptr;
+        aac_st_ = nullptr;
         header_written_ = false;
     }
 }
@@ -456,6 +528,10 @@ void RecorderManager::MakePreviewImage(std::string path) {
             return;
         }
         auto i420buff = video_src->GetI420Frame(record_stream_idx);
+        if (!i420buff) {
+            ERROR_PRINT("No frame arrived for the preview image.");
+            return;
+        }
         jpeg_util::CreateJpegImage(i420buff->DataY(), i420buff->width(), i420buff->height(), path,
                                    jpeg_quality);
     }).detach();
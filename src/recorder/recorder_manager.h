@@ -14,7 +14,10 @@ extern "C" {
 
 #include "capturer/audio_capturer.h"
 #include "capturer/video_capturer.h"
+#include "common/interface/encoded_source.h"
+#include "common/key_frame_scheduler.h"
 #include "recorder/audio_recorder.h"
+#include "recorder/shared_aac_encoder.h"
 #include "recorder/video_recorder.h"
 
 class RecUtil {
@@ -27,7 +30,11 @@ class RecorderManager {
   public:
     static std::unique_ptr<RecorderManager> Create(std::shared_ptr<VideoCapturer> video_src,
                                                    std::shared_ptr<AudioCapturer> audio_src,
-                                                   Args config, bool auto_start = true);
+                                                   Args config, bool auto_start = true,
+                                                   std::shared_ptr<EncodedSource> encoded_src =
+                                                       nullptr,
+                                                   std::shared_ptr<SharedAacEncoder> aac_src =
+                                                       nullptr);
     RecorderManager(Args config);
     ~RecorderManager();
     void WriteIntoFile(AVPacket *pkt);
@@ -66,6 +73,13 @@ class RecorderManager {
     std::thread rotation_thread_;
     struct timeval base_start_time_;
     std::shared_ptr<VideoCapturer> video_src_;
+    // Encodes shared with other recorders or WebRTC, muxed instead of encoding the sources again.
+    std::shared_ptr<EncodedSource> encoded_src_;
+    const int key_frame_requester_ = KeyFrameScheduler::NewRequesterId();
+    std::shared_ptr<SharedAacEncoder> aac_src_;
+    // The current file's stream of aac_src_'s packets, and the pts its first packet had.
+    AVStream *aac_st_ = nullptr;
+    int64_t aac_base_pts_ = AV_NOPTS_VALUE;
 
     std::string current_filepath_;
 
@@ -73,6 +87,9 @@ class RecorderManager {
     Subscription video_subscription_;
 
     void StartRotationThread();
+    void WriteSharedAudio(const AVPacket *pkt);
+    // Called with ctx_mux held.
+    void WritePacket(AVPacket *pkt);
     void MakePreviewImage(std::string path);
     std::string ReplaceExtension(const std::string &url, const std::string &new_extension);
 };
@@ -0,0 +1,69 @@
+#include "recorder/shared_aac_encoder.h"
+
+#include "common/logging.h"
+
+std::shared_ptr<SharedAacEncoder>
+SharedAacEncoder::Create(std::shared_ptr<AudioCapturer> audio_src) {
+    return std::make_shared<SharedAacEncoder>(std::move(audio_src));
+}
+
+SharedAacEncoder::SharedAacEncoder(std::shared_ptr<AudioCapturer> audio_src)
+    : audio_src_(std::move(audio_src)),
+      encoder_(AudioRecorder::Create(audio_src_->sample_rate())),
+      template_ctx_(avformat_alloc_context()),
+      started_(false) {
+    if (!template_ctx_ || !encoder_->AddStream(template_ctx_)) {
+        ERROR_PRINT("Failed to set up the shared audio encoder.");
+    }
+    encoder_->OnPacketed([this](AVPacket *pkt) {
+        subject_.Next(pkt);
+    });
+}
+
+SharedAacEncoder::~SharedAacEncoder() {
+    encoder_->Stop();
+    avformat_free_context(template_ctx_);
+}
+
+AVStream *SharedAacEncoder::AddStream(AVFormatContext *fmt_ctx) const {
+    if (!template_ctx_ || template_ctx_->nb_streams == 0) {
+        return nullptr;
+    }
+    const AVStream *source = template_ctx_->streams[0];
+    AVStream *st = avformat_new_stream(fmt_ctx, nullptr);
+    if (!st) {
+        return nullptr;
+    }
+    if (avcodec_parameters_copy(st->codecpar, source->codecpar) < 0) {
+        return nullptr;
+    }
+    st->time_base = source->time_base;
+    return st;
+}
+
+AVRational SharedAacEncoder::time_base() const {
+    if (!template_ctx_ || template_ctx_->nb_streams == 0) {
+        return {1, audio_src_->sample_rate()};
+    }
+    return template_ctx_->streams[0]->time_base;
+}
+
+Subscription SharedAacEncoder::Subscribe(Subject<AVPacket *>::Callback callback) {
+    auto subscription = subject_.Subscribe(std::move(callback));
+    Start();
+    return subscription;
+}
+
+void SharedAacEncoder::Start() {
+    std::lock_guard<std::mutex> lock(start_mtx_);
+    if (started_) {
+        return;
+    }
+    started_ = true;
+
+    encoder_->Start();
+    capture_subscription_ = audio_src_->Subscribe([this](const AudioBuffer &buffer) {
+        encoder_->OnBuffer(buffer);
+    });
+    DEBUG_PRINT("Shared AAC stream: encoding %d Hz.", audio_src_->sample_rate());
+}
@@ -0,0 +1,48 @@
+#ifndef SHARED_AAC_ENCODER_H_
+#define SHARED_AAC_ENCODER_H_
+
+#include <memory>
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include "capturer/audio_capturer.h"
+#include "recorder/audio_recorder.h"
+
+// The microphone encoded to AAC once for every recorder, where each would otherwise run an
+// AudioRecorder of its own. A recorder adds a stream of the encoder's parameters to each file
+// with AddStream() and muxes the packets it is sent, re-based to the start of that file.
+//
+// Encoding starts with the first subscriber and runs until this is destroyed.
+class SharedAacEncoder {
+  public:
+    static std::shared_ptr<SharedAacEncoder> Create(std::shared_ptr<AudioCapturer> audio_src);
+    SharedAacEncoder(std::shared_ptr<AudioCapturer> audio_src);
+    ~SharedAacEncoder();
+
+    // A new stream in `fmt_ctx` for these packets, nullptr if it could not be added.
+    AVStream *AddStream(AVFormatContext *fmt_ctx) const;
+    // The time base of the packets' pts.
+    AVRational time_base() const;
+    // Packets come on the encoder's thread and are only valid during the callback.
+    Subscription Subscribe(Subject<AVPacket *>::Callback callback);
+
+  private:
+    const std::shared_ptr<AudioCapturer> audio_src_;
+    std::unique_ptr<AudioRecorder> encoder_;
+    // Never written; it only holds the stream the encoder is set up for.
+    AVFormatContext *template_ctx_;
+    Subject<AVPacket *> subject_;
+
+    // Declared last so that the capture stops before anything above goes away.
+    std::mutex start_mtx_;
+    bool started_;
+    Subscription capture_subscription_;
+
+    void Start();
+};
+
+#endif // SHARED_AAC_ENCODER_H_
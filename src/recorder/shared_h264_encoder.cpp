@@ -0,0 +1,197 @@
+#include "recorder/shared_h264_encoder.h"
+
+#include "common/logging.h"
+
+namespace {
+
+// Two frames, as a recorder queues: the encoder is either keeping up or the oldest is dropped.
+constexpr int kEncodeQueueDepth = 2;
+
+} // namespace
+
+std::shared_ptr<SharedH264Encoder>
+SharedH264Encoder::Create(std::shared_ptr<VideoCapturer> capturer, Args config) {
+    return std::make_shared<SharedH264Encoder>(std::move(capturer), std::move(config));
+}
+
+SharedH264Encoder::SharedH264Encoder(std::shared_ptr<VideoCapturer> capturer, Args config)
+    : capturer_(std::move(capturer)),
+      config_(std::move(config)),
+      stream_idx_(config_.record_stream_idx),
+      width_(capturer_->width(stream_idx_)),
+      height_(capturer_->height(stream_idx_)),
+      passthrough_(capturer_->format() == V4L2_PIX_FMT_H264 && stream_idx_ == 0),
+      fps_(!passthrough_ && config_.record_fps > 0 ? config_.record_fps : capturer_->fps()),
+      key_frames_(KeyFrameScheduler::Create({
+          .name = "shared encoder",
+          .merge_window_ms = config_.keyframe_merge_window,
+          .min_interval_ms = config_.min_keyframe_interval,
+      })),
+      applied_bitrate_bps_(0),
+      started_(false) {}
+
+SharedH264Encoder::~SharedH264Encoder() {
+    if (mailbox_) {
+        mailbox_->Close();
+    }
+}
+
+int SharedH264Encoder::width() const { return width_; }
+
+int SharedH264Encoder::height() const { return height_; }
+
+int SharedH264Encoder::fps() const { return fps_; }
+
+Subscription SharedH264Encoder::Subscribe(Subject<V4L2FrameBufferRef>::Callback callback) {
+    auto subscription = subject_.Subscribe(std::move(callback));
+    Start();
+    return subscription;
+}
+
+void SharedH264Encoder::ForceKeyFrame(int requester) { key_frames_->Request(requester); }
+
+void SharedH264Encoder::SetBitrate(int requester, int bitrate_bps) {
+    if (!passthrough_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(rates_mtx_);
+    if (bitrate_bps > 0) {
+        rates_[requester] = bitrate_bps;
+    } else {
+        rates_.erase(requester);
+    }
+    int chosen = 0;
+    for (const auto &[id, bps] : rates_) {
+        if (chosen == 0 || (config_.broadcast_bitrate == BroadcastBitrate::Highest ? bps > chosen
+                                                                                : bps < chosen)) {
+            chosen = bps;
+        }
+    }
+    // With nobody asking, the camera keeps the last rate; it only needs to hear of new ones.
+    if (chosen == 0 || chosen == applied_bitrate_bps_) {
+        return;
+    }
+    applied_bitrate_bps_ = chosen;
+    if (!capturer_->SetControls(V4L2_CID_MPEG_VIDEO_BITRATE, chosen)) {
+        DEBUG_PRINT("The camera did not take a bitrate of %d bps.", chosen);
+    }
+}
+
+void SharedH264Encoder::Start() {
+    std::lock_guard<std::mutex> lock(start_mtx_);
+    if (started_) {
+        return;
+    }
+    started_ = true;
+
+    if (passthrough_) {
+        capture_subscription_ = capturer_->SubscribeEncoded(
+            [this](const V4L2FrameBufferRef &frame_buffer) {
+                // The camera's encoder takes the control with one of the next frames.
+                if (key_frames_->Poll()) {
+                    capturer_->SetControls(V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME, 1);
+                }
+                if (frame_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME) {
+                    key_frames_->OnKeyFrame();
+                }
+                Cache(frame_buffer);
+                subject_.Next(frame_buffer);
+            });
+        DEBUG_PRINT("Shared H.264 stream: passing the camera's own through.");
+        return;
+    }
+
+    // With --async-dispatch the named subscription already has a thread of its own.
+    Subject<V4L2FrameBufferRef>::Callback encode = [this](const V4L2FrameBufferRef &frame_buffer) {
+        Encode(frame_buffer);
+    };
+    if (!config_.async_dispatch) {
+        FrameMailbox::Options options;
+        options.name = "shared encoder";
+        options.depth = kEncodeQueueDepth;
+        mailbox_ = FrameMailbox::Create(std::move(options), std::move(encode));
+        encode = [mailbox = mailbox_](const V4L2FrameBufferRef &frame_buffer) {
+            mailbox->Push(frame_buffer);
+        };
+    }
+    capture_subscription_ = capturer_->Subscribe("shared encoder", std::move(encode), stream_idx_,
+                                                 config_.record_fps);
+    DEBUG_PRINT("Shared H.264 stream: encoding %dx%d@%d, a key frame every %ds.", width_, height_,
+                fps_, config_.shared_keyframe_interval);
+}
+
+void SharedH264Encoder::Encode(const V4L2FrameBufferRef &frame_buffer) {
+    const bool force_key_frame = key_frames_->Poll();
+    EncoderConfig config = {
+        .width = width_,
+        .height = height_,
+        .fps = fps_,
+        .bitrate = static_cast<int>(width_ * height_ * fps_ * 0.1),
+        .keyframe_interval = fps_ * config_.shared_keyframe_interval,
+        .is_dma_src = false,
+        .src_pix_fmt = frame_buffer->format(),
+        .rc_mode = V4L2_MPEG_VIDEO_BITRATE_MODE_VBR,
+    };
+
+#if defined(USE_RPI_HW_ENCODER)
+    if (config_.hw_accel) {
+        if (!v4l2_encoder_) {
+            v4l2_encoder_ = V4L2Encoder::Create(config);
+            if (!v4l2_encoder_) {
+                return;
+            }
+            v4l2_encoder_->ForceKeyFrame();
+        } else if (force_key_frame) {
+            v4l2_encoder_->ForceKeyFrame();
+        }
+        const timeval timestamp = frame_buffer->timestamp();
+        v4l2_encoder_->EmplaceBuffer(frame_buffer, [this, timestamp](V4L2FrameBufferRef encoded) {
+            Publish(encoded->Data(), encoded->size(), encoded->flags() & V4L2_BUF_FLAG_KEYFRAME,
+                    timestamp);
+        });
+        return;
+    }
+#endif
+
+    if (!openh264_encoder_) {
+        openh264_encoder_ = Openh264Encoder::Create(config);
+        if (!openh264_encoder_) {
+            return;
+        }
+    } else if (force_key_frame) {
+        openh264_encoder_->ForceKeyFrame();
+    }
+    const timeval timestamp = frame_buffer->timestamp();
+    openh264_encoder_->Encode(frame_buffer->ToI420(),
+                              [this, timestamp](uint8_t *data, int size, bool is_keyframe) {
+                                  Publish(data, size, is_keyframe, timestamp);
+                              });
+}
+
+void SharedH264Encoder::Publish(const void *data, uint32_t size, bool is_keyframe,
+                                timeval timestamp) {
+    if (is_keyframe) {
+        key_frames_->OnKeyFrame();
+    }
+    // The encoder reuses its output buffer for the next frame, so subscribers get a copy of their
+    // own that they may keep.
+    V4L2Buffer buffer(const_cast<void *>(data), V4L2_PIX_FMT_H264, size, -1,
+                      is_keyframe ? V4L2_BUF_FLAG_KEYFRAME : 0, timestamp);
+    auto frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer)->Clone();
+    Cache(frame_buffer);
+    subject_.Next(frame_buffer);
+}
+
+void SharedH264Encoder::Cache(const V4L2FrameBufferRef &frame_buffer) {
+    if (!config_.fast_start) {
+        return;
+    }
+    // A passed-through frame may be the camera's own buffer, which a GOP's worth of would starve
+    // the capture queue of, so the cache holds copies of those.
+    gop_cache_.Add(passthrough_ ? frame_buffer->Clone() : frame_buffer,
+                   frame_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME, frame_buffer->size());
+}
+
+std::vector<V4L2FrameBufferRef> SharedH264Encoder::CachedGop() const {
+    return gop_cache_.Frames();
+}
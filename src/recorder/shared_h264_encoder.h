@@ -0,0 +1,79 @@
+#ifndef SHARED_H264_ENCODER_H_
+#define SHARED_H264_ENCODER_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "args.h"
+#include "capturer/video_capturer.h"
+#include "codecs/h264/openh264_encoder.h"
+#include "codecs/v4l2/v4l2_encoder.h"
+#include "common/frame_mailbox.h"
+#include "common/gop_cache.h"
+#include "common/interface/encoded_source.h"
+#include "common/key_frame_scheduler.h"
+
+// A camera's recording stream encoded to H.264 once, for the background and on-demand recorders
+// to mux and, with --shared-encoder, for WebRTC to forward, where each would otherwise run an
+// encoder of its own. On a Pi Zero 2 or a Pi 3 the second encode is what the frame rate pays for.
+//
+// Encoding starts with the first subscriber, on a FrameMailbox thread of its own, with the V4L2
+// hardware encoder under --hw-accel on a Pi and OpenH264 otherwise, at the rate the recorders use.
+// A key frame comes every --shared-keyframe-interval seconds, or when the KeyFrameScheduler lets
+// a ForceKeyFrame() through. The rate stays the recording's: SetBitrate() is ignored, so peers get
+// the recording quality whatever their bandwidth estimate.
+//
+// The main stream of an H.264 camera already is such a stream and is passed through as it is,
+// with ForceKeyFrame() and SetBitrate() going to the camera's own encoder. There is one encoder
+// then, so the rate WebRTC sets is the recording's too: the lowest or the highest of the peers'
+// targets per --broadcast-bitrate, as for a --broadcast-encoder share, and not just the last one.
+//
+// With --fast-start the frames since the last key frame are kept for CachedGop().
+class SharedH264Encoder : public EncodedSource {
+  public:
+    static std::shared_ptr<SharedH264Encoder> Create(std::shared_ptr<VideoCapturer> capturer,
+                                                     Args config);
+    SharedH264Encoder(std::shared_ptr<VideoCapturer> capturer, Args config);
+    ~SharedH264Encoder() override;
+
+    int width() const override;
+    int height() const override;
+    int fps() const override;
+    Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback) override;
+    void ForceKeyFrame(int requester) override;
+    void SetBitrate(int requester, int bitrate_bps) override;
+    std::vector<V4L2FrameBufferRef> CachedGop() const override;
+
+  private:
+    const std::shared_ptr<VideoCapturer> capturer_;
+    const Args config_;
+    const int stream_idx_;
+    const int width_;
+    const int height_;
+    const bool passthrough_;
+    const int fps_;
+    const std::shared_ptr<KeyFrameScheduler> key_frames_;
+    std::mutex rates_mtx_;
+    std::map<int, int> rates_; // by requester
+    int applied_bitrate_bps_;
+    Subject<V4L2FrameBufferRef> subject_;
+    GopCache<V4L2FrameBufferRef> gop_cache_;
+
+    // The encode thread's.
+    std::unique_ptr<V4L2Encoder> v4l2_encoder_;
+    std::unique_ptr<Openh264Encoder> openh264_encoder_;
+
+    // Declared last so that the capture stops before anything above goes away.
+    std::mutex start_mtx_;
+    bool started_;
+    std::shared_ptr<FrameMailbox> mailbox_;
+    Subscription capture_subscription_;
+
+    void Start();
+    void Encode(const V4L2FrameBufferRef &frame_buffer);
+    void Publish(const void *data, uint32_t size, bool is_keyframe, timeval timestamp);
+    void Cache(const V4L2FrameBufferRef &frame_buffer);
+};
+
+#endif // SHARED_H264_ENCODER_H_
@@ -38,10 +38,11 @@ void VideoRecorder::OnBuffer(V4L2FrameBufferRef frame_buffer) {
         return;
     }
 
-    // A dma-only frame is passed on by reference: it lives in NVMM and every encoder on that path
-    // reads it through the dma fd, so there is nothing to copy. A mmap-backed one has to be copied
-    // out first, because the driver takes it back as soon as this callback returns.
-    frame_buffer_queue.push(frame_buffer->IsDmaOnly() ? frame_buffer : frame_buffer->Clone());
+    // A retainable frame is passed on by reference: a dma-only one lives in NVMM and every encoder
+    // on that path reads it through the dma fd, and a lent V4L2 buffer is not queued back to the
+    // driver until this reference is gone. Any other mmap-backed frame has to be copied out
+    // first, because the driver takes it back as soon as this callback returns.
+    frame_buffer_queue.push(frame_buffer->IsRetainable() ? frame_buffer : frame_buffer->Clone());
 }
 
 void VideoRecorder::OnStart() {
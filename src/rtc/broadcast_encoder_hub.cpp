@@ -0,0 +1,422 @@
+#include "rtc/broadcast_encoder_hub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include "common/gop_cache.h"
+#include "common/logging.h"
+
+namespace {
+
+// A frame this much older than the last one encoded means the capture clock started over, not
+// that a peer fell behind.
+constexpr int64_t kClockRestartUs = 1000000;
+
+// The RTP timestamp a session encodes a frame under: the capture time on the 90 kHz video clock,
+// the same for every peer's copy of the frame. Each peer then only differs by a fixed offset.
+uint32_t SharedRtpTimestamp(int64_t timestamp_us) {
+    return static_cast<uint32_t>(timestamp_us * 90 / 1000);
+}
+
+} // namespace
+
+class BroadcastEncoderHub::Session : public webrtc::EncodedImageCallback {
+  public:
+    Session(std::unique_ptr<webrtc::VideoEncoder> encoder, BroadcastBitrate policy,
+            bool fast_start, std::shared_ptr<KeyFrameScheduler> key_frames);
+    ~Session() override;
+
+    int32_t Init(const webrtc::VideoCodec &codec_settings,
+                 const webrtc::VideoEncoder::Settings &settings);
+    const webrtc::VideoEncoder::EncoderInfo &encoder_info() const;
+
+    void Attach(Proxy *proxy);
+    void Detach(Proxy *proxy);
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types, int requester);
+    void SetRates(Proxy *proxy, const webrtc::VideoEncoder::RateControlParameters &parameters);
+    // Sends `proxy` the cached GOP, if it has no key frame yet and there is one within
+    // `budget` bytes and kMaxGopReplayUs. Returns whether it did.
+    bool Replay(Proxy *proxy, size_t budget);
+
+    Result OnEncodedImage(const webrtc::EncodedImage &encoded_image,
+                          const webrtc::CodecSpecificInfo *codec_specific_info) override;
+    void OnDroppedFrame(DropReason reason) override;
+
+  private:
+    struct CachedImage {
+        webrtc::EncodedImage image;
+        std::optional<webrtc::CodecSpecificInfo> codec_specific_info;
+    };
+
+    const std::unique_ptr<webrtc::VideoEncoder> encoder_;
+    const BroadcastBitrate policy_;
+    const bool fast_start_;
+    const std::shared_ptr<KeyFrameScheduler> key_frames_;
+    webrtc::VideoEncoder::EncoderInfo encoder_info_;
+    // Only with --fast-start, and only for a single layer: a simulcast peer would need every
+    // layer's GOP.
+    bool caches_gop_ = false;
+    GopCache<CachedImage> gop_cache_;
+
+    // Encode() and SetRates() come from every peer's encoder queue. A synchronous encoder calls
+    // back with this held, so it is always taken before proxies_mtx_, never after.
+    std::mutex encode_mtx_;
+    int64_t last_timestamp_us_ = std::numeric_limits<int64_t>::min();
+    std::map<Proxy *, webrtc::VideoEncoder::RateControlParameters> rates_;
+    std::optional<webrtc::VideoEncoder::RateControlParameters> applied_rates_;
+
+    std::mutex proxies_mtx_;
+    std::vector<Proxy *> proxies_;
+
+    void ApplyRates();
+};
+
+class BroadcastEncoderHub::Proxy : public webrtc::VideoEncoder {
+  public:
+    Proxy(std::shared_ptr<BroadcastEncoderHub> hub, const webrtc::Environment &env,
+          const webrtc::SdpVideoFormat &format)
+        : hub_(std::move(hub)),
+          env_(env),
+          format_(format) {}
+
+    ~Proxy() override { Release(); }
+
+    int InitEncode(const webrtc::VideoCodec *codec_settings,
+                   const VideoEncoder::Settings &settings) override {
+        Release();
+        int32_t result = WEBRTC_VIDEO_CODEC_OK;
+        session_ = hub_->Join(env_, format_, *codec_settings, settings, result);
+        if (!session_) {
+            return result;
+        }
+        key_frame_layers_ = 0;
+        first_encode_ = true;
+        replay_budget_ = GopReplayBudget(codec_settings->startBitrate);
+        session_->Attach(this);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override {
+        callback_.store(callback);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Release() override {
+        if (session_) {
+            session_->Detach(this);
+            session_.reset();
+        }
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types) override {
+        if (!session_) {
+            return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+        }
+        rtp_offset_.store(frame.rtp_timestamp() - SharedRtpTimestamp(frame.timestamp_us()));
+        if (first_encode_) {
+            first_encode_ = false;
+            // Brought up to date from the cache, a peer that joins need not cost everyone else
+            // the key frame its encoder asks for first.
+            if (session_->Replay(this, replay_budget_)) {
+                const std::vector<webrtc::VideoFrameType> delta_types(
+                    frame_types ? std::max<size_t>(frame_types->size(), 1) : 1,
+                    webrtc::VideoFrameType::kVideoFrameDelta);
+                return session_->Encode(frame, &delta_types, key_frame_requester_);
+            }
+        }
+        return session_->Encode(frame, frame_types, key_frame_requester_);
+    }
+
+    void SetRates(const RateControlParameters &parameters) override {
+        if (session_) {
+            session_->SetRates(this, parameters);
+        }
+    }
+
+    EncoderInfo GetEncoderInfo() const override {
+        return session_ ? session_->encoder_info() : hub_->LastEncoderInfo(format_);
+    }
+
+    // The session's callback thread, with the session's proxies_mtx_ held.
+    void Deliver(const webrtc::EncodedImage &encoded_image,
+                 const webrtc::CodecSpecificInfo *codec_specific_info) {
+        auto *callback = callback_.load();
+        if (!callback) {
+            return;
+        }
+
+        // Until it has a key frame, a layer is of no use to a peer that joined mid-stream.
+        const uint32_t layer = 1u << encoded_image.SimulcastIndex().value_or(0);
+        if (encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+            key_frame_layers_ |= layer;
+        } else if (!(key_frame_layers_ & layer)) {
+            return;
+        }
+
+        webrtc::EncodedImage own_image = encoded_image;
+        own_image.SetRtpTimestamp(encoded_image.RtpTimestamp() + rtp_offset_.load());
+        callback->OnEncodedImage(own_image, codec_specific_info);
+    }
+
+    // With the session's proxies_mtx_ held.
+    bool has_key_frame() const { return key_frame_layers_ != 0; }
+
+    void DeliverDrop(webrtc::EncodedImageCallback::DropReason reason) {
+        if (auto *callback = callback_.load()) {
+            callback->OnDroppedFrame(reason);
+        }
+    }
+
+  private:
+    const std::shared_ptr<BroadcastEncoderHub> hub_;
+    const webrtc::Environment env_;
+    const webrtc::SdpVideoFormat format_;
+    std::shared_ptr<Session> session_;
+    const int key_frame_requester_ = KeyFrameScheduler::NewRequesterId();
+    std::atomic<webrtc::EncodedImageCallback *> callback_{nullptr};
+    // This peer's RTP timestamp minus the session's, for the same frame.
+    std::atomic<uint32_t> rtp_offset_{0};
+    uint32_t key_frame_layers_ = 0; // simulcast layers a key frame was delivered for
+    bool first_encode_ = true;
+    size_t replay_budget_ = 0;
+};
+
+BroadcastEncoderHub::Session::Session(std::unique_ptr<webrtc::VideoEncoder> encoder,
+                                      BroadcastBitrate policy, bool fast_start,
+                                      std::shared_ptr<KeyFrameScheduler> key_frames)
+    : encoder_(std::move(encoder)),
+      policy_(policy),
+      fast_start_(fast_start),
+      key_frames_(std::move(key_frames)) {}
+
+BroadcastEncoderHub::Session::~Session() {
+    encoder_->Release();
+    encoder_->RegisterEncodeCompleteCallback(nullptr);
+}
+
+int32_t BroadcastEncoderHub::Session::Init(const webrtc::VideoCodec &codec_settings,
+                                           const webrtc::VideoEncoder::Settings &settings) {
+    int32_t result = encoder_->InitEncode(&codec_settings, settings);
+    if (result != WEBRTC_VIDEO_CODEC_OK) {
+        return result;
+    }
+    encoder_->RegisterEncodeCompleteCallback(this);
+    encoder_info_ = encoder_->GetEncoderInfo();
+    caches_gop_ = fast_start_ && codec_settings.numberOfSimulcastStreams <= 1;
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+const webrtc::VideoEncoder::EncoderInfo &BroadcastEncoderHub::Session::encoder_info() const {
+    return encoder_info_;
+}
+
+void BroadcastEncoderHub::Session::Attach(Proxy *proxy) {
+    std::lock_guard<std::mutex> lock(proxies_mtx_);
+    proxies_.push_back(proxy);
+}
+
+void BroadcastEncoderHub::Session::Detach(Proxy *proxy) {
+    {
+        std::lock_guard<std::mutex> lock(proxies_mtx_);
+        proxies_.erase(std::remove(proxies_.begin(), proxies_.end(), proxy), proxies_.end());
+    }
+    std::lock_guard<std::mutex> lock(encode_mtx_);
+    if (rates_.erase(proxy) > 0) {
+        ApplyRates();
+    }
+}
+
+int32_t
+BroadcastEncoderHub::Session::Encode(const webrtc::VideoFrame &frame,
+                                     const std::vector<webrtc::VideoFrameType> *frame_types,
+                                     int requester) {
+    // Made here rather than by whichever peer encodes the frame, so that one that got here
+    // second is not lost.
+    if (frame_types && std::find(frame_types->begin(), frame_types->end(),
+                                 webrtc::VideoFrameType::kVideoFrameKey) != frame_types->end()) {
+        key_frames_->Request(requester);
+    }
+
+    std::lock_guard<std::mutex> lock(encode_mtx_);
+    if (frame.timestamp_us() <= last_timestamp_us_ &&
+        last_timestamp_us_ - frame.timestamp_us() < kClockRestartUs) {
+        // Another peer got here first.
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    last_timestamp_us_ = frame.timestamp_us();
+
+    const bool key_frame = key_frames_->Poll();
+    const size_t layers = frame_types ? std::max<size_t>(frame_types->size(), 1) : 1;
+    const std::vector<webrtc::VideoFrameType> shared_types(
+        layers, key_frame ? webrtc::VideoFrameType::kVideoFrameKey
+                          : webrtc::VideoFrameType::kVideoFrameDelta);
+
+    webrtc::VideoFrame shared_frame = frame;
+    shared_frame.set_rtp_timestamp(SharedRtpTimestamp(frame.timestamp_us()));
+    return encoder_->Encode(shared_frame, &shared_types);
+}
+
+void BroadcastEncoderHub::Session::SetRates(
+    Proxy *proxy, const webrtc::VideoEncoder::RateControlParameters &parameters) {
+    std::lock_guard<std::mutex> lock(encode_mtx_);
+    rates_[proxy] = parameters;
+    ApplyRates();
+}
+
+void BroadcastEncoderHub::Session::ApplyRates() {
+    const webrtc::VideoEncoder::RateControlParameters *chosen = nullptr;
+    for (const auto &[proxy, rates] : rates_) {
+        const uint32_t bps = rates.bitrate.get_sum_bps();
+        if (bps == 0) {
+            continue;
+        }
+        if (!chosen || (policy_ == BroadcastBitrate::Highest ? bps > chosen->bitrate.get_sum_bps()
+                                                             : bps < chosen->bitrate.get_sum_bps())) {
+            chosen = &rates;
+        }
+    }
+    // With every peer paused the encoder is paused too.
+    if (!chosen && !rates_.empty()) {
+        chosen = &rates_.begin()->second;
+    }
+    if (!chosen || applied_rates_ == *chosen) {
+        return;
+    }
+    applied_rates_ = *chosen;
+    encoder_->SetRates(*chosen);
+}
+
+bool BroadcastEncoderHub::Session::Replay(Proxy *proxy, size_t budget) {
+    if (!caches_gop_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(proxies_mtx_);
+    if (proxy->has_key_frame()) {
+        return false;
+    }
+    const std::vector<CachedImage> frames = gop_cache_.Frames();
+    if (frames.empty()) {
+        return false;
+    }
+    size_t bytes = 0;
+    for (const auto &frame : frames) {
+        bytes += frame.image.size();
+    }
+    // Every image carries the session's RTP timestamp, the capture time on the 90 kHz clock.
+    const int64_t span_us =
+        int64_t{frames.back().image.RtpTimestamp() - frames.front().image.RtpTimestamp()} * 1000 /
+        90;
+    if (bytes > budget || span_us > kMaxGopReplayUs) {
+        DEBUG_PRINT("Not replaying %zu cached frame(s), %zu bytes over %lld ms, to a joining peer.",
+                    frames.size(), bytes, static_cast<long long>(span_us / 1000));
+        return false;
+    }
+    for (const auto &frame : frames) {
+        proxy->Deliver(frame.image, frame.codec_specific_info ? &*frame.codec_specific_info
+                                                              : nullptr);
+    }
+    DEBUG_PRINT("Replayed %zu cached frame(s) to a joining peer.", frames.size());
+    return true;
+}
+
+webrtc::EncodedImageCallback::Result
+BroadcastEncoderHub::Session::OnEncodedImage(const webrtc::EncodedImage &encoded_image,
+                                             const webrtc::CodecSpecificInfo *codec_specific_info) {
+    if (encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+        key_frames_->OnKeyFrame();
+    }
+    std::lock_guard<std::mutex> lock(proxies_mtx_);
+    if (caches_gop_) {
+        // An encoder may reuse its output buffer for the next frame.
+        CachedImage cached{encoded_image, std::nullopt};
+        cached.image.SetEncodedData(
+            webrtc::EncodedImageBuffer::Create(encoded_image.data(), encoded_image.size()));
+        if (codec_specific_info) {
+            cached.codec_specific_info = *codec_specific_info;
+        }
+        gop_cache_.Add(std::move(cached),
+                       encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey,
+                       encoded_image.size());
+    }
+    for (auto *proxy : proxies_) {
+        proxy->Deliver(encoded_image, codec_specific_info);
+    }
+    return Result(Result::OK);
+}
+
+void BroadcastEncoderHub::Session::OnDroppedFrame(DropReason reason) {
+    std::lock_guard<std::mutex> lock(proxies_mtx_);
+    for (auto *proxy : proxies_) {
+        proxy->DeliverDrop(reason);
+    }
+}
+
+std::shared_ptr<BroadcastEncoderHub> BroadcastEncoderHub::Create(Factory factory,
+                                                                 const Args &args) {
+    return std::make_shared<BroadcastEncoderHub>(std::move(factory), args);
+}
+
+BroadcastEncoderHub::BroadcastEncoderHub(Factory factory, const Args &args)
+    : factory_(std::move(factory)),
+      policy_(args.broadcast_bitrate),
+      fast_start_(args.fast_start),
+      key_frame_options_{.merge_window_ms = args.keyframe_merge_window,
+                         .min_interval_ms = args.min_keyframe_interval} {}
+
+std::unique_ptr<webrtc::VideoEncoder>
+BroadcastEncoderHub::CreateEncoder(const webrtc::Environment &env,
+                                   const webrtc::SdpVideoFormat &format) {
+    return std::make_unique<Proxy>(shared_from_this(), env, format);
+}
+
+std::shared_ptr<BroadcastEncoderHub::Session>
+BroadcastEncoderHub::Join(const webrtc::Environment &env, const webrtc::SdpVideoFormat &format,
+                          const webrtc::VideoCodec &codec_settings,
+                          const webrtc::VideoEncoder::Settings &settings, int32_t &result) {
+    const std::string key = format.ToString() + " " + std::to_string(codec_settings.width) + "x" +
+                            std::to_string(codec_settings.height) + " x" +
+                            std::to_string(codec_settings.numberOfSimulcastStreams);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::erase_if(sessions_, [](const auto &entry) { return entry.second.expired(); });
+    if (auto session = sessions_[key].lock()) {
+        result = WEBRTC_VIDEO_CODEC_OK;
+        return session;
+    }
+
+    auto encoder = factory_(env, format);
+    if (!encoder) {
+        sessions_.erase(key);
+        result = WEBRTC_VIDEO_CODEC_ERROR;
+        return nullptr;
+    }
+    KeyFrameScheduler::Options key_frame_options = key_frame_options_;
+    key_frame_options.name = "broadcast " + key;
+    auto session = std::make_shared<Session>(std::move(encoder), policy_, fast_start_,
+                                             KeyFrameScheduler::Create(key_frame_options));
+    result = session->Init(codec_settings, settings);
+    if (result != WEBRTC_VIDEO_CODEC_OK) {
+        ERROR_PRINT("Failed to open the broadcast encoder for %s => %d", key.c_str(), result);
+        sessions_.erase(key);
+        return nullptr;
+    }
+    DEBUG_PRINT("Opened the broadcast encoder for %s.", key.c_str());
+    sessions_[key] = session;
+    encoder_infos_[format.name] = session->encoder_info();
+    return session;
+}
+
+webrtc::VideoEncoder::EncoderInfo
+BroadcastEncoderHub::LastEncoderInfo(const webrtc::SdpVideoFormat &format) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = encoder_infos_.find(format.name);
+    return it != encoder_infos_.end() ? it->second : webrtc::VideoEncoder::EncoderInfo();
+}
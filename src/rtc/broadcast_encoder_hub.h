@@ -0,0 +1,72 @@
+#ifndef BROADCAST_ENCODER_HUB_H_
+#define BROADCAST_ENCODER_HUB_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <api/environment/environment.h>
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+
+#include "args.h"
+#include "common/key_frame_scheduler.h"
+
+// --broadcast-encoder: one encoder per codec and resolution, shared by every peer connection,
+// instead of one per peer. Each peer's VideoStreamEncoder still gets a VideoEncoder of its own,
+// but that is a proxy onto a session the hub keeps per SDP format, size and simulcast layout.
+// Nothing in that tells two cameras apart, so the parser only allows it with one camera streamed.
+//
+// - A frame is encoded once, by whichever peer brings it first; the later ones only find it done.
+//   Frames are matched on timestamp_us(), which the track source sets from the capture time and
+//   every peer's copy shares.
+// - The encoded frame goes out to every peer in the session, re-stamped with that peer's own RTP
+//   timestamp. A peer that joins a running session is sent nothing until the next key frame.
+// - Key frame requests from every peer go to one KeyFrameScheduler per session, so that a burst
+//   of them is answered by one key frame, --min-keyframe-interval after the previous one.
+// - The rate is set from the peers' targets, the lowest or the highest of them per
+//   --broadcast-bitrate. Peers with a zero target, i.e. paused, are left out.
+//
+// With --fast-start a single-layer session keeps the frames since its last key frame, and a peer
+// that joins is sent those first rather than waiting for, or asking everyone for, a key frame.
+// Only if they fit its start bitrate, see kMaxGopReplayUs; otherwise it asks like any other.
+//
+// The session, and its encoder with it, is released once its last peer leaves.
+class BroadcastEncoderHub : public std::enable_shared_from_this<BroadcastEncoderHub> {
+  public:
+    using Factory = std::function<std::unique_ptr<webrtc::VideoEncoder>(
+        const webrtc::Environment &env, const webrtc::SdpVideoFormat &format)>;
+
+    static std::shared_ptr<BroadcastEncoderHub> Create(Factory factory, const Args &args);
+
+    BroadcastEncoderHub(Factory factory, const Args &args);
+
+    // A peer connection's encoder.
+    std::unique_ptr<webrtc::VideoEncoder> CreateEncoder(const webrtc::Environment &env,
+                                                        const webrtc::SdpVideoFormat &format);
+
+  private:
+    class Session;
+    class Proxy;
+
+    // The session for `codec_settings`, opened and initialised if there is none. nullptr, with
+    // the encoder's error in `result`, if it could not be initialised.
+    std::shared_ptr<Session> Join(const webrtc::Environment &env,
+                                  const webrtc::SdpVideoFormat &format,
+                                  const webrtc::VideoCodec &codec_settings,
+                                  const webrtc::VideoEncoder::Settings &settings, int32_t &result);
+    // What the last session in `format` reported, for a proxy not in one yet.
+    webrtc::VideoEncoder::EncoderInfo LastEncoderInfo(const webrtc::SdpVideoFormat &format);
+
+    const Factory factory_;
+    const BroadcastBitrate policy_;
+    const bool fast_start_;
+    const KeyFrameScheduler::Options key_frame_options_;
+    std::mutex mtx_;
+    std::map<std::string, std::weak_ptr<Session>> sessions_;
+    std::map<std::string, webrtc::VideoEncoder::EncoderInfo> encoder_infos_;
+};
+
+#endif // BROADCAST_ENCODER_HUB_H_
@@ -26,13 +26,61 @@
 #endif
 #include "capturer/alsa_capturer.h"
 #include "capturer/pa_capturer.h"
+#include "capturer/synthetic_capturer.h"
 #include "capturer/v4l2_capturer.h"
 #include "common/jpeg_util.h"
 #include "common/logging.h"
+#include "common/thread_policy.h"
 #include "recorder/media_query.h"
 #include "rtc/custom_video_encoder_factory.h"
+#include "track/encoded_track_source.h"
 #include "track/v4l2dma_track_source.h"
 
+namespace {
+
+std::vector<webrtc::RtpEncodingParameters>
+CreateSimulcastEncodings(const std::vector<SimulcastLayer> &layers) {
+    // Named low to high, the way SFUs expect their rids.
+    static const char *const kRids[] = {"q", "h", "f"};
+    const size_t first_rid = std::size(kRids) - layers.size();
+
+    std::vector<webrtc::RtpEncodingParameters> encodings;
+    for (size_t i = 0; i < layers.size(); i++) {
+        webrtc::RtpEncodingParameters encoding;
+        encoding.rid = kRids[first_rid + i];
+        encoding.scale_resolution_down_by = layers[i].scale_down;
+        encoding.max_bitrate_bps = layers[i].max_kbps * 1000;
+        encodings.push_back(encoding);
+    }
+    return encodings;
+}
+
+std::shared_ptr<VideoCapturer> CreateVideoCapturer(const Args &args) {
+    if (args.camera_source == CameraSource::V4L2) {
+        INFO_PRINT("Camera: Use v4l2 capturer.");
+        return V4L2Capturer::Create(args);
+    } else if (args.camera_source == CameraSource::File ||
+               args.camera_source == CameraSource::Pattern) {
+        INFO_PRINT("Camera: Use synthetic capturer.");
+        return SyntheticCapturer::Create(args);
+    }
+#if defined(USE_LIBCAMERA_CAPTURE)
+    else if (args.camera_source == CameraSource::LibCamera) {
+        INFO_PRINT("Camera: Use libcamera capturer.");
+        return LibcameraCapturer::Create(args);
+    }
+#elif defined(USE_LIBARGUS_CAPTURE)
+    else if (args.camera_source == CameraSource::LibArgus) {
+        INFO_PRINT("Camera: Use libargus capturer.");
+        return LibargusCapturer::Create(args);
+    }
+#endif
+    ERROR_PRINT("Capturer is undefined.");
+    return nullptr;
+}
+
+} // namespace
+
 std::shared_ptr<Conductor> Conductor::Create(Args args) {
     auto ptr = std::make_shared<Conductor>(args);
     ptr->InitializePeerConnectionFactory();
@@ -49,8 +97,7 @@ Conductor::~Conductor() {
         ipc_server_->Stop();
     }
     audio_track_ = nullptr;
-    video_track_ = nullptr;
-    video_capture_source_ = nullptr;
+    cameras_.clear();
     peer_connection_factory_ = nullptr;
     adm_ = nullptr;
 
@@ -64,7 +111,28 @@ Args Conductor::config() const { return args; }
 
 std::shared_ptr<AudioCapturer> Conductor::AudioSource() const { return audio_capture_source_; }
 
-std::shared_ptr<VideoCapturer> Conductor::VideoSource() const { return video_capture_source_; }
+int Conductor::CameraCount() const { return static_cast<int>(cameras_.size()); }
+
+Args Conductor::CameraConfig(int camera_idx) const { return cameras_[camera_idx].args; }
+
+std::shared_ptr<VideoCapturer> Conductor::VideoSource(int camera_idx) const {
+    if (camera_idx < 0 || camera_idx >= CameraCount()) {
+        return nullptr;
+    }
+    return cameras_[camera_idx].capture_source;
+}
+
+std::shared_ptr<EncodedSource> Conductor::EncodedVideoSource(int camera_idx) const {
+    if (camera_idx < 0 || camera_idx >= CameraCount()) {
+        return nullptr;
+    }
+    const Camera &camera = cameras_[camera_idx];
+    // A passed-through main stream is no use to a recorder of the sub stream.
+    if (!args.shared_encoder && camera.args.record_stream_idx != 0) {
+        return nullptr;
+    }
+    return camera.shared_encoder;
+}
 
 void Conductor::InitializeTracks() {
     if (!audio_track_ && !args.no_audio) {
@@ -91,37 +159,48 @@ void Conductor::InitializeTracks() {
         audio_track_ = peer_connection_factory_->CreateAudioTrack("audio_track", options.get());
     }
 
-    if (!video_track_ && !args.camera.empty()) {
-        video_capture_source_ = ([this]() -> std::shared_ptr<VideoCapturer> {
-            if (args.camera_source == CameraSource::V4L2) {
-                INFO_PRINT("Camera: Use v4l2 capturer.");
-                return V4L2Capturer::Create(args);
+    if (cameras_.empty()) {
+        // One capturer, track source and track per camera, all on this factory's threads.
+        const std::vector<Args> camera_list =
+            args.cameras.empty() ? std::vector<Args>{args} : args.cameras;
+        for (const Args &camera_args : camera_list) {
+            Camera camera;
+            camera.args = camera_args;
+            if (!camera_args.camera.empty()) {
+                camera.capture_source = CreateVideoCapturer(camera_args);
             }
-#if defined(USE_LIBCAMERA_CAPTURE)
-            else if (args.camera_source == CameraSource::LibCamera) {
-                INFO_PRINT("Camera: Use libcamera capturer.");
-                return LibcameraCapturer::Create(args);
+            // The encoder factory is shared by all cameras, so this is all or nothing.
+            if (camera.capture_source && args.shared_encoder) {
+                camera.shared_encoder =
+                    SharedH264Encoder::Create(camera.capture_source, camera_args);
+            } else if (camera.capture_source && camera_args.webrtc && ForwardsEncodedVideo(args)) {
+                // The camera's own main stream, passed through.
+                Args main_stream_args = camera_args;
+                main_stream_args.record_stream_idx = 0;
+                camera.shared_encoder =
+                    SharedH264Encoder::Create(camera.capture_source, main_stream_args);
             }
-#elif defined(USE_LIBARGUS_CAPTURE)
-            else if (args.camera_source == CameraSource::LibArgus) {
-                INFO_PRINT("Camera: Use libargus capturer.");
-                return LibargusCapturer::Create(args);
-            }
-#endif
-            ERROR_PRINT("Capturer is undefined.");
-            return nullptr;
-        })();
 
-        video_track_source_ = ([this]() -> webrtc::scoped_refptr<ScaleTrackSource> {
-            if (args.hw_accel) {
-                return V4L2DmaTrackSource::Create(video_capture_source_);
-            } else {
-                return ScaleTrackSource::Create(video_capture_source_);
+            if (camera.capture_source && camera_args.webrtc) {
+                camera.track_source = ([&camera]() -> webrtc::scoped_refptr<ScaleTrackSource> {
+                    if (camera.shared_encoder) {
+                        return EncodedTrackSource::Create(camera.capture_source,
+                                                          camera.shared_encoder);
+                    } else if (camera.args.hw_accel) {
+                        return V4L2DmaTrackSource::Create(camera.capture_source);
+                    } else {
+                        return ScaleTrackSource::Create(camera.capture_source);
+                    }
+                })();
+
+                const std::string track_id = camera_args.alias.empty()
+                                                 ? "video_track"
+                                                 : "video_track_" + camera_args.alias;
+                camera.track =
+                    peer_connection_factory_->CreateVideoTrack(camera.track_source, track_id);
             }
-        })();
-
-        video_track_ =
-            peer_connection_factory_->CreateVideoTrack(video_track_source_, "video_track");
+            cameras_.push_back(std::move(camera));
+        }
     }
 }
 
@@ -148,7 +227,8 @@ void Conductor::ApplyBitrateSettings(
     }
 }
 
-void Conductor::AddTracks(webrtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection) {
+void Conductor::AddTracks(webrtc::scoped_refptr<RtcPeer> peer) {
+    auto peer_connection = peer->GetPeer();
     if (!peer_connection->GetSenders().empty()) {
         DEBUG_PRINT("Already add tracks.");
         return;
@@ -161,17 +241,42 @@ void Conductor::AddTracks(webrtc::scoped_refptr<webrtc::PeerConnectionInterface>
         }
     }
 
-    if (video_track_) {
-        auto video_res = peer_connection->AddTrack(video_track_, {args.uid});
-        if (!video_res.ok()) {
-            ERROR_PRINT("Failed to add video track, %s", video_res.error().message());
+    const std::vector<std::string> &wanted = peer->cameras();
+    for (const auto &camera : cameras_) {
+        if (!camera.track || (!wanted.empty() && std::find(wanted.begin(), wanted.end(),
+                                                           camera.args.alias) == wanted.end())) {
+            continue;
+        }
+
+        // Only an SFU can forward a layer per viewer; a direct peer would get the largest one
+        // and the encoder would spend the rest for nothing.
+        const bool simulcast = peer->isSfuPeer() && !camera.args.simulcast_layers.empty();
+        webrtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender_;
+        if (simulcast) {
+            webrtc::RtpTransceiverInit init;
+            init.stream_ids = {args.uid};
+            init.send_encodings = CreateSimulcastEncodings(camera.args.simulcast_layers);
+            auto transceiver_res = peer_connection->AddTransceiver(camera.track, init);
+            if (!transceiver_res.ok()) {
+                ERROR_PRINT("Failed to add simulcast video track %s, %s",
+                            camera.track->id().c_str(), transceiver_res.error().message());
+                continue;
+            }
+            video_sender_ = transceiver_res.value()->sender();
+        } else {
+            auto video_res = peer_connection->AddTrack(camera.track, {args.uid});
+            if (!video_res.ok()) {
+                ERROR_PRINT("Failed to add video track %s, %s", camera.track->id().c_str(),
+                            video_res.error().message());
+                continue;
+            }
+            video_sender_ = video_res.value();
         }
 
-        auto video_sender_ = video_res.value();
         webrtc::RtpParameters parameters = video_sender_->GetParameters();
         parameters.degradation_preference = webrtc::DegradationPreference::MAINTAIN_FRAMERATE;
 
-        if (args.max_bitrate > 0 && !parameters.encodings.empty()) {
+        if (!simulcast && args.max_bitrate > 0 && !parameters.encodings.empty()) {
             parameters.encodings[0].max_bitrate_bps = args.max_bitrate * 1000;
         }
         video_sender_->SetParameters(parameters);
@@ -210,7 +315,7 @@ webrtc::scoped_refptr<RtcPeer> Conductor::CreatePeerConnection(PeerConfig config
     }
 
     if (!config.data_channel_only) {
-        AddTracks(peer->GetPeer());
+        AddTracks(peer);
     }
 
     DEBUG_PRINT("Peer connection(%s) is created! ", peer->id().c_str());
@@ -218,7 +323,7 @@ webrtc::scoped_refptr<RtcPeer> Conductor::CreatePeerConnection(PeerConfig config
 }
 
 void Conductor::EnsureTracksAdded(webrtc::scoped_refptr<RtcPeer> peer) {
-    AddTracks(peer->GetPeer());
+    AddTracks(peer);
 }
 
 void Conductor::InitializeDataChannels(webrtc::scoped_refptr<RtcPeer> peer) {
@@ -292,11 +397,13 @@ void Conductor::InitializeCommandChannel(webrtc::scoped_refptr<RtcPeer> peer) {
         });
 
     cmd_channel->OnClosed([this]() {
-        auto recorder = ondemand_recorder_.lock();
-        if (recorder && recorder->is_recording()) {
-            DEBUG_PRINT("Peer disconnected: Auto-stop on-demand recording when peer disconnects "
-                        "(kFailed / kClosed)");
-            recorder->Stop();
+        for (auto &ondemand_recorder : ondemand_recorders_) {
+            auto recorder = ondemand_recorder.lock();
+            if (recorder && recorder->is_recording()) {
+                DEBUG_PRINT("Peer disconnected: Auto-stop on-demand recording when peer "
+                            "disconnects (kFailed / kClosed)");
+                recorder->Stop();
+            }
         }
     });
 }
@@ -305,10 +412,18 @@ void Conductor::TakeSnapshot(std::shared_ptr<RtcChannel> datachannel, const prot
     try {
         auto quality = std::clamp(pkt.take_snapshot_request().quality(), 0u, 100u);
 
-        auto i420buff = video_capture_source_->GetI420Frame(args.live_stream_idx);
-        auto jpg_buffer = jpeg_util::ConvertYuvToJpeg(
-            i420buff->DataY(), video_capture_source_->width(args.live_stream_idx),
-            video_capture_source_->height(args.live_stream_idx), quality);
+        // The request names no camera, so snapshots come from the first one.
+        auto video_source = VideoSource();
+        if (!video_source) {
+            throw std::runtime_error("No camera available.");
+        }
+        auto i420buff = video_source->GetI420Frame(cameras_.front().args.live_stream_idx);
+        if (!i420buff) {
+            ERROR_PRINT("No frame arrived for the snapshot.");
+            return;
+        }
+        auto jpg_buffer = jpeg_util::ConvertYuvToJpeg(i420buff->DataY(), i420buff->width(),
+                                                      i420buff->height(), quality);
         datachannel->Send(std::move(jpg_buffer));
     } catch (const std::exception &e) {
         ERROR_PRINT("%s", e.what());
@@ -321,7 +436,10 @@ void Conductor::QueryFile(std::shared_ptr<RtcChannel> datachannel, const protoco
         return;
     }
 
-    if (args.record_path.empty()) {
+    // With several cameras each records into its own subdirectory; queries read the first one.
+    const std::string record_path = cameras_.empty() ? args.record_path
+                                                     : cameras_.front().args.record_path;
+    if (record_path.empty()) {
         ERROR_PRINT("Recording path is not set, unable to query files.");
         return;
     }
@@ -330,7 +448,7 @@ void Conductor::QueryFile(std::shared_ptr<RtcChannel> datachannel, const protoco
     auto type = req.type();
     const bool is_timelapse = (req.mode() == protocol::VideoMode::TIMELAPSE);
     const std::string &parameter = req.parameter();
-    auto search_dir = is_timelapse ? args.record_path + "timelapse" : args.record_path;
+    auto search_dir = is_timelapse ? record_path + "timelapse" : record_path;
 
     DEBUG_PRINT("Received query request: mode=%s, type=%d, param=%s",
                 (is_timelapse ? "TIMELAPSE" : "RECORDING"), req.type(), parameter.c_str());
@@ -414,10 +532,11 @@ void Conductor::ControlCamera(std::shared_ptr<RtcChannel> datachannel,
     DEBUG_PRINT("parse meta cmd message => %d, %d", key, value);
 
     try {
-        if (!video_capture_source_) {
+        auto video_source = VideoSource();
+        if (!video_source) {
             throw std::runtime_error("No camera available.");
         }
-        if (!video_capture_source_->SetControls(key, value)) {
+        if (!video_source->SetControls(key, value)) {
             ERROR_PRINT("Failed to set key: %d to value: %d", key, value);
         }
     } catch (const std::exception &e) {
@@ -425,35 +544,57 @@ void Conductor::ControlCamera(std::shared_ptr<RtcChannel> datachannel,
     }
 }
 
-void Conductor::SetOnDemandRecorder(std::shared_ptr<RecorderManager> recorder) {
-    ondemand_recorder_ = recorder;
+void Conductor::AddOnDemandRecorder(std::shared_ptr<RecorderManager> recorder) {
+    ondemand_recorders_.push_back(recorder);
 }
 
 void Conductor::StartRecording(std::shared_ptr<RtcChannel> datachannel,
                                const protocol::Packet &pkt) {
-    auto recorder = ondemand_recorder_.lock();
-    if (!recorder) {
+    // Every camera starts together; the response carries the first camera's file.
+    std::string filepath;
+    bool started = false;
+    for (auto &ondemand_recorder : ondemand_recorders_) {
+        auto recorder = ondemand_recorder.lock();
+        if (!recorder) {
+            continue;
+        }
+        recorder->Start();
+        if (!started) {
+            filepath = recorder->current_filepath();
+            started = true;
+        }
+    }
+    if (!started) {
         ERROR_PRINT("On-demand recorder is not set.");
         return;
     }
-    recorder->Start();
     DEBUG_PRINT("On-demand recording started.");
 
     protocol::RecordingResponse resp;
     resp.set_is_recording(true);
-    resp.set_filepath(recorder->current_filepath());
+    resp.set_filepath(filepath);
     datachannel->Send(resp);
 }
 
 void Conductor::StopRecording(std::shared_ptr<RtcChannel> datachannel,
                               const protocol::Packet &pkt) {
-    auto recorder = ondemand_recorder_.lock();
-    if (!recorder) {
+    std::string filepath;
+    bool stopped = false;
+    for (auto &ondemand_recorder : ondemand_recorders_) {
+        auto recorder = ondemand_recorder.lock();
+        if (!recorder) {
+            continue;
+        }
+        if (!stopped) {
+            filepath = recorder->current_filepath();
+            stopped = true;
+        }
+        recorder->Stop();
+    }
+    if (!stopped) {
         ERROR_PRINT("On-demand recorder is not set.");
         return;
     }
-    const std::string filepath = recorder->current_filepath();
-    recorder->Stop();
     DEBUG_PRINT("On-demand recording stopped.");
 
     protocol::RecordingResponse resp;
@@ -469,11 +610,21 @@ void Conductor::InitializePeerConnectionFactory() {
     worker_thread_ = webrtc::Thread::Create();
     signaling_thread_ = webrtc::Thread::Create();
 
-    for (auto *thread : {network_thread_.get(), worker_thread_.get(), signaling_thread_.get()}) {
+    // Named so --thread-policy can keep them off the cores the capture and encode threads use.
+    const std::pair<webrtc::Thread *, const char *> threads[] = {
+        {network_thread_.get(), "webrtc network"},
+        {worker_thread_.get(), "webrtc worker"},
+        {signaling_thread_.get(), "webrtc signaling"},
+    };
+    for (auto [thread, name] : threads) {
+        thread->SetName(name, nullptr);
         if (!thread->Start()) {
             ERROR_PRINT("Thread start failed!");
             std::exit(EXIT_FAILURE);
         }
+        thread->BlockingCall([name]() {
+            thread_policy::Apply(name);
+        });
     }
 
     webrtc::Environment env = webrtc::CreateEnvironment();
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <api/peer_connection_interface.h>
 #include <rtc_base/thread.h>
@@ -14,6 +15,7 @@
 #include "capturer/audio_capturer.h"
 #include "capturer/video_capturer.h"
 #include "recorder/recorder_manager.h"
+#include "recorder/shared_h264_encoder.h"
 #include "rtc/audio_device_bridge.h"
 #include "rtc/rtc_peer.h"
 #include "track/scale_track_source.h"
@@ -28,11 +30,26 @@ class Conductor {
     Args config() const;
     webrtc::scoped_refptr<RtcPeer> CreatePeerConnection(PeerConfig peer_config);
     std::shared_ptr<AudioCapturer> AudioSource() const;
-    std::shared_ptr<VideoCapturer> VideoSource() const;
+    // Cameras are numbered in the order of the `cameras:` list; without one there is a single
+    // camera configured by the flat options.
+    int CameraCount() const;
+    Args CameraConfig(int camera_idx) const;
+    std::shared_ptr<VideoCapturer> VideoSource(int camera_idx = 0) const;
+    // The camera's shared H.264 stream for its recorders, with --shared-encoder or when the
+    // camera's own is forwarded to WebRTC, otherwise nullptr.
+    std::shared_ptr<EncodedSource> EncodedVideoSource(int camera_idx = 0) const;
     void EnsureTracksAdded(webrtc::scoped_refptr<RtcPeer> peer);
-    void SetOnDemandRecorder(std::shared_ptr<RecorderManager> recorder);
+    void AddOnDemandRecorder(std::shared_ptr<RecorderManager> recorder);
 
   private:
+    struct Camera {
+        Args args;
+        std::shared_ptr<VideoCapturer> capture_source;
+        std::shared_ptr<SharedH264Encoder> shared_encoder;
+        webrtc::scoped_refptr<ScaleTrackSource> track_source;
+        webrtc::scoped_refptr<webrtc::VideoTrackInterface> track;
+    };
+
     Args args;
 
     void InitializePeerConnectionFactory();
@@ -47,7 +64,7 @@ class Conductor {
 
     void
     ApplyBitrateSettings(webrtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection);
-    void AddTracks(webrtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection);
+    void AddTracks(webrtc::scoped_refptr<RtcPeer> peer);
     void TakeSnapshot(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void QueryFile(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void TransferFile(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
@@ -63,15 +80,13 @@ class Conductor {
 
     bool use_alsa_audio_capture_ = false;
     std::shared_ptr<AudioCapturer> audio_capture_source_;
-    std::shared_ptr<VideoCapturer> video_capture_source_;
     webrtc::scoped_refptr<AudioDeviceBridge> adm_;
     webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> peer_connection_factory_;
     webrtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track_;
-    webrtc::scoped_refptr<webrtc::VideoTrackInterface> video_track_;
-    webrtc::scoped_refptr<ScaleTrackSource> video_track_source_;
+    std::vector<Camera> cameras_;
 
     std::shared_ptr<UnixSocketServer> ipc_server_;
-    std::weak_ptr<RecorderManager> ondemand_recorder_;
+    std::vector<std::weak_ptr<RecorderManager>> ondemand_recorders_;
 };
 
 #endif // CONDUCTOR_H_
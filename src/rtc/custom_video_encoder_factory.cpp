@@ -1,6 +1,6 @@
 #include "rtc/custom_video_encoder_factory.h"
 
-#include "common/latency_tracer.h"
+#include "rtc/h264_passthrough_encoder.h"
 #include "rtc/tracing_video_encoder.h"
 
 #if defined(USE_RPI_HW_ENCODER)
@@ -9,22 +9,114 @@
 #include "codecs/jetson/jetson_video_encoder.h"
 #endif
 
+#include <linux/videodev2.h>
+
 #include <absl/strings/match.h>
 #include <media/base/media_constants.h>
+#include <media/engine/simulcast_encoder_adapter.h>
 #include <modules/video_coding/codecs/av1/av1_svc_config.h>
 #include <modules/video_coding/codecs/av1/libaom_av1_encoder.h>
 #include <modules/video_coding/codecs/h264/include/h264.h>
 #include <modules/video_coding/codecs/vp8/include/vp8.h>
 #include <modules/video_coding/codecs/vp9/include/vp9.h>
 
+namespace {
+
+bool WantsSimulcast(const Args &args) {
+    // A forwarded stream has a single layer.
+    if (ForwardsEncodedVideo(args)) {
+        return false;
+    }
+    if (!args.simulcast_layers.empty()) {
+        return true;
+    }
+    for (const auto &camera : args.cameras) {
+        if (!camera.simulcast_layers.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IsSimulcastCodec(const webrtc::SdpVideoFormat &format) {
+    return absl::EqualsIgnoreCase(format.name, webrtc::kVp8CodecName) ||
+           absl::EqualsIgnoreCase(format.name, webrtc::kH264CodecName);
+}
+
+} // namespace
+
 std::unique_ptr<webrtc::VideoEncoderFactory> CreateCustomVideoEncoderFactory(const Args &args) {
     return std::make_unique<CustomVideoEncoderFactory>(args);
 }
 
+bool ForwardsEncodedVideo(const Args &args) {
+    if (args.shared_encoder) {
+        return true;
+    }
+    const std::vector<Args> camera_list =
+        args.cameras.empty() ? std::vector<Args>{args} : args.cameras;
+    bool any_streamed = false;
+    for (const auto &camera : camera_list) {
+        if (camera.camera.empty() || !camera.webrtc) {
+            continue;
+        }
+        if (camera.camera_source != CameraSource::V4L2 || camera.format != V4L2_PIX_FMT_H264 ||
+            !camera.hw_accel || camera.live_stream_idx != 0) {
+            return false;
+        }
+        any_streamed = true;
+    }
+    return any_streamed;
+}
+
+class CustomVideoEncoderFactory::LayerFactory : public webrtc::VideoEncoderFactory {
+  public:
+    explicit LayerFactory(CustomVideoEncoderFactory *parent)
+        : parent_(parent) {}
+
+    std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override {
+        return parent_->GetSupportedFormats();
+    }
+
+    std::unique_ptr<webrtc::VideoEncoder> Create(const webrtc::Environment &env,
+                                                 const webrtc::SdpVideoFormat &format) override {
+        return parent_->CreateEncoder(env, format);
+    }
+
+  private:
+    CustomVideoEncoderFactory *parent_;
+};
+
+CustomVideoEncoderFactory::CustomVideoEncoderFactory(const Args &args)
+    : args_(args),
+      forwards_encoded_(ForwardsEncodedVideo(args)),
+      simulcast_(WantsSimulcast(args)),
+      layer_factory_(std::make_unique<LayerFactory>(this)) {
+    if (args_.broadcast_encoder) {
+        broadcast_hub_ = BroadcastEncoderHub::Create(
+            [this](const webrtc::Environment &env, const webrtc::SdpVideoFormat &format) {
+                return CreateTracedEncoder(env, format);
+            },
+            args_);
+    }
+}
+
+CustomVideoEncoderFactory::~CustomVideoEncoderFactory() = default;
+
 std::vector<webrtc::SdpVideoFormat> CustomVideoEncoderFactory::GetSupportedFormats() const {
     std::vector<webrtc::SdpVideoFormat> supported_codecs;
 
-    if (args_.hw_accel) {
+    if (forwards_encoded_) {
+        // What the shared encoder and the cameras are set to produce.
+        supported_codecs.push_back(CreateH264Format(
+            webrtc::H264Profile::kProfileConstrainedBaseline, webrtc::H264Level::kLevel4, "1"));
+        supported_codecs.push_back(CreateH264Format(
+            webrtc::H264Profile::kProfileConstrainedBaseline, webrtc::H264Level::kLevel4, "0"));
+        supported_codecs.push_back(CreateH264Format(webrtc::H264Profile::kProfileBaseline,
+                                                    webrtc::H264Level::kLevel4, "1"));
+        supported_codecs.push_back(CreateH264Format(webrtc::H264Profile::kProfileBaseline,
+                                                    webrtc::H264Level::kLevel4, "0"));
+    } else if (args_.hw_accel) {
 #if defined(USE_RPI_HW_ENCODER)
         // hw h264
         supported_codecs.push_back(CreateH264Format(
@@ -51,6 +143,11 @@ std::vector<webrtc::SdpVideoFormat> CustomVideoEncoderFactory::GetSupportedForma
             webrtc::SdpVideoFormat(webrtc::kAv1CodecName, webrtc::CodecParameterMap(),
                                    webrtc::LibaomAv1EncoderSupportedScalabilityModes()));
 #endif
+    } else if (simulcast_) {
+        supported_codecs.push_back(webrtc::SdpVideoFormat(webrtc::kVp8CodecName));
+        auto supported_h264_formats = webrtc::SupportedH264Codecs(true);
+        supported_codecs.insert(supported_codecs.end(), std::begin(supported_h264_formats),
+                                std::end(supported_h264_formats));
     } else {
         // vp8
         supported_codecs.push_back(webrtc::SdpVideoFormat(webrtc::kVp8CodecName));
@@ -74,17 +171,34 @@ std::vector<webrtc::SdpVideoFormat> CustomVideoEncoderFactory::GetSupportedForma
 std::unique_ptr<webrtc::VideoEncoder>
 CustomVideoEncoderFactory::Create(const webrtc::Environment &env,
                                   const webrtc::SdpVideoFormat &format) {
-    auto encoder = CreateEncoder(env, format);
+    if (broadcast_hub_) {
+        return broadcast_hub_->CreateEncoder(env, format);
+    }
+    return CreateTracedEncoder(env, format);
+}
 
-    if (latency::Enabled()) {
-        return CreateTracingVideoEncoder(std::move(encoder));
+std::unique_ptr<webrtc::VideoEncoder>
+CustomVideoEncoderFactory::CreateTracedEncoder(const webrtc::Environment &env,
+                                               const webrtc::SdpVideoFormat &format) {
+    // The adapter passes a single encoding straight through to one encoder, so a peer that did
+    // not negotiate simulcast costs nothing extra.
+    if (simulcast_ && !args_.hw_accel && IsSimulcastCodec(format)) {
+        return CreateTracingVideoEncoder(std::make_unique<webrtc::SimulcastEncoderAdapter>(
+            env, layer_factory_.get(), nullptr, format));
     }
-    return encoder;
+    return CreateTracingVideoEncoder(CreateEncoder(env, format));
 }
 
 std::unique_ptr<webrtc::VideoEncoder>
 CustomVideoEncoderFactory::CreateEncoder(const webrtc::Environment &env,
                                          const webrtc::SdpVideoFormat &format) {
+    if (forwards_encoded_) {
+        if (absl::EqualsIgnoreCase(format.name, webrtc::kH264CodecName)) {
+            return H264PassthroughEncoder::Create();
+        }
+        return nullptr;
+    }
+
 #if defined(USE_JETSON_HW_ENCODER)
     if (args_.hw_accel) {
         return JetsonVideoEncoder::Create(args_);
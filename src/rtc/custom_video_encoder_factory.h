@@ -5,14 +5,25 @@
 #include <api/video_codecs/video_encoder_factory.h>
 
 #include "args.h"
+#include "rtc/broadcast_encoder_hub.h"
 
 std::unique_ptr<webrtc::VideoEncoderFactory> CreateCustomVideoEncoderFactory(const Args &args);
 
+// Whether the tracks carry H.264 that the encoders only forward: with --shared-encoder, or when
+// every streamed camera delivers H.264 on its main stream under --hw-accel. The factory serves all
+// cameras, so one that does not turns it off for the rest.
+bool ForwardsEncodedVideo(const Args &args);
+
+// With --simulcast, VP8 and H.264 encoders come wrapped in WebRTC's SimulcastEncoderAdapter,
+// which runs one encoder per layer. VP9 and AV1 are not offered then.
+//
+// When ForwardsEncodedVideo(), the tracks are already H.264 and every encoder only forwards them.
+//
+// With --broadcast-encoder, every peer's encoder is a proxy onto one shared by all of them.
 class CustomVideoEncoderFactory : public webrtc::VideoEncoderFactory {
   public:
-    CustomVideoEncoderFactory(const Args &args)
-        : args_(args) {};
-    ~CustomVideoEncoderFactory() = default;
+    CustomVideoEncoderFactory(const Args &args);
+    ~CustomVideoEncoderFactory();
 
     std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
 
@@ -20,10 +31,19 @@ class CustomVideoEncoderFactory : public webrtc::VideoEncoderFactory {
                                                  const webrtc::SdpVideoFormat &format) override;
 
   private:
+    // Hands the simulcast adapter a plain encoder per layer.
+    class LayerFactory;
+
+    std::unique_ptr<webrtc::VideoEncoder> CreateTracedEncoder(const webrtc::Environment &env,
+                                                              const webrtc::SdpVideoFormat &format);
     std::unique_ptr<webrtc::VideoEncoder> CreateEncoder(const webrtc::Environment &env,
                                                         const webrtc::SdpVideoFormat &format);
 
     Args args_;
+    const bool forwards_encoded_;
+    const bool simulcast_;
+    std::unique_ptr<webrtc::VideoEncoderFactory> layer_factory_;
+    std::shared_ptr<BroadcastEncoderHub> broadcast_hub_;
 };
 
 #endif // CUSTOM_VIDEO_ENCODER_FACTORY_H_
@@ -0,0 +1,214 @@
+#include "rtc/h264_passthrough_encoder.h"
+
+#include "common/encoded_frame_buffer.h"
+#include "common/gop_cache.h"
+#include "common/key_frame_scheduler.h"
+#include "common/logging.h"
+
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+namespace {
+
+int64_t TimestampUs(const V4L2FrameBufferRef &buffer) {
+    const timeval timestamp = buffer->timestamp();
+    return static_cast<int64_t>(timestamp.tv_sec) * 1000000 + timestamp.tv_usec;
+}
+
+} // namespace
+
+std::unique_ptr<webrtc::VideoEncoder> H264PassthroughEncoder::Create() {
+    return std::make_unique<H264PassthroughEncoder>();
+}
+
+H264PassthroughEncoder::H264PassthroughEncoder()
+    : requester_(KeyFrameScheduler::NewRequesterId()),
+      bitrate_bps_(0),
+      rate_pending_(false),
+      key_frame_sent_(false),
+      resyncing_(false),
+      last_sequence_(0),
+      replay_budget_(0),
+      callback_(nullptr) {}
+
+H264PassthroughEncoder::~H264PassthroughEncoder() { Release(); }
+
+int32_t H264PassthroughEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                           const VideoEncoder::Settings &settings) {
+    if (codec_settings->codecType != webrtc::kVideoCodecH264) {
+        return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+
+    encoded_image_.timing_.flags = webrtc::VideoSendTiming::TimingFrameFlags::kInvalid;
+    encoded_image_.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
+    key_frame_sent_ = false;
+    resyncing_ = false;
+    replay_budget_ = GopReplayBudget(codec_settings->startBitrate);
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t
+H264PassthroughEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) {
+    callback_ = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t H264PassthroughEncoder::Release() {
+    if (auto source = rate_source_.lock()) {
+        source->SetBitrate(requester_, 0);
+    }
+    rate_source_.reset();
+    key_frame_sent_ = false;
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t H264PassthroughEncoder::Encode(const webrtc::VideoFrame &frame,
+                                       const std::vector<webrtc::VideoFrameType> *frame_types) {
+    if (!frame_types || !callback_) {
+        return WEBRTC_VIDEO_CODEC_NO_OUTPUT;
+    }
+
+    if ((*frame_types)[0] == webrtc::VideoFrameType::kEmptyFrame) {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    auto frame_buffer = frame.video_frame_buffer();
+    if (frame_buffer->type() != webrtc::VideoFrameBuffer::Type::kNative) {
+        return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+    }
+
+    // Only an EncodedTrackSource feeds this encoder, see CustomVideoEncoderFactory.
+    auto encoded_frame_buffer = static_cast<EncodedFrameBuffer *>(frame_buffer.get());
+    auto source = encoded_frame_buffer->source();
+    const auto &buffer = encoded_frame_buffer->frame_buffer();
+    const bool is_key_frame = buffer->flags() & V4L2_BUF_FLAG_KEYFRAME;
+
+    bool key_frame_requested = (*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey;
+    const uint64_t sequence = encoded_frame_buffer->sequence();
+    if (key_frame_sent_ && sequence != last_sequence_ + 1 && !is_key_frame) {
+        DEBUG_PRINT("%llu frame(s) were dropped before the passthrough encoder, waiting for a key "
+                    "frame.",
+                    static_cast<unsigned long long>(sequence - last_sequence_ - 1));
+        key_frame_sent_ = false;
+        resyncing_ = true;
+        key_frame_requested = true;
+    }
+    last_sequence_ = sequence;
+    if (is_key_frame) {
+        resyncing_ = false;
+    }
+
+    if (!key_frame_sent_ && !is_key_frame && !resyncing_ && source &&
+        SendCachedGop(frame, buffer, source->CachedGop())) {
+        key_frame_sent_ = true;
+        // That was this peer's first request, and the cache has answered it.
+        key_frame_requested = false;
+    }
+
+    if (source) {
+        if (rate_pending_) {
+            source->SetBitrate(requester_, bitrate_bps_);
+            rate_source_ = source;
+            rate_pending_ = false;
+        }
+        if (key_frame_requested && !is_key_frame) {
+            source->ForceKeyFrame(requester_);
+        }
+    }
+
+    if (!key_frame_sent_ && !is_key_frame) {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    key_frame_sent_ = true;
+
+    Send(frame, buffer, 0);
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+bool H264PassthroughEncoder::SendCachedGop(const webrtc::VideoFrame &frame,
+                                           const V4L2FrameBufferRef &current,
+                                           const std::vector<V4L2FrameBufferRef> &frames) {
+    // The current frame may already be the newest in the cache; it is sent as usual after.
+    const int64_t current_us = TimestampUs(current);
+    if (frames.empty() || TimestampUs(frames.front()) >= current_us) {
+        return false;
+    }
+    size_t bytes = 0;
+    for (const auto &cached : frames) {
+        if (TimestampUs(cached) >= current_us) {
+            break;
+        }
+        bytes += cached->size();
+    }
+    const int64_t span_us = current_us - TimestampUs(frames.front());
+    if (bytes > replay_budget_ || span_us > kMaxGopReplayUs) {
+        DEBUG_PRINT("Not sending %zu bytes of cached frames over %lld ms to a new peer.", bytes,
+                    static_cast<long long>(span_us / 1000));
+        return false;
+    }
+    size_t sent = 0;
+    for (const auto &cached : frames) {
+        const int64_t age_us = current_us - TimestampUs(cached);
+        if (age_us <= 0) {
+            break;
+        }
+        Send(frame, cached, age_us);
+        sent++;
+    }
+    DEBUG_PRINT("Sent %zu cached frame(s) to a new peer.", sent);
+    return true;
+}
+
+void H264PassthroughEncoder::Send(const webrtc::VideoFrame &frame, const V4L2FrameBufferRef &buffer,
+                                  int64_t age_us) {
+    auto encoded_image_buffer =
+        webrtc::EncodedImageBuffer::Create(static_cast<const uint8_t *>(buffer->Data()),
+                                           buffer->size());
+
+    webrtc::CodecSpecificInfo codec_specific;
+    codec_specific.codecType = webrtc::kVideoCodecH264;
+    codec_specific.codecSpecific.H264.packetization_mode =
+        webrtc::H264PacketizationMode::NonInterleaved;
+
+    // A cached frame goes out on the current frame's clock, as far behind it as it was captured.
+    encoded_image_.SetEncodedData(encoded_image_buffer);
+    encoded_image_.SetRtpTimestamp(frame.rtp_timestamp() -
+                                   static_cast<uint32_t>(age_us * 90 / 1000));
+    encoded_image_.SetColorSpace(frame.color_space());
+    encoded_image_._encodedWidth = buffer->width();
+    encoded_image_._encodedHeight = buffer->height();
+    encoded_image_.capture_time_ms_ = frame.render_time_ms() - age_us / 1000;
+    encoded_image_.ntp_time_ms_ = frame.ntp_time_ms() > 0 ? frame.ntp_time_ms() - age_us / 1000
+                                                          : frame.ntp_time_ms();
+    encoded_image_.rotation_ = frame.rotation();
+    encoded_image_._frameType = buffer->flags() & V4L2_BUF_FLAG_KEYFRAME
+                                    ? webrtc::VideoFrameType::kVideoFrameKey
+                                    : webrtc::VideoFrameType::kVideoFrameDelta;
+
+    auto result = callback_->OnEncodedImage(encoded_image_, &codec_specific);
+    if (result.error != webrtc::EncodedImageCallback::Result::OK) {
+        ERROR_PRINT("Failed to send the frame => %d", result.error);
+    }
+}
+
+void H264PassthroughEncoder::SetRates(const RateControlParameters &parameters) {
+    // Straight to the source once it is known, and otherwise with the next frame, which is where
+    // this encoder first learns it. A zero rate, a paused peer, leaves the source to the others.
+    bitrate_bps_ = parameters.bitrate.get_sum_bps();
+    if (auto source = rate_source_.lock()) {
+        source->SetBitrate(requester_, bitrate_bps_);
+        return;
+    }
+    rate_pending_ = true;
+}
+
+webrtc::VideoEncoder::EncoderInfo H264PassthroughEncoder::GetEncoderInfo() const {
+    EncoderInfo info;
+    info.supports_native_handle = true;
+    info.has_trusted_rate_controller = true;
+    info.scaling_settings = VideoEncoder::ScalingSettings::kOff;
+    info.implementation_name = "H264 Passthrough";
+    return info;
+}
@@ -0,0 +1,58 @@
+#ifndef H264_PASSTHROUGH_ENCODER_H_
+#define H264_PASSTHROUGH_ENCODER_H_
+
+#include <memory>
+
+#include <api/video_codecs/video_encoder.h>
+
+#include "common/interface/encoded_source.h"
+#include "common/v4l2_frame_buffer.h"
+
+// The "encoder" of an EncodedTrackSource track: the frames are EncodedFrameBuffers already in
+// H.264, so each is sent as it is. Key frame requests and the target rate are passed on to the
+// source the frame came from.
+//
+// Until the source delivers a key frame, nothing is sent, so a peer never starts on a delta. A
+// source that keeps its current GOP has it sent first instead, and the key frame a new peer asks
+// for is not forced on everyone else watching, unless the GOP is too large to send at once.
+//
+// The VideoStreamEncoder drops frames when it falls behind or is paused, and a delta sent after
+// one of those refers to a frame the peer never got. A gap in the track's frame sequence therefore
+// stops the stream until the next key frame, and asks the source for one.
+class H264PassthroughEncoder : public webrtc::VideoEncoder {
+  public:
+    static std::unique_ptr<webrtc::VideoEncoder> Create();
+    H264PassthroughEncoder();
+    ~H264PassthroughEncoder() override;
+
+    int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+                       const VideoEncoder::Settings &settings) override;
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override;
+    int32_t Release() override;
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types) override;
+    void SetRates(const RateControlParameters &parameters) override;
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override;
+
+  private:
+    // Who this peer's key frame requests and rate are counted for at the source.
+    const int requester_;
+    // The source last given this peer's rate, which takes it back on Release().
+    std::weak_ptr<EncodedSource> rate_source_;
+    int bitrate_bps_;
+    bool rate_pending_;
+    bool key_frame_sent_;
+    // Waiting for a key frame after a gap: the cached GOP would repeat frames already sent.
+    bool resyncing_;
+    uint64_t last_sequence_;
+    size_t replay_budget_;
+    webrtc::EncodedImage encoded_image_;
+    webrtc::EncodedImageCallback *callback_;
+
+    bool SendCachedGop(const webrtc::VideoFrame &frame, const V4L2FrameBufferRef &current,
+                       const std::vector<V4L2FrameBufferRef> &frames);
+    void Send(const webrtc::VideoFrame &frame, const V4L2FrameBufferRef &buffer,
+              int64_t age_us);
+};
+
+#endif // H264_PASSTHROUGH_ENCODER_H_
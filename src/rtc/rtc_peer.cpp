@@ -16,7 +16,8 @@ RtcPeer::RtcPeer(PeerConfig config)
       timeout_(config.timeout),
       is_sfu_peer_(config.is_sfu_peer),
       is_publisher_(config.is_publisher),
-      has_candidates_in_sdp_(config.has_candidates_in_sdp) {}
+      has_candidates_in_sdp_(config.has_candidates_in_sdp),
+      cameras_(config.cameras) {}
 
 RtcPeer::~RtcPeer() {
     Terminate();
@@ -79,6 +80,8 @@ bool RtcPeer::isSfuPeer() const { return is_sfu_peer_; }
 
 bool RtcPeer::isPublisher() const { return is_publisher_; }
 
+const std::vector<std::string> &RtcPeer::cameras() const { return cameras_; }
+
 bool RtcPeer::isConnected() const { return is_connected_.load(); }
 
 bool RtcPeer::isExpired() const { return is_expired_.load(); }
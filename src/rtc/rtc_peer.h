@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include <api/data_channel_interface.h>
@@ -41,6 +42,8 @@ struct PeerConfig : public webrtc::PeerConnectionInterface::RTCConfiguration {
     bool data_channel_only = false;
     // For SFUs whose data channels are not plain SCTP streams negotiated in the SDP.
     bool no_data_channels = false;
+    // Aliases of the cameras whose tracks the peer receives; empty for every camera.
+    std::vector<std::string> cameras;
 };
 
 class SetSessionDescription : public webrtc::SetSessionDescriptionObserver {
@@ -116,6 +119,7 @@ class RtcPeer : public webrtc::PeerConnectionObserver,
     bool isConnected() const;
     bool isExpired() const;
     std::string id() const;
+    const std::vector<std::string> &cameras() const;
 
     void SetSink(webrtc::VideoSinkInterface<webrtc::VideoFrame> *video_sink_obj);
     void SetPeer(webrtc::scoped_refptr<webrtc::PeerConnectionInterface> peer);
@@ -163,6 +167,7 @@ class RtcPeer : public webrtc::PeerConnectionObserver,
     bool is_sfu_peer_;
     bool is_publisher_;
     bool has_candidates_in_sdp_;
+    std::vector<std::string> cameras_;
     bool needs_renegotiation_ = false;
     std::atomic<bool> is_connected_ = false;
     std::atomic<bool> is_expired_ = false;
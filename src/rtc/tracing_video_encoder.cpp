@@ -3,6 +3,7 @@
 #include <utility>
 
 #include "common/latency_tracer.h"
+#include "common/thread_policy.h"
 
 #include <modules/video_coding/include/video_error_codes.h>
 
@@ -12,6 +13,9 @@ namespace {
 // frames went missing, so gaps beyond a few seconds of video are ignored instead of counted.
 constexpr uint32_t kMaxPlausibleGap = 1000;
 
+// --thread-policy name of the task queue each VideoStreamEncoder encodes on.
+const char kEncoderThreadName[] = "webrtc encoder";
+
 // Sits between the encoder and WebRTC so both ends of an asynchronous encode are visible from one
 // place: OnEncodedImage runs on the encoder's dequeue thread, long after Encode() returned.
 class TracingEncodedImageCallback : public webrtc::EncodedImageCallback {
@@ -67,6 +71,8 @@ class TracingVideoEncoder : public webrtc::VideoEncoder {
 
     int InitEncode(const webrtc::VideoCodec *codec_settings,
                    const VideoEncoder::Settings &settings) override {
+        // VideoStreamEncoder calls this on its encoder queue, the thread Encode() will run on.
+        thread_policy::Apply(kEncoderThreadName);
         return encoder_->InitEncode(codec_settings, settings);
     }
 
@@ -151,5 +157,8 @@ CreateTracingVideoEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder) {
     if (!encoder) {
         return nullptr;
     }
+    if (!latency::Enabled() && !thread_policy::Matches(kEncoderThreadName)) {
+        return encoder;
+    }
     return std::make_unique<TracingVideoEncoder>(std::move(encoder));
 }
@@ -12,6 +12,9 @@
 // It also wraps the registered EncodedImageCallback, which is what catches the asynchronous
 // hardware encoders: their Encode() returns immediately and the encoded frame arrives later on a
 // dequeue thread, so the only place both ends are visible is around the callback.
+//
+// The encoder queue is WebRTC's own thread, so this is also where a --thread-policy rule named
+// "webrtc encoder" is applied. The encoder is returned unwrapped when neither is in use.
 std::unique_ptr<webrtc::VideoEncoder>
 CreateTracingVideoEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder);
 
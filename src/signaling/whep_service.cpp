@@ -141,6 +141,7 @@ void HttpSession::HandlePostRequest() {
     if (content_type_ == "application/sdp") {
         PeerConfig config;
         config.has_candidates_in_sdp = true;
+        config.cameras = ParseCameras(std::string(req_.target().data(), req_.target().size()));
         auto peer = whep_service_->CreatePeer(config);
         if (!peer) {
             ResponseUnprocessableEntity("Failed to create the peer connection.");
@@ -302,6 +303,31 @@ std::vector<std::string> HttpSession::ParseRoutes(std::string target) {
     return routes;
 }
 
+// The camera aliases in a `?cameras=front,side` query, or none to receive every camera.
+std::vector<std::string> HttpSession::ParseCameras(std::string target) {
+    std::vector<std::string> cameras;
+    auto query_start = target.find('?');
+    if (query_start == std::string::npos) {
+        return cameras;
+    }
+
+    std::string param;
+    std::stringstream query(target.substr(query_start + 1));
+    while (std::getline(query, param, '&')) {
+        if (param.rfind("cameras=", 0) != 0) {
+            continue;
+        }
+        std::string alias;
+        std::stringstream aliases(param.substr(8));
+        while (std::getline(aliases, alias, ',')) {
+            if (!alias.empty()) {
+                cameras.push_back(alias);
+            }
+        }
+    }
+    return cameras;
+}
+
 IceCandidates HttpSession::ParseCandidates(const std::string &sdp) {
     std::regex midRegex(R"(a=mid:(\d+))");
     std::regex iceUfragRegex(R"(a=ice-ufrag:([^\s]+))");
@@ -84,6 +84,7 @@ class HttpSession : public std::enable_shared_from_this<HttpSession> {
     void SetCommonHeader(
         std::shared_ptr<boost::beast::http::response<boost::beast::http::string_body>> req);
     std::vector<std::string> ParseRoutes(std::string target);
+    std::vector<std::string> ParseCameras(std::string target);
     IceCandidates ParseCandidates(const std::string &sdp);
 };
 
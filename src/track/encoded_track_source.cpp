@@ -0,0 +1,54 @@
+#include "track/encoded_track_source.h"
+
+#include "common/encoded_frame_buffer.h"
+#include "common/latency_tracer.h"
+
+webrtc::scoped_refptr<EncodedTrackSource>
+EncodedTrackSource::Create(std::shared_ptr<VideoCapturer> capturer,
+                           std::shared_ptr<EncodedSource> source) {
+    auto obj =
+        webrtc::make_ref_counted<EncodedTrackSource>(std::move(capturer), std::move(source));
+    obj->StartTrack();
+    return obj;
+}
+
+EncodedTrackSource::EncodedTrackSource(std::shared_ptr<VideoCapturer> capturer,
+                                       std::shared_ptr<EncodedSource> source)
+    : ScaleTrackSource(std::move(capturer)),
+      source_(std::move(source)),
+      sequence_(0) {
+    width = source_->width();
+    height = source_->height();
+}
+
+void EncodedTrackSource::StartTrack() {
+    subscription_ = source_->Subscribe(
+        [this](const V4L2FrameBufferRef &frame_buffer) { OnEncodedFrame(frame_buffer); });
+}
+
+void EncodedTrackSource::OnEncodedFrame(const V4L2FrameBufferRef &frame_buffer) {
+    const int64_t timestamp_us = webrtc::TimeMicros();
+    const int64_t translated_timestamp_us =
+        timestamp_aligner.TranslateTimestamp(timestamp_us, webrtc::TimeMicros());
+
+    if (latency::Enabled()) {
+        latency::SetSourceResolution(width, height);
+        latency::SetSentResolution(width, height);
+        const int64_t sensor_us = latency::SensorUs(frame_buffer->timestamp());
+        if (sensor_us != 0) {
+            latency::Record(latency::Stage::kSensorToTrackIn, timestamp_us - sensor_us);
+            latency::MarkCapture(translated_timestamp_us, sensor_us);
+        }
+    }
+
+    // The frame waits in the encoder queue, well past this callback.
+    auto encoded = EncodedFrameBuffer::Create(
+        frame_buffer->IsRetainable() ? frame_buffer : frame_buffer->Clone(), source_,
+        ++sequence_);
+
+    OnFrame(webrtc::VideoFrame::Builder()
+                .set_video_frame_buffer(encoded)
+                .set_rotation(webrtc::kVideoRotation_0)
+                .set_timestamp_us(translated_timestamp_us)
+                .build());
+}
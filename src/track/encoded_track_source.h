@@ -0,0 +1,26 @@
+#ifndef ENCODED_TRACK_SOURCE_H_
+#define ENCODED_TRACK_SOURCE_H_
+
+#include "common/interface/encoded_source.h"
+#include "track/scale_track_source.h"
+
+// A track of an EncodedSource's access units, as EncodedFrameBuffers, for a passthrough encoder
+// to send as they are. Frames are never adapted: whatever size or rate a peer's bandwidth
+// estimate asks for, it gets the source's.
+class EncodedTrackSource : public ScaleTrackSource {
+  public:
+    static webrtc::scoped_refptr<EncodedTrackSource> Create(std::shared_ptr<VideoCapturer> capturer,
+                                                            std::shared_ptr<EncodedSource> source);
+    EncodedTrackSource(std::shared_ptr<VideoCapturer> capturer,
+                       std::shared_ptr<EncodedSource> source);
+    void StartTrack() override;
+
+  private:
+    const std::shared_ptr<EncodedSource> source_;
+    Subscription subscription_;
+    uint64_t sequence_;
+
+    void OnEncodedFrame(const V4L2FrameBufferRef &frame_buffer);
+};
+
+#endif // ENCODED_TRACK_SOURCE_H_
@@ -1,26 +1,8 @@
 #include "track/scale_track_source.h"
 
+#include "common/frame_scaler.h"
 #include "common/latency_tracer.h"
-#include "common/v4l2_frame_buffer.h"
-
-// WebRTC
-#include <api/video/i420_buffer.h>
-#include <third_party/libyuv/include/libyuv.h>
-
-static const int kBufferAlignment = 64;
-
-namespace {
-
-// Both capturers stamp the buffer with the sensor time, but only V4L2FrameBuffer carries it.
-int64_t SensorUsOf(const webrtc::scoped_refptr<webrtc::VideoFrameBuffer> &frame_buffer) {
-    if (!frame_buffer || frame_buffer->type() != webrtc::VideoFrameBuffer::Type::kNative) {
-        return 0;
-    }
-    auto *v4l2_buffer = static_cast<V4L2FrameBuffer *>(frame_buffer.get());
-    return latency::SensorUs(v4l2_buffer->timestamp());
-}
-
-} // namespace
+#include "common/layered_frame_buffer.h"
 
 webrtc::scoped_refptr<ScaleTrackSource>
 ScaleTrackSource::Create(std::shared_ptr<VideoCapturer> capturer) {
@@ -31,9 +13,10 @@ ScaleTrackSource::Create(std::shared_ptr<VideoCapturer> capturer) {
 
 ScaleTrackSource::ScaleTrackSource(std::shared_ptr<VideoCapturer> capturer)
     : capturer(capturer),
-      width(capturer->width()),
-      height(capturer->height()),
-      stream_idx(capturer->config().live_stream_idx) {}
+      width(capturer->width(capturer->config().live_stream_idx)),
+      height(capturer->height(capturer->config().live_stream_idx)),
+      stream_idx(capturer->config().live_stream_idx),
+      simulcast_(!capturer->config().simulcast_layers.empty()) {}
 
 ScaleTrackSource::~ScaleTrackSource() {
     // todo: tell capture unsubscribe observer.
@@ -41,20 +24,18 @@ ScaleTrackSource::~ScaleTrackSource() {
 
 void ScaleTrackSource::StartTrack() {
     subscription_ = capturer->Subscribe(
-        [this](webrtc::scoped_refptr<webrtc::VideoFrameBuffer> frame_buffer) {
-            OnFrameCaptured(frame_buffer);
-        },
+        "live",
+        [this](V4L2FrameBufferRef frame_buffer) { OnFrameCaptured(frame_buffer); },
         stream_idx);
 }
 
-void ScaleTrackSource::OnFrameCaptured(
-    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> frame_buffer) {
+void ScaleTrackSource::OnFrameCaptured(V4L2FrameBufferRef frame_buffer) {
     const int64_t timestamp_us = webrtc::TimeMicros();
     const int64_t translated_timestamp_us =
         timestamp_aligner.TranslateTimestamp(timestamp_us, webrtc::TimeMicros());
 
     const bool traced = latency::Enabled();
-    const int64_t sensor_us = traced ? SensorUsOf(frame_buffer) : 0;
+    const int64_t sensor_us = traced ? latency::SensorUs(frame_buffer->timestamp()) : 0;
     if (traced) {
         latency::SetSourceResolution(width, height);
     }
@@ -64,8 +45,9 @@ void ScaleTrackSource::OnFrameCaptured(
 
     int adapted_width, adapted_height, crop_width, crop_height, crop_x, crop_y;
     if (capturer->config().no_adaptive) {
-        adapted_width = width;
-        adapted_height = height;
+        adapted_width = crop_width = width;
+        adapted_height = crop_height = height;
+        crop_x = crop_y = 0;
     } else if (!AdaptFrame(width, height, timestamp_us, &adapted_width, &adapted_height,
                            &crop_width, &crop_height, &crop_x, &crop_y)) {
         if (traced) {
@@ -74,20 +56,28 @@ void ScaleTrackSource::OnFrameCaptured(
         return;
     }
 
-    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> dst_buffer = frame_buffer;
+    V4L2FrameBufferRef dst_buffer = frame_buffer;
 
-    if (adapted_width != width || adapted_height != height) {
+    if (adapted_width != width || adapted_height != height || crop_width != width ||
+        crop_height != height) {
         const int64_t scale_start_us = traced ? latency::NowUs() : 0;
-        int dst_stride = std::ceil((double)adapted_width / kBufferAlignment) * kBufferAlignment;
-        auto i420_buffer = webrtc::I420Buffer::Create(adapted_width, adapted_height, dst_stride,
-                                                      dst_stride / 2, dst_stride / 2);
-        i420_buffer->ScaleFrom(*frame_buffer->ToI420());
-        dst_buffer = i420_buffer;
+        auto scaled_buffer = frame_scaler::Scale(frame_buffer, crop_x, crop_y, crop_width,
+                                                 crop_height, adapted_width, adapted_height);
+        if (!scaled_buffer) {
+            return;
+        }
+        dst_buffer = scaled_buffer;
         if (traced) {
             latency::RecordSince(latency::Stage::kI420Scale, scale_start_us);
         }
     }
 
+    // The simulcast layers below this one are scaled from each other rather than each from it.
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> video_frame_buffer = dst_buffer;
+    if (simulcast_) {
+        video_frame_buffer = LayeredFrameBuffer::Create(dst_buffer);
+    }
+
     if (traced) {
         latency::SetSentResolution(adapted_width, adapted_height);
         if (sensor_us != 0) {
@@ -97,7 +87,7 @@ void ScaleTrackSource::OnFrameCaptured(
     }
 
     OnFrame(webrtc::VideoFrame::Builder()
-                .set_video_frame_buffer(dst_buffer)
+                .set_video_frame_buffer(video_frame_buffer)
                 .set_rotation(webrtc::kVideoRotation_0)
                 .set_timestamp_us(translated_timestamp_us)
                 .build());
@@ -26,8 +26,9 @@ class ScaleTrackSource : public webrtc::AdaptedVideoTrackSource {
     webrtc::TimestampAligner timestamp_aligner;
 
   private:
+    const bool simulcast_;
     Subscription subscription_;
-    void OnFrameCaptured(webrtc::scoped_refptr<webrtc::VideoFrameBuffer> frame_buffer);
+    void OnFrameCaptured(V4L2FrameBufferRef frame_buffer);
 };
 
 #endif
@@ -0,0 +1,97 @@
+#include "track/scaler_cache.h"
+
+#include <algorithm>
+
+#include "common/latency_tracer.h"
+#include "common/logging.h"
+
+namespace {
+
+bool SameConfig(const ScalerConfig &a, const ScalerConfig &b) {
+    return a.src_width == b.src_width && a.src_height == b.src_height &&
+           a.dst_width == b.dst_width && a.dst_height == b.dst_height &&
+           a.src_pix_fmt == b.src_pix_fmt && a.is_dma_src == b.is_dma_src &&
+           a.is_dma_dst == b.is_dma_dst;
+}
+
+} // namespace
+
+ScalerCache::ScalerCache(Factory factory, size_t capacity, int64_t idle_timeout_us)
+    : factory_(std::move(factory)),
+      capacity_(std::max<size_t>(capacity, 1)),
+      idle_timeout_us_(idle_timeout_us) {}
+
+ScalerCache::~ScalerCache() { Clear(); }
+
+IFrameProcessor *ScalerCache::Get(const ScalerConfig &config) {
+    const int64_t now_us = latency::NowUs();
+    if (!entries_.empty() && SameConfig(entries_.front().config, config)) {
+        entries_.front().last_used_us = now_us;
+        EvictIdle(now_us);
+        return entries_.front().scaler.get();
+    }
+
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (SameConfig(it->config, config)) {
+            entries_.splice(entries_.begin(), entries_, it);
+            entries_.front().last_used_us = now_us;
+            if (latency::Enabled()) {
+                latency::Count(latency::Counter::kScalerCacheHit);
+            }
+            EvictIdle(now_us);
+            return entries_.front().scaler.get();
+        }
+    }
+
+    if (latency::Enabled()) {
+        latency::Count(latency::Counter::kScalerCacheMiss);
+    }
+    auto scaler = Open(config);
+    if (!scaler) {
+        return nullptr;
+    }
+    entries_.push_front({config, std::move(scaler), now_us});
+    while (entries_.size() > capacity_) {
+        const ScalerConfig &oldest = entries_.back().config;
+        DEBUG_PRINT("Scaler %dx%d -> %dx%d is closed to make room.", oldest.src_width,
+                    oldest.src_height, oldest.dst_width, oldest.dst_height);
+        entries_.pop_back();
+    }
+    EvictIdle(now_us);
+    return entries_.front().scaler.get();
+}
+
+void ScalerCache::Clear() { entries_.clear(); }
+
+std::unique_ptr<IFrameProcessor> ScalerCache::Open(const ScalerConfig &config) {
+    auto scaler = factory_(config);
+    if (!scaler && !entries_.empty()) {
+        // Most likely the device ran out of buffer memory; give it back and try again.
+        DEBUG_PRINT("Closing %zu cached scaler(s) to retry %dx%d -> %dx%d.", entries_.size(),
+                    config.src_width, config.src_height, config.dst_width, config.dst_height);
+        Clear();
+        scaler = factory_(config);
+    }
+    if (!scaler) {
+        ERROR_PRINT("Unable to open a scaler for %dx%d -> %dx%d.", config.src_width,
+                    config.src_height, config.dst_width, config.dst_height);
+    }
+    return scaler;
+}
+
+void ScalerCache::EvictIdle(int64_t now_us) {
+    if (idle_timeout_us_ <= 0 || entries_.empty()) {
+        return;
+    }
+    // The front entry is the one in use.
+    for (auto it = std::next(entries_.begin()); it != entries_.end();) {
+        if (now_us - it->last_used_us > idle_timeout_us_) {
+            DEBUG_PRINT("Scaler %dx%d -> %dx%d is closed after sitting idle.",
+                        it->config.src_width, it->config.src_height, it->config.dst_width,
+                        it->config.dst_height);
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SCALER_CACHE_H_
+#define SCALER_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <memory>
+
+#include "codecs/frame_processor.h"
+
+// The hardware scalers a track source has used recently, left open and streaming, so that when
+// AdaptFrame() goes back to a size it picked before the switch costs no open, REQBUFS and
+// STREAMON. Entries are keyed on the whole ScalerConfig, i.e. both sizes and the source format.
+//
+// The least recently used scaler is closed once the cache is full, and any but the current one
+// is closed after sitting idle for the timeout. Each open scaler holds its own buffers, so when
+// opening a new one fails every cached one is closed and the open is retried once.
+//
+// Not thread-safe; it belongs to the thread that feeds the scalers.
+class ScalerCache {
+  public:
+    using Factory = std::function<std::unique_ptr<IFrameProcessor>(const ScalerConfig &config)>;
+
+    ScalerCache(Factory factory, size_t capacity, int64_t idle_timeout_us);
+    ~ScalerCache();
+
+    // The scaler for `config`, opened if it is not cached. nullptr if it could not be opened.
+    // It stays valid until the next call.
+    IFrameProcessor *Get(const ScalerConfig &config);
+    void Clear();
+
+  private:
+    struct Entry {
+        ScalerConfig config;
+        std::unique_ptr<IFrameProcessor> scaler;
+        int64_t last_used_us;
+    };
+
+    const Factory factory_;
+    const size_t capacity_;
+    const int64_t idle_timeout_us_;
+    std::list<Entry> entries_; // most recently used first
+
+    std::unique_ptr<IFrameProcessor> Open(const ScalerConfig &config);
+    void EvictIdle(int64_t now_us);
+};
+
+#endif // SCALER_CACHE_H_
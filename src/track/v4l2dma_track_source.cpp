@@ -8,6 +8,24 @@
 #include "common/latency_tracer.h"
 #include "common/logging.h"
 
+namespace {
+
+// Sizes AdaptFrame() moves between under bandwidth swings, each kept open for instant switches.
+constexpr size_t kCachedScalers = 3;
+constexpr int64_t kScalerIdleTimeoutUs = 30 * 1000000;
+
+std::unique_ptr<IFrameProcessor> CreateScaler(const ScalerConfig &config) {
+#if defined(USE_RPI_HW_ENCODER)
+    return V4L2Scaler::Create(config);
+#elif defined(USE_JETSON_HW_ENCODER)
+    return JetsonScaler::Create(config);
+#else
+    return nullptr;
+#endif
+}
+
+} // namespace
+
 webrtc::scoped_refptr<V4L2DmaTrackSource>
 V4L2DmaTrackSource::Create(std::shared_ptr<VideoCapturer> capturer) {
     auto obj = webrtc::make_ref_counted<V4L2DmaTrackSource>(std::move(capturer));
@@ -17,18 +35,26 @@ V4L2DmaTrackSource::Create(std::shared_ptr<VideoCapturer> capturer) {
 
 V4L2DmaTrackSource::V4L2DmaTrackSource(std::shared_ptr<VideoCapturer> capturer)
     : ScaleTrackSource(capturer),
-      is_dma_src_(capturer->is_dma_capture()),
-      config_width_(capturer->width()),
-      config_height_(capturer->height()) {}
+      is_dma_src_(capturer->is_dma_capture(capturer->config().live_stream_idx)),
+      config_width_(width),
+      config_height_(height),
+      scalers_(CreateScaler, kCachedScalers, kScalerIdleTimeoutUs),
+      last_frame_timestamp_us_(0) {}
 
-V4L2DmaTrackSource::~V4L2DmaTrackSource() { scaler.reset(); }
+V4L2DmaTrackSource::~V4L2DmaTrackSource() { scalers_.Clear(); }
 
 void V4L2DmaTrackSource::StartTrack() {
-    subscription_ = capturer->Subscribe(
-        [this](V4L2FrameBufferRef frame_buffer) {
-            OnFrameCaptured(frame_buffer);
-        },
-        stream_idx);
+    auto on_frame = [this](V4L2FrameBufferRef frame_buffer) {
+        OnFrameCaptured(frame_buffer);
+    };
+    // A dma frame is only queued to the hardware scaler from here, which never blocks, and the
+    // copy --async-dispatch makes of a frame the driver takes back would keep pointing into the
+    // driver's dma buffer, so those stay on the capture thread.
+    if (is_dma_src_) {
+        subscription_ = capturer->Subscribe(std::move(on_frame), stream_idx);
+    } else {
+        subscription_ = capturer->Subscribe("live", std::move(on_frame), stream_idx);
+    }
 }
 
 void V4L2DmaTrackSource::OnFrameCaptured(V4L2FrameBufferRef frame_buffer) {
@@ -72,21 +98,30 @@ void V4L2DmaTrackSource::OnFrameCaptured(V4L2FrameBufferRef frame_buffer) {
             latency::SetSentResolution(adapted_width, adapted_height);
         }
 
-        if (!scaler || adapted_width != config_width_ || adapted_height != config_height_) {
+        const bool switching = adapted_width != config_width_ || adapted_height != config_height_;
+        const int64_t switch_start_us = traced && switching ? latency::NowUs() : 0;
+        IFrameProcessor *scaler = scalers_.Get({width, height, adapted_width, adapted_height,
+                                                frame_buffer->format(), is_dma_src_, true});
+        if (!scaler) {
+            return;
+        }
+        if (switching) {
             config_width_ = adapted_width;
             config_height_ = adapted_height;
-#if defined(USE_RPI_HW_ENCODER)
-            scaler = V4L2Scaler::Create({width, height, config_width_, config_height_,
-                                         frame_buffer->format(), is_dma_src_, true});
-#elif defined(USE_JETSON_HW_ENCODER)
-            scaler = JetsonScaler::Create({width, height, config_width_, config_height_});
-#endif
-            DEBUG_PRINT("New scaler is set: %dx%d -> %dx%d", width, height, config_width_,
+            if (traced) {
+                latency::RecordSince(latency::Stage::kScalerSwitch, switch_start_us);
+            }
+            DEBUG_PRINT("Scaler is switched: %dx%d -> %dx%d", width, height, config_width_,
                         config_height_);
         }
 
         scaler->EmplaceBuffer(frame_buffer, [this, translated_timestamp_us,
                                              sensor_us](V4L2FrameBufferRef scaled_buffer) {
+            std::lock_guard<std::mutex> lock(on_frame_mtx_);
+            if (translated_timestamp_us <= last_frame_timestamp_us_) {
+                return;
+            }
+            last_frame_timestamp_us_ = translated_timestamp_us;
             if (sensor_us != 0) {
                 latency::MarkCapture(translated_timestamp_us, sensor_us);
                 latency::Record(latency::Stage::kSensorToOnFrame, latency::NowUs() - sensor_us);
@@ -1,8 +1,10 @@
 #ifndef V4L2DMA_TRACK_SOURCE_H_
 #define V4L2DMA_TRACK_SOURCE_H_
 
-#include "codecs/frame_processor.h"
+#include <mutex>
+
 #include "track/scale_track_source.h"
+#include "track/scaler_cache.h"
 
 class V4L2DmaTrackSource : public ScaleTrackSource {
   public:
@@ -17,7 +19,11 @@ class V4L2DmaTrackSource : public ScaleTrackSource {
     int config_width_;
     int config_height_;
     Subscription subscription_;
-    std::unique_ptr<IFrameProcessor> scaler;
+    ScalerCache scalers_;
+    // A frame still in a scaler that was switched away from can finish after the first one out
+    // of the new scaler; it is dropped rather than sent out of order.
+    std::mutex on_frame_mtx_;
+    int64_t last_frame_timestamp_us_;
 
     void OnFrameCaptured(V4L2FrameBufferRef frame_buffer);
 };
@@ -0,0 +1,175 @@
+#include "common/frame_scaler.h"
+#include "common/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <third_party/libyuv/include/libyuv.h>
+
+// Usage: test-scale-benchmark [iterations]
+// Times frame_scaler::Scale() striped over 1, 2 and 4 threads, counting the caller, for a few
+// common camera sizes scaled down to what WebRTC typically asks for. Each case is first checked
+// against libyuv's box filter over the same crop, and the run fails if any sample is off by more
+// than one.
+
+struct Case {
+    const char *name;
+    uint32_t format;
+    int src_width;
+    int src_height;
+    int crop_x;
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    int dst_width;
+    int dst_height;
+};
+
+// A smooth pattern in every channel, bytes `step` apart in a row, so that the two filters' span
+// rounding, which differs by a source sample here and there, stays within the tolerance.
+void FillPlane(uint8_t *data, int stride, int width, int height, int step, double phase) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const double value = 128 + 100 * std::sin(x / 331.0 + phase) * std::cos(y / 307.0);
+            data[y * stride + x * step] = static_cast<uint8_t>(std::lround(value));
+        }
+    }
+}
+
+V4L2FrameBufferRef CreateFrame(uint32_t format, int width, int height) {
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    const int size = format == V4L2_PIX_FMT_YUYV
+                         ? width * height * 2
+                         : width * height + 2 * chroma_width * chroma_height;
+    auto frame_buffer = V4L2FrameBuffer::Create(width, height, size, format);
+    uint8_t *data = frame_buffer->MutableData();
+    uint8_t *chroma = data + width * height;
+    switch (format) {
+        case V4L2_PIX_FMT_YUYV:
+            FillPlane(data, width * 2, width, height, 2, 0);
+            FillPlane(data + 1, width * 2, chroma_width, height, 4, 1);
+            FillPlane(data + 3, width * 2, chroma_width, height, 4, 2);
+            break;
+        case V4L2_PIX_FMT_NV12:
+            FillPlane(data, width, width, height, 1, 0);
+            FillPlane(chroma, chroma_width * 2, chroma_width, chroma_height, 2, 1);
+            FillPlane(chroma + 1, chroma_width * 2, chroma_width, chroma_height, 2, 2);
+            break;
+        default:
+            FillPlane(data, width, width, height, 1, 0);
+            FillPlane(chroma, chroma_width, chroma_width, chroma_height, 1, 1);
+            FillPlane(chroma + chroma_width * chroma_height, chroma_width, chroma_width,
+                      chroma_height, 1, 2);
+            break;
+    }
+    return frame_buffer;
+}
+
+int MaxDifference(const uint8_t *a, const uint8_t *b, int size) {
+    int max = 0;
+    for (int i = 0; i < size; i++) {
+        max = std::max(max, std::abs(a[i] - b[i]));
+    }
+    return max;
+}
+
+// The largest difference from libyuv's box filter over the whole frame converted to I420, cropped
+// the way Scale() snaps the crop; -1 if either fails.
+int Verify(const V4L2FrameBufferRef &src, const Case &c) {
+    auto scaled = frame_scaler::Scale(src, c.crop_x, c.crop_y, c.crop_width, c.crop_height,
+                                      c.dst_width, c.dst_height);
+    auto i420 = src->ToI420();
+    if (!scaled || !i420) {
+        return -1;
+    }
+
+    const int crop_x = c.crop_x & ~1;
+    const int crop_y = c.crop_y & ~1;
+    const int y_size = c.dst_width * c.dst_height;
+    const int chroma_stride = (c.dst_width + 1) / 2;
+    const int chroma_size = chroma_stride * ((c.dst_height + 1) / 2);
+    std::vector<uint8_t> expected(y_size + 2 * chroma_size);
+    if (libyuv::I420Scale(i420->DataY() + crop_y * i420->StrideY() + crop_x, i420->StrideY(),
+                          i420->DataU() + crop_y / 2 * i420->StrideU() + crop_x / 2,
+                          i420->StrideU(),
+                          i420->DataV() + crop_y / 2 * i420->StrideV() + crop_x / 2,
+                          i420->StrideV(), c.crop_width, c.crop_height, expected.data(),
+                          c.dst_width, expected.data() + y_size, chroma_stride,
+                          expected.data() + y_size + chroma_size, chroma_stride, c.dst_width,
+                          c.dst_height, libyuv::kFilterBox) < 0) {
+        return -1;
+    }
+    return MaxDifference(static_cast<const uint8_t *>(scaled->Data()), expected.data(),
+                         expected.size());
+}
+
+double Run(const V4L2FrameBufferRef &src, const Case &c, ThreadPool &pool, int iterations) {
+    // Warm up, so the pooled output buffers and the thread-local accumulators already exist.
+    for (int i = 0; i < 5; i++) {
+        frame_scaler::Scale(src, c.crop_x, c.crop_y, c.crop_width, c.crop_height, c.dst_width,
+                            c.dst_height, pool);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        if (!frame_scaler::Scale(src, c.crop_x, c.crop_y, c.crop_width, c.crop_height,
+                                 c.dst_width, c.dst_height, pool)) {
+            fprintf(stderr, "Scale failed for %s\n", c.name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count() / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 100;
+
+    const Case cases[] = {
+        {"i420 1080p -> 720p", V4L2_PIX_FMT_YUV420, 1920, 1080, 0, 0, 1920, 1080, 1280, 720},
+        {"i420 1080p -> 360p", V4L2_PIX_FMT_YUV420, 1920, 1080, 0, 0, 1920, 1080, 640, 360},
+        {"i420 4K -> 720p", V4L2_PIX_FMT_YUV420, 3840, 2160, 0, 0, 3840, 2160, 1280, 720},
+        {"i420 12MP -> 960p", V4L2_PIX_FMT_YUV420, 4056, 3040, 0, 0, 4056, 3040, 1280, 960},
+        {"nv12 4K -> 1080p", V4L2_PIX_FMT_NV12, 3840, 2160, 0, 0, 3840, 2160, 1920, 1080},
+        {"yuyv 1080p -> 720p", V4L2_PIX_FMT_YUYV, 1920, 1080, 0, 0, 1920, 1080, 1280, 720},
+        // Odd crops and sizes, on odd-sized frames.
+        {"i420 odd crop", V4L2_PIX_FMT_YUV420, 1921, 1081, 3, 5, 1915, 1073, 637, 357},
+        {"nv12 odd crop", V4L2_PIX_FMT_NV12, 1921, 1081, 7, 1, 1301, 731, 433, 243},
+        {"yuyv odd crop", V4L2_PIX_FMT_YUYV, 1920, 1080, 11, 9, 1797, 1005, 599, 335},
+    };
+    const int thread_counts[] = {1, 2, 4};
+    std::unique_ptr<ThreadPool> pools[3];
+    for (int i = 0; i < 3; i++) {
+        pools[i] = std::make_unique<ThreadPool>(thread_counts[i] - 1);
+    }
+
+    for (const Case &c : cases) {
+        auto src = CreateFrame(c.format, c.src_width, c.src_height);
+        const int difference = Verify(src, c);
+        if (difference < 0 || difference > 1) {
+            fprintf(stderr, "%s: differs from libyuv by %d\n", c.name, difference);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("%-20s | %12s | %12s %8s | %12s %8s\n", "case", "1 thread ms", "2 threads ms",
+           "speedup", "4 threads ms", "speedup");
+    for (const Case &c : cases) {
+        auto src = CreateFrame(c.format, c.src_width, c.src_height);
+        double ms[3];
+        for (int i = 0; i < 3; i++) {
+            ms[i] = Run(src, c, *pools[i], iterations);
+        }
+        printf("%-20s | %12.2f | %12.2f %7.2fx | %12.2f %7.2fx\n", c.name, ms[0], ms[1],
+               ms[0] / ms[1], ms[2], ms[0] / ms[2]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "common/interface/subject.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Usage: test-subject-benchmark [iterations]
+// Times Subject<T>::Next() against the snapshot-copying implementation it replaced, with 1 to 16
+// observers, and counts the heap allocations each makes per call.
+
+static std::atomic<long> allocations{0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+// The previous Subject: copies the observer vector under the mutex on every Next().
+template <typename T> class LegacySubject {
+  public:
+    using Callback = std::function<void(const T &)>;
+
+    Subscription Subscribe(Callback callback) {
+        auto observer = std::make_shared<Observer>();
+        observer->callback = std::move(callback);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            observers_.push_back(observer);
+        }
+        return Subscription{[this, observer]() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            observers_.erase(std::remove(observers_.begin(), observers_.end(), observer),
+                             observers_.end());
+        }};
+    }
+
+    void Next(const T &value) {
+        std::vector<std::shared_ptr<Observer>> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            snapshot = observers_;
+        }
+        for (auto &obs : snapshot) {
+            obs->callback(value);
+        }
+    }
+
+  private:
+    struct Observer {
+        Callback callback;
+    };
+
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Observer>> observers_;
+};
+
+struct Result {
+    double ns_per_next;
+    double allocations_per_next;
+};
+
+template <typename SubjectType> Result Run(int observer_count, int iterations) {
+    SubjectType subject;
+    std::vector<Subscription> subscriptions;
+    long sink = 0;
+    for (int i = 0; i < observer_count; i++) {
+        subscriptions.push_back(subject.Subscribe([&sink](const int &value) {
+            sink += value;
+        }));
+    }
+
+    // Warm up, so the first-call costs are not counted.
+    for (int i = 0; i < 1000; i++) {
+        subject.Next(i);
+    }
+
+    const long allocations_before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        subject.Next(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    const long allocated = allocations.load() - allocations_before;
+
+    if (sink == 42) {
+        printf(" ");
+    }
+
+    return {std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+            static_cast<double>(allocated) / iterations};
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    printf("%9s | %14s %12s | %14s %12s\n", "observers", "legacy ns/op", "allocs/op",
+           "current ns/op", "allocs/op");
+    for (int observer_count : {1, 2, 4, 8, 16}) {
+        auto legacy = Run<LegacySubject<int>>(observer_count, iterations);
+        auto current = Run<Subject<int>>(observer_count, iterations);
+        printf("%9d | %14.1f %12.2f | %14.1f %12.2f\n", observer_count, legacy.ns_per_next,
+               legacy.allocations_per_next, current.ns_per_next, current.allocations_per_next);
+    }
+
+    return 0;
+}
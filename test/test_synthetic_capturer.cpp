@@ -0,0 +1,64 @@
+#include "args.h"
+#include "capturer/synthetic_capturer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+
+// Usage: test-synthetic-capturer [file.y4m]
+// Without a file it runs the colour-bar pattern unpaced and reports the raw delivery rate.
+int main(int argc, char *argv[]) {
+    std::mutex mtx;
+    std::condition_variable cond_var;
+    bool is_finished = false;
+    int i = 0;
+    int images_nb = 300;
+    bool in_order = true;
+    timeval last_timestamp = {0, 0};
+
+    Args args{.fps = 30,
+              .width = 1280,
+              .height = 720,
+              .camera_source = CameraSource::Pattern,
+              .format = V4L2_PIX_FMT_YUV420,
+              .source_path = "bars",
+              .replay_pacing = "none"};
+    if (argc > 1) {
+        args.camera_source = CameraSource::File;
+        args.source_path = argv[1];
+    }
+
+    auto capturer = SyntheticCapturer::Create(args);
+    auto start = std::chrono::steady_clock::now();
+
+    auto observer = capturer->Subscribe([&](V4L2FrameBufferRef frame_buffer) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (is_finished) {
+            return;
+        }
+
+        auto timestamp = frame_buffer->timestamp();
+        if (timercmp(&timestamp, &last_timestamp, <)) {
+            in_order = false;
+        }
+        last_timestamp = timestamp;
+
+        if (++i >= images_nb) {
+            is_finished = true;
+            cond_var.notify_all();
+        }
+    });
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cond_var.wait(lock, [&] {
+        return is_finished;
+    });
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    printf("Received %d frames of %dx%d in %.2f s (%.1f fps), timestamps %s\n", i,
+           capturer->width(), capturer->height(), elapsed.count(), i / elapsed.count(),
+           in_order ? "monotonic" : "OUT OF ORDER");
+
+    return in_order ? 0 : 1;
+}